@@ -0,0 +1,170 @@
+// Approximate depth sort: splats are scattered into BUCKET_COUNT buckets spread over
+// the key range of the view, then every bucket (or only the nearest ones) is sorted
+// exactly in workgroup memory.
+// bucket_range_main -> bucket_count_main -> gpuPrimitivesScan of the sizes
+// -> bucket_scatter_main -> bucket_refine_main -> bucket_error_main
+
+const BUCKET_COUNT: u32 = 4096u;
+const WORKGROUP_SIZE: u32 = 256u;
+// Largest bucket sorted exactly, bigger ones are sorted in chunks of this size
+const REFINE_SIZE: u32 = 2048u;
+const PAD_KEY: u32 = 0xffffffffu;
+
+// Must match GPU_BUCKET_STAT_* in gpu-sort.h
+const STAT_MIN_KEY_INV: u32 = 0u;
+const STAT_MAX_KEY: u32 = 1u;
+const STAT_INVERSIONS: u32 = 2u;
+const STAT_OVERSIZED: u32 = 3u;
+const STAT_COUNT: u32 = 4u;
+
+struct BucketParams {
+    // Buckets from this one on are refined (the last buckets are the nearest)
+    refineFrom: u32,
+}
+
+@group(0) @binding(0) var<uniform> params: BucketParams;
+@group(0) @binding(1) var<storage, read> sortCount: u32;
+@group(0) @binding(2) var<storage, read_write> keys: array<u32>;
+@group(0) @binding(3) var<storage, read_write> values: array<u32>;
+@group(0) @binding(4) var<storage, read_write> scratchKeys: array<u32>;
+@group(0) @binding(5) var<storage, read_write> scratchValues: array<u32>;
+@group(0) @binding(6) var<storage, read_write> bucketCounts: array<atomic<u32>, BUCKET_COUNT>;
+// Start of every bucket, bucketStarts[BUCKET_COUNT] is the total. The starts and the
+// cursors (a copy of them) are written by gpuBucketSortEncode.
+@group(0) @binding(7) var<storage, read_write> bucketStarts: array<u32, BUCKET_COUNT + 1u>;
+@group(0) @binding(8) var<storage, read_write> bucketCursors: array<atomic<u32>, BUCKET_COUNT>;
+// The minimum is stored inverted so that a cleared buffer is a valid start
+@group(0) @binding(9) var<storage, read_write> stats: array<atomic<u32>, 8>;
+
+var<workgroup> sMinInv: atomic<u32>;
+var<workgroup> sMax: atomic<u32>;
+
+@compute @workgroup_size(256)
+fn bucket_range_main(@builtin(global_invocation_id) id: vec3u, @builtin(local_invocation_index) t: u32) {
+    if (id.x < sortCount) {
+        let key = keys[id.x];
+        atomicMax(&sMinInv, ~key);
+        atomicMax(&sMax, key);
+    }
+    workgroupBarrier();
+    if (t == 0u) {
+        atomicMax(&stats[STAT_MIN_KEY_INV], atomicLoad(&sMinInv));
+        atomicMax(&stats[STAT_MAX_KEY], atomicLoad(&sMax));
+    }
+}
+
+// Linear in the key, which is about logarithmic in depth
+fn bucket_of(key: u32) -> u32 {
+    let lo = ~atomicLoad(&stats[STAT_MIN_KEY_INV]);
+    let hi = atomicLoad(&stats[STAT_MAX_KEY]);
+    if (hi <= lo) {
+        return 0u;
+    }
+    let b = u32(f32(key - lo) / f32(hi - lo) * f32(BUCKET_COUNT));
+    return min(b, BUCKET_COUNT - 1u);
+}
+
+@compute @workgroup_size(256)
+fn bucket_count_main(@builtin(global_invocation_id) id: vec3u) {
+    if (id.x < sortCount) {
+        atomicAdd(&bucketCounts[bucket_of(keys[id.x])], 1u);
+    }
+}
+
+// Order inside a bucket is whatever the atomics hand out, refinement fixes it
+@compute @workgroup_size(256)
+fn bucket_scatter_main(@builtin(global_invocation_id) id: vec3u) {
+    if (id.x < sortCount) {
+        let key = keys[id.x];
+        let dst = atomicAdd(&bucketCursors[bucket_of(key)], 1u);
+        scratchKeys[dst] = key;
+        scratchValues[dst] = values[id.x];
+    }
+}
+
+// 16 KiB together, the whole default maxComputeWorkgroupStorageSize
+var<workgroup> sKey: array<u32, REFINE_SIZE>;
+var<workgroup> sIndex: array<u32, REFINE_SIZE>;
+
+// Bitonic step over the first width elements, see sort_local_step in compute.wgsl
+fn refine_step(t: u32, width: u32, half: u32, flip: bool) {
+    for (var p = t; p < width / 2u; p += WORKGROUP_SIZE) {
+        let a = ((p & ~(half - 1u)) << 1u) | (p & (half - 1u));
+        let b = select(a | half, a ^ (2u * half - 1u), flip);
+        let ka = sKey[a];
+        let kb = sKey[b];
+        if (ka > kb) {
+            sKey[a] = kb;
+            sKey[b] = ka;
+            let ia = sIndex[a];
+            sIndex[a] = sIndex[b];
+            sIndex[b] = ia;
+        }
+    }
+    workgroupBarrier();
+}
+
+// One workgroup per bucket, copies it back to keys / values and sorts it on the way
+@compute @workgroup_size(256)
+fn bucket_refine_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let bucket = wid.x;
+    // The bucket bounds are broadcast through the first two slots of sIndex, there is
+    // no room for another workgroup variable. workgroupUniformLoad has a barrier on
+    // both sides, so every thread read them before the slots are reused.
+    if (t == 0u) {
+        sIndex[0] = bucketStarts[bucket];
+        sIndex[1] = bucketStarts[bucket + 1u];
+    }
+    let range = vec2u(workgroupUniformLoad(&sIndex[0]), workgroupUniformLoad(&sIndex[1]));
+    let refine = bucket >= params.refineFrom;
+    if (refine && range.y - range.x > REFINE_SIZE && t == 0u) {
+        atomicAdd(&stats[STAT_OVERSIZED], 1u);
+    }
+
+    for (var base = range.x; base < range.y; base += REFINE_SIZE) {
+        let size = min(range.y - base, REFINE_SIZE);
+        if (!refine) {
+            for (var i = t; i < size; i += WORKGROUP_SIZE) {
+                keys[base + i] = scratchKeys[base + i];
+                values[base + i] = scratchValues[base + i];
+            }
+            continue;
+        }
+
+        var width = 2u;
+        while (width < size) {
+            width <<= 1u;
+        }
+        for (var i = t; i < width; i += WORKGROUP_SIZE) {
+            if (i < size) {
+                sKey[i] = scratchKeys[base + i];
+                sIndex[i] = scratchValues[base + i];
+            } else {
+                sKey[i] = PAD_KEY;
+            }
+        }
+        workgroupBarrier();
+        for (var k = 2u; k <= width; k <<= 1u) {
+            refine_step(t, width, k >> 1u, true);
+            for (var j = k >> 2u; 0u < j; j >>= 1u) {
+                refine_step(t, width, j, false);
+            }
+        }
+        for (var i = t; i < size; i += WORKGROUP_SIZE) {
+            keys[base + i] = sKey[i];
+            values[base + i] = sIndex[i];
+        }
+        workgroupBarrier();
+    }
+}
+
+// Ordering error of the result: neighbours that are out of order
+@compute @workgroup_size(256)
+fn bucket_error_main(@builtin(global_invocation_id) id: vec3u) {
+    if (id.x == 0u) {
+        atomicStore(&stats[STAT_COUNT], sortCount);
+    }
+    if (id.x + 1u < sortCount && keys[id.x] > keys[id.x + 1u]) {
+        atomicAdd(&stats[STAT_INVERSIONS], 1u);
+    }
+}
@@ -1,58 +1,444 @@
 
-struct Splat {
-    @align(16) pos: vec3f,
-    @align(16) scale: vec3f,
-    @align(4) color: u32,
-    @align(4) rotation: u32,
-}
+// Splat and RenderRecord come from precision-f32.wgsl / precision-f16.wgsl, the
+// projection from projection.wgsl, which main.c prepends
 
 struct Uniforms {
     viewProj: mat4x4<f32>,
     scale: f32,
+    cull: u32,
+    // Adjacent inversions above which incremental_decide_main escalates to a full sort
+    resortThreshold: u32,
+    view: mat4x4<f32>,
+    focal: vec2f,
+    viewport: vec2f,
+    // Sort nearest first (the draw blends under), see depth_key
+    frontToBack: u32,
+    // Spherical harmonics degree of cSH (0 = none) and its u32s per splat
+    shDegree: u32,
+    shStride: u32,
+    cameraPos: vec3f,
 }
 
 struct SortUniforms {
     @align(16) comparePattern: u32,
+    // Second step done by the same dispatch (0 = none)
+    nextPattern: u32,
+    // Start of the first block of sort_local_main / sort_merge_main
+    blockOffset: u32,
+}
+
+struct Counters {
+    // Number of entries transform_main wrote to cSorted / cKeys
+    visible: atomic<u32>,
+    // Out of order neighbours rekey_main found in the previous order
+    inversions: atomic<u32>,
 }
 
 @group(0) @binding(0) var<uniform> cUniforms: Uniforms;
 @group(0) @binding(1) var<uniform> cSortUniforms: SortUniforms;
 @group(0) @binding(2) var<storage, read> cSplats: array<Splat>;
-@group(0) @binding(3) var<storage, read_write> cTransformedPos: array<vec4f>;
+@group(0) @binding(3) var<storage, read_write> cRecords: array<RenderRecord>;
 @group(0) @binding(4) var<storage, read_write> cSorted: array<u32>;
+// Depth keys, kept next to cSorted by every sort so the sorts never gather from the splats
+@group(0) @binding(5) var<storage, read_write> cKeys: array<u32>;
+@group(0) @binding(6) var<storage, read_write> cCounters: Counters;
+// View dependent color, rgb binary16 of every coefficient past the DC term in turn
+// (splatScenePackSh in splat.c). A single dummy word without SH.
+@group(0) @binding(7) var<storage, read> cSH: array<u32>;
+
+// Only bound for cull_finalize_main, see INDIRECT_* for the layout
+@group(1) @binding(0) var<storage, read_write> cIndirect: array<u32>;
+// Only bound for gather_main (in place of cIndirect)
+@group(1) @binding(1) var<storage, read_write> cDrawRecords: array<RenderRecord>;
+
+// Must match INDIRECT_* in shader-types.h
+const INDIRECT_DRAW: u32 = 0u;
+const INDIRECT_RADIX_BLOCKS: u32 = 4u;
+const INDIRECT_SORT_BLOCKS: u32 = 7u;
+const INDIRECT_SORT_GROUPS: u32 = 10u;
+const INDIRECT_REPAIR_BLOCKS: u32 = 13u;
+const INDIRECT_REPAIR_SHIFTED_BLOCKS: u32 = 16u;
+const INDIRECT_STATS: u32 = 19u;
+// DRAW_BATCHES draws of 4 u32s, the visible splats split into equal batches
+const INDIRECT_BATCHES: u32 = 21u;
+// The first instance of every batch, DRAW_BATCH_STRIDE bytes apart (DrawBatch in render.wgsl)
+const INDIRECT_DRAW_BATCHES: u32 = 64u;
+const DRAW_BATCHES: u32 = 8u;
+const DRAW_BATCH_STRIDE: u32 = 256u;
+
+// Ascending key = descending clip z (back to front), same as depthSortKey on the CPU.
+// Inverted for front to back, so every sort orders nearest first.
+fn depth_key(z: f32) -> u32 {
+    let bits = bitcast<u32>(z);
+    let key = select(bits ^ 0x7fffffffu, bits, (bits >> 31u) == 1u);
+    return select(key, ~key, cUniforms.frontToBack != 0u);
+}
+
+// Whether any of the quad vs_main draws for pos survives clipping. The quad stays
+// within MAX_SIGMA of the largest axis, which is at most that many clip units off pos.
+fn in_frustum(pos: vec4f, scale: vec3f) -> bool {
+    let extent = MAX_SIGMA * max(scale.x, max(scale.y, scale.z)) * 2.0 * cUniforms.focal / cUniforms.viewport;
+    return pos.z >= 0.0 && pos.z <= pos.w && abs(pos.x) <= pos.w + extent.x && abs(pos.y) <= pos.w + extent.y;
+}
+
+fn is_visible(pos: vec4f, scale: vec3f) -> bool {
+    return cUniforms.cull == 0u || in_frustum(pos, scale);
+}
+
+const SH_C1: f32 = 0.4886025119029199;
+const SH_C2 = array(1.0925484305920792, -1.0925484305920792, 0.31539156525252005, -1.0925484305920792,
+                    0.5462742152960396);
+const SH_C3 = array(-0.5900435899266435, 2.890611442640554, -0.4570457994644658, 0.3731763325901154,
+                    -0.4570457994644658, 1.445305721320277, -0.5900435899266435);
+
+// rgb of coefficient k of the splat whose coefficients start at half index base
+fn sh_coeff(base: u32, k: u32) -> vec3f {
+    let first = base + 3u * k;
+    let word = first / 2u;
+    let a = unpack2x16float(cSH[word]);
+    let b = unpack2x16float(cSH[word + 1u]);
+    // An odd first half starts in the upper half of the word
+    return select(vec3f(a.x, a.y, b.x), vec3f(a.y, b.x, b.y), (first & 1u) == 1u);
+}
+
+// Color from the SH coefficients, the DC term (coefficient 0) included and unclamped,
+// same basis as the 3DGS reference rasterizer. Only evaluated for the visible splats,
+// once per view, and only with shDegree > 0.
+fn sh_color(index: u32, center: vec3f) -> vec3f {
+    let degree = cUniforms.shDegree;
+    let base = index * cUniforms.shStride * 2u;
+    let dir = normalize(center - cUniforms.cameraPos);
+    let x = dir.x;
+    let y = dir.y;
+    let z = dir.z;
+    var color = sh_coeff(base, 0u);
+    color += SH_C1 * (-y * sh_coeff(base, 1u) + z * sh_coeff(base, 2u) - x * sh_coeff(base, 3u));
+    if (degree >= 2u) {
+        let xx = x * x;
+        let yy = y * y;
+        let zz = z * z;
+        color += SH_C2[0] * x * y * sh_coeff(base, 4u) +
+                 SH_C2[1] * y * z * sh_coeff(base, 5u) +
+                 SH_C2[2] * (2.0 * zz - xx - yy) * sh_coeff(base, 6u) +
+                 SH_C2[3] * x * z * sh_coeff(base, 7u) +
+                 SH_C2[4] * (xx - yy) * sh_coeff(base, 8u);
+        if (degree >= 3u) {
+            color += SH_C3[0] * y * (3.0 * xx - yy) * sh_coeff(base, 9u) +
+                     SH_C3[1] * x * y * z * sh_coeff(base, 10u) +
+                     SH_C3[2] * y * (4.0 * zz - xx - yy) * sh_coeff(base, 11u) +
+                     SH_C3[3] * z * (2.0 * zz - 3.0 * xx - 3.0 * yy) * sh_coeff(base, 12u) +
+                     SH_C3[4] * x * (4.0 * zz - xx - yy) * sh_coeff(base, 13u) +
+                     SH_C3[5] * z * (xx - yy) * sh_coeff(base, 14u) +
+                     SH_C3[6] * x * (xx - 3.0 * yy) * sh_coeff(base, 15u);
+        }
+    }
+    return color;
+}
+
+// Oriented quad around the projected gaussian, out to where its alpha drops below
+// MIN_ALPHA (at most MAX_SIGMA). Splats that are off screen or too faint get extent 0.
+fn write_record(index: u32, splat: Splat, pos: vec4f) {
+    let color = unpack4x8unorm(splat.color);
+    let t = (cUniforms.view * vec4f(splat.pos, 1.0)).xyz;
+    let scale = splat_scale(splat);
+    if (color.a < MIN_ALPHA || t.z >= 0.0 || !in_frustum(pos, scale)) {
+        cRecords[index] = RenderRecord();
+        return;
+    }
+
+    let cov = project_covariance(splat_covariance(scale, splat.rotation), t, cUniforms.view, cUniforms.focal,
+                                 cUniforms.viewport);
+    let footprint = splat_footprint(cov, color.a);
+    let toNdc = 2.0 / cUniforms.viewport;
+    let minor = vec2f(-footprint.axis.y, footprint.axis.x);
+    let axes = vec4f(footprint.axis * footprint.sigma.x * toNdc, minor * footprint.sigma.y * toNdc);
+    // splat.color holds the DC term clamped, with SH the sum is clamped only once
+    var rgb = color.rgb;
+    if (cUniforms.shDegree > 0u) {
+        rgb = saturate(sh_color(index, splat.pos));
+    }
+    cRecords[index] = make_record(axes, pos.xy / pos.w, footprint.extent, pack4x8unorm(vec4f(rgb * color.a, color.a)));
+}
+
+// Two halves, the scan ping-pongs between them
+var<workgroup> sVisible: array<u32, 512>;
+var<workgroup> sVisibleBase: u32;
+
+// Projects every splat and appends the visible ones to cSorted / cKeys
+@compute @workgroup_size(256)
+fn transform_main(@builtin(global_invocation_id) id: vec3u, @builtin(local_invocation_index) t: u32) {
+    var visible = false;
+    var key = 0u;
+    if (id.x < arrayLength(&cSplats)) {
+        let splat = cSplats[id.x];
+        let pos = cUniforms.viewProj * vec4f(splat.pos, 1.0);
+        write_record(id.x, splat, pos);
+        key = depth_key(pos.z);
+        visible = is_visible(pos, splat_scale(splat));
+    }
+
+    // Compaction: workgroup scan of the flags, one atomic per workgroup. Every step
+    // writes the other half, so it takes one barrier instead of two.
+    var inclusive = select(0u, 1u, visible);
+    var src = 0u;
+    sVisible[t] = inclusive;
+    for (var offset = 1u; offset < 256u; offset <<= 1u) {
+        workgroupBarrier();
+        if (t >= offset) {
+            inclusive += sVisible[src + t - offset];
+        }
+        src = 256u - src;
+        sVisible[src + t] = inclusive;
+    }
+    if (t == 255u) {
+        sVisibleBase = atomicAdd(&cCounters.visible, inclusive);
+    }
+    workgroupBarrier();
+    if (visible) {
+        let dst = sVisibleBase + inclusive - 1u;
+        cSorted[dst] = id.x;
+        cKeys[dst] = key;
+    }
+}
+
+// Turns the visible count into draw and dispatch arguments
+@compute @workgroup_size(1)
+fn cull_finalize_main() {
+    let count = atomicLoad(&cCounters.visible);
+    cIndirect[INDIRECT_DRAW + 0u] = 4u;
+    cIndirect[INDIRECT_DRAW + 1u] = count;
+    cIndirect[INDIRECT_DRAW + 2u] = 0u;
+    cIndirect[INDIRECT_DRAW + 3u] = 0u;
+    // Radix blocks (radix.wgsl BLOCK_SIZE)
+    cIndirect[INDIRECT_RADIX_BLOCKS + 0u] = max((count + 1023u) / 1024u, 1u);
+    cIndirect[INDIRECT_RADIX_BLOCKS + 1u] = 1u;
+    cIndirect[INDIRECT_RADIX_BLOCKS + 2u] = 1u;
+    // Bitonic blocks
+    cIndirect[INDIRECT_SORT_BLOCKS + 0u] = (count + SORT_BLOCK - 1u) / SORT_BLOCK;
+    cIndirect[INDIRECT_SORT_BLOCKS + 1u] = 1u;
+    cIndirect[INDIRECT_SORT_BLOCKS + 2u] = 1u;
+    // Threads of sort_main, the first element of a group never exceeds its thread index
+    cIndirect[INDIRECT_SORT_GROUPS + 0u] = (count + SORT_THREADS - 1u) / SORT_THREADS;
+    cIndirect[INDIRECT_SORT_GROUPS + 1u] = 1u;
+    cIndirect[INDIRECT_SORT_GROUPS + 2u] = 1u;
+    // Front to back the draw is split into batches of the visible splats, between them
+    // the saturated pixels are masked. vs_main reads the first one of its batch.
+    let batchSize = (count + DRAW_BATCHES - 1u) / DRAW_BATCHES;
+    for (var b = 0u; b < DRAW_BATCHES; b++) {
+        let first = b * batchSize;
+        cIndirect[INDIRECT_DRAW_BATCHES + b * DRAW_BATCH_STRIDE / 4u] = first;
+        let i = INDIRECT_BATCHES + 4u * b;
+        cIndirect[i + 0u] = 4u;
+        cIndirect[i + 1u] = select(0u, min(count - first, batchSize), count > first);
+        cIndirect[i + 2u] = 0u;
+        cIndirect[i + 3u] = 0u;
+    }
+}
+
+// Incremental GPU sort: keeps last frame's cSorted (all splats) and only refreshes
+// the keys in that order, counting the neighbours that are now out of order
+@compute @workgroup_size(256)
+fn rekey_main(@builtin(global_invocation_id) id: vec3u) {
+    let n = arrayLength(&cSplats);
+    if (id.x == 0u) {
+        atomicStore(&cCounters.visible, n);
+    }
+    if (id.x >= n) {
+        return;
+    }
+    let index = cSorted[id.x];
+    let splat = cSplats[index];
+    let pos = cUniforms.viewProj * vec4f(splat.pos, 1.0);
+    write_record(index, splat, pos);
+    let key = depth_key(pos.z);
+    cKeys[id.x] = key;
+    if (id.x + 1u < n) {
+        let next = cUniforms.viewProj * vec4f(cSplats[cSorted[id.x + 1u]].pos, 1.0);
+        if (key > depth_key(next.z)) {
+            atomicAdd(&cCounters.inversions, 1u);
+        }
+    }
+}
 
+// Runs after cull_finalize_main: either the full radix sort or the cheap repair
+// (sort_local_main over aligned, then half a block shifted blocks) keeps its arguments
+@compute @workgroup_size(1)
+fn incremental_decide_main() {
+    let count = atomicLoad(&cCounters.visible);
+    let inversions = atomicLoad(&cCounters.inversions);
+    let escalate = inversions > cUniforms.resortThreshold;
+    if (!escalate) {
+        cIndirect[INDIRECT_RADIX_BLOCKS] = 0u;
+    }
+    let blocks = (count + SORT_BLOCK - 1u) / SORT_BLOCK;
+    var shifted = 0u;
+    if (count > SORT_BLOCK / 2u) {
+        shifted = (count - SORT_BLOCK / 2u + SORT_BLOCK - 1u) / SORT_BLOCK;
+    }
+    cIndirect[INDIRECT_REPAIR_BLOCKS + 0u] = select(blocks, 0u, escalate);
+    cIndirect[INDIRECT_REPAIR_BLOCKS + 1u] = 1u;
+    cIndirect[INDIRECT_REPAIR_BLOCKS + 2u] = 1u;
+    cIndirect[INDIRECT_REPAIR_SHIFTED_BLOCKS + 0u] = select(shifted, 0u, escalate);
+    cIndirect[INDIRECT_REPAIR_SHIFTED_BLOCKS + 1u] = 1u;
+    cIndirect[INDIRECT_REPAIR_SHIFTED_BLOCKS + 2u] = 1u;
+    // Read back for the perf panel
+    cIndirect[INDIRECT_STATS + 0u] = inversions;
+    cIndirect[INDIRECT_STATS + 1u] = select(0u, 1u, escalate);
+}
 
+// The render records of transform_main, but leaves the order alone (it comes from the
+// CPU sort or an earlier frame)
 @compute @workgroup_size(256)
-fn transform_main(@builtin(global_invocation_id) id: vec3u) {
+fn preprocess_main(@builtin(global_invocation_id) id: vec3u) {
     if (id.x >= arrayLength(&cSplats)) {
         return;
     }
-    var splat = cSplats[id.x];
-    cTransformedPos[id.x] = cUniforms.viewProj * vec4f(splat.pos, 1.0);
-    cSorted[id.x] = id.x;
+    let splat = cSplats[id.x];
+    write_record(id.x, splat, cUniforms.viewProj * vec4f(splat.pos, 1.0));
 }
 
 
-fn sort_cmp_and_swap(i: u32, j: u32) {
-    let n = arrayLength(&cSplats);
-    if (j >= n) {
+// cRecords in the order of cSorted, so vs_gathered_main reads them linearly. Dispatched
+// with INDIRECT_SORT_GROUPS after a GPU sort, past the visible count cSorted still
+// holds valid indices of an older order.
+@compute @workgroup_size(256)
+fn gather_main(@builtin(global_invocation_id) id: vec3u) {
+    if (id.x >= arrayLength(&cSorted)) {
         return;
     }
-    let iIdx = cSorted[i];
-    let jIdx = cSorted[j];
-    if (i < j && cTransformedPos[iIdx].z < cTransformedPos[jIdx].z) {
-        let tmp = cSorted[i];
-        cSorted[i] = cSorted[j];
-        cSorted[j] = tmp;
+    cDrawRecords[id.x] = cRecords[cSorted[id.x]];
+}
+
+// Bitonic sort, back to front. Blocks of SORT_BLOCK elements are sorted and merged in
+// workgroup memory, only steps whose pairs cross blocks go through sort_main.
+const SORT_BLOCK: u32 = 2048u;
+const SORT_THREADS: u32 = 256u;
+// Stands in for the elements past the end (padding to a power of two)
+const SORT_PAD_KEY: u32 = 0xffffffffu;
+
+var<workgroup> sKey: array<u32, SORT_BLOCK>;
+var<workgroup> sIndex: array<u32, SORT_BLOCK>;
+
+fn sort_load_block(base: u32, t: u32) {
+    let n = atomicLoad(&cCounters.visible);
+    for (var q = 0u; q < SORT_BLOCK / SORT_THREADS; q++) {
+        let local = q * SORT_THREADS + t;
+        let i = base + local;
+        if (i < n) {
+            sIndex[local] = cSorted[i];
+            sKey[local] = cKeys[i];
+        } else {
+            sKey[local] = SORT_PAD_KEY;
+        }
+    }
+    workgroupBarrier();
+}
+
+fn sort_store_block(base: u32, t: u32) {
+    let n = atomicLoad(&cCounters.visible);
+    for (var q = 0u; q < SORT_BLOCK / SORT_THREADS; q++) {
+        let local = q * SORT_THREADS + t;
+        if (base + local < n) {
+            cSorted[base + local] = sIndex[local];
+            cKeys[base + local] = sKey[local];
+        }
+    }
+}
+
+// One network step inside the block. Pairs are (a, a + half), or (a, mirror of a) in
+// the 2 * half sized sub-block when flip is set.
+fn sort_local_step(t: u32, half: u32, flip: bool) {
+    for (var q = 0u; q < SORT_BLOCK / SORT_THREADS / 2u; q++) {
+        let p = q * SORT_THREADS + t;
+        let a = ((p & ~(half - 1u)) << 1u) | (p & (half - 1u));
+        let b = select(a | half, a ^ (2u * half - 1u), flip);
+        let ka = sKey[a];
+        let kb = sKey[b];
+        if (ka > kb) {
+            sKey[a] = kb;
+            sKey[b] = ka;
+            let ia = sIndex[a];
+            sIndex[a] = sIndex[b];
+            sIndex[b] = ia;
+        }
+    }
+    workgroupBarrier();
+}
+
+// Full sort of every block
+@compute @workgroup_size(256)
+fn sort_local_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let base = wid.x * SORT_BLOCK + cSortUniforms.blockOffset;
+    sort_load_block(base, t);
+    for (var k = 2u; k <= SORT_BLOCK; k <<= 1u) {
+        sort_local_step(t, k >> 1u, true);
+        for (var j = k >> 2u; 0u < j; j >>= 1u) {
+            sort_local_step(t, j, false);
+        }
     }
+    sort_store_block(base, t);
 }
+
+// The remaining steps of a merge once the stride fits in a block
+@compute @workgroup_size(256)
+fn sort_merge_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let base = wid.x * SORT_BLOCK + cSortUniforms.blockOffset;
+    sort_load_block(base, t);
+    for (var j = SORT_BLOCK >> 1u; 0u < j; j >>= 1u) {
+        sort_local_step(t, j, false);
+    }
+    sort_store_block(base, t);
+}
+
+fn insert_zero_bit(x: u32, bit: u32) -> u32 {
+    let low = x & ((1u << bit) - 1u);
+    return ((x >> bit) << (bit + 1u)) | low;
+}
+
+// Steps across blocks, i ^ comparePattern then i ^ nextPattern. Every thread owns the
+// 4 elements both steps touch, so they stay in registers in between.
 @compute @workgroup_size(256)
 fn sort_main(@builtin(global_invocation_id) id: vec3u) {
-    let i = id.x;
-    if (i >= arrayLength(&cSplats)) {
+    let n = atomicLoad(&cCounters.visible);
+    let a = cSortUniforms.comparePattern;
+    let b = cSortUniforms.nextPattern;
+    let lowBit = select(0u, firstTrailingBit(b), b != 0u);
+    let i = insert_zero_bit(insert_zero_bit(id.x, lowBit), firstLeadingBit(a));
+    if (i >= n) {
         return;
     }
-    let j = i ^ cSortUniforms.comparePattern;
-    sort_cmp_and_swap(i, j);
-}
+    var pos = array<u32, 4>(i, i ^ (1u << lowBit), i ^ a, i ^ a ^ (1u << lowBit));
+
+    var index: array<u32, 4>;
+    var key: array<u32, 4>;
+    for (var q = 0u; q < 4u; q++) {
+        key[q] = SORT_PAD_KEY;
+        if (pos[q] < n) {
+            index[q] = cSorted[pos[q]];
+            key[q] = cKeys[pos[q]];
+        }
+    }
 
+    var pairs = array<vec2u, 4>(vec2u(0u, 2u), vec2u(1u, 3u), vec2u(0u, 1u), vec2u(2u, 3u));
+    let pairCount = select(2u, 4u, b != 0u);
+    for (var p = 0u; p < pairCount; p++) {
+        // Smaller key goes to the lower position
+        let x = select(pairs[p].y, pairs[p].x, pos[pairs[p].x] < pos[pairs[p].y]);
+        let y = select(pairs[p].x, pairs[p].y, pos[pairs[p].x] < pos[pairs[p].y]);
+        if (key[x] > key[y]) {
+            let k = key[x];
+            key[x] = key[y];
+            key[y] = k;
+            let idx = index[x];
+            index[x] = index[y];
+            index[y] = idx;
+        }
+    }
+
+    for (var q = 0u; q < 4u; q++) {
+        if (pos[q] < n) {
+            cSorted[pos[q]] = index[q];
+            cKeys[pos[q]] = key[q];
+        }
+    }
+}
@@ -0,0 +1,39 @@
+// Offscreen splat target (offscreen.c). Front to back the splats accumulate in oColor,
+// saturated pixels get marked in the stencil between draw batches, and the result is
+// composited (upscaled with dynamic resolution) onto the surface.
+
+@group(0) @binding(0) var oColor: texture_2d<f32>;
+@group(0) @binding(1) var oSampler: sampler;
+
+// From this accumulated alpha on nothing behind a pixel shows in an 8 bit target
+const SATURATED_ALPHA: f32 = 254.0 / 255.0;
+
+struct FullscreenOutput {
+    @builtin(position) pos: vec4f,
+    // Top left (0, 0) like the texture
+    @location(0) uv: vec2f,
+}
+
+@vertex
+fn vs_fullscreen(@builtin(vertex_index) vIdx: u32) -> FullscreenOutput {
+    let uv = vec2f(f32((vIdx << 1u) & 2u), f32(vIdx & 2u));
+    var out: FullscreenOutput;
+    out.pos = vec4f(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, 0.0, 1.0);
+    out.uv = uv;
+    return out;
+}
+
+// Only saturated pixels survive, the pipeline writes the stencil reference for them.
+// Drawn at the target's own size, so pos addresses oColor directly.
+@fragment
+fn fs_saturation(in: FullscreenOutput) {
+    if (textureLoad(oColor, vec2i(in.pos.xy), 0).a < SATURATED_ALPHA) {
+        discard;
+    }
+}
+
+// Premultiplied, blended over the cleared surface. Bilinear when the target is smaller.
+@fragment
+fn fs_composite(in: FullscreenOutput) -> @location(0) vec4f {
+    return textureSample(oColor, oSampler, in.uv);
+}
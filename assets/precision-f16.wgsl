@@ -0,0 +1,42 @@
+enable f16;
+
+// Half precision layouts (shader-f16), prepended to compute.wgsl, render.wgsl and
+// tile.wgsl in place of precision-f32.wgsl. Positions stay fp32, everything that is
+// only used relative to the splat's own size is stored as f16.
+// Must match SplatHalf in splat.h and RenderRecordHalf in shader-types.h.
+
+struct Splat {
+    pos: vec3f,
+    color: u32,
+    // w unused
+    scale: vec4<f16>,
+    rotation: u32,
+}
+
+fn splat_scale(splat: Splat) -> vec3f {
+    return vec3f(splat.scale.xyz);
+}
+
+// See precision-f32.wgsl. The center is in NDC, at f16 it would be off by a fraction
+// of a pixel, the axes and the extent are relative to it.
+struct RenderRecord {
+    center: vec2f,
+    axes: vec4<f16>,
+    extent: f16,
+    color: u32,
+}
+
+fn make_record(axes: vec4f, center: vec2f, extent: f32, color: u32) -> RenderRecord {
+    return RenderRecord(center, vec4<f16>(axes), f16(extent), color);
+}
+
+fn record_axes(record: RenderRecord) -> vec4f {
+    return vec4f(record.axes);
+}
+
+fn record_extent(record: RenderRecord) -> f32 {
+    return f32(record.extent);
+}
+
+// Precision of the per fragment math in fs_main
+alias real = f16;
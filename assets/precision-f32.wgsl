@@ -0,0 +1,41 @@
+// Full precision layouts, prepended to compute.wgsl, render.wgsl and tile.wgsl in
+// place of precision-f16.wgsl when the device has no shader-f16.
+// Must match Splat in splat.h and RenderRecord in shader-types.h.
+
+struct Splat {
+    @align(16) pos: vec3f,
+    @align(16) scale: vec3f,
+    @align(4) color: u32,
+    @align(4) rotation: u32,
+}
+
+fn splat_scale(splat: Splat) -> vec3f {
+    return splat.scale;
+}
+
+// Everything vs_main needs of a splat, written by write_record whenever the view changes
+struct RenderRecord {
+    // Quad axes (major.xy, minor.xy), NDC units per standard deviation
+    axes: vec4f,
+    // NDC
+    center: vec2f,
+    // Standard deviations the quad reaches out to, 0 = not drawn
+    extent: f32,
+    // unorm8 rgba, rgb premultiplied by the opacity
+    color: u32,
+}
+
+fn make_record(axes: vec4f, center: vec2f, extent: f32, color: u32) -> RenderRecord {
+    return RenderRecord(axes, center, extent, color);
+}
+
+fn record_axes(record: RenderRecord) -> vec4f {
+    return record.axes;
+}
+
+fn record_extent(record: RenderRecord) -> f32 {
+    return record.extent;
+}
+
+// Precision of the per fragment math in fs_main
+alias real = f32;
@@ -0,0 +1,254 @@
+// Data parallel building blocks over u32 arrays, recorded by gpu-primitives.c.
+// Every workgroup covers BLOCK elements. Scans and reductions over more than one
+// block recurse over the block totals, see gpuPrimitivesScan.
+
+const WORKGROUP_SIZE: u32 = 256u;
+const ITEMS: u32 = 4u;
+// Must match GPU_PRIMITIVES_BLOCK / GPU_PRIMITIVES_MAX_BINS in gpu-primitives.h
+const BLOCK: u32 = 1024u;
+const MAX_BINS: u32 = 1024u;
+
+struct PrimitiveParams {
+    count: u32,
+    // Histogram: bin = (value >> shift) % bins
+    shift: u32,
+    bins: u32,
+    // Segmented scan: the heads themselves get 0 (only the caller's level, not the totals)
+    reset: u32,
+}
+
+@group(0) @binding(0) var<uniform> params: PrimitiveParams;
+// Scanned / reduced / counted values, the values to compact
+@group(0) @binding(1) var<storage, read_write> data: array<u32>;
+// One total per block, the compaction indices
+@group(0) @binding(2) var<storage, read_write> sums: array<u32>;
+// Segment heads, compaction flags (nonzero = set)
+@group(0) @binding(3) var<storage, read_write> flags: array<u32>;
+// Whether a block contains a segment head
+@group(0) @binding(4) var<storage, read_write> sumFlags: array<u32>;
+@group(0) @binding(5) var<storage, read_write> output: array<u32>;
+// Number of compacted values
+@group(0) @binding(6) var<storage, read_write> result: array<u32>;
+@group(0) @binding(7) var<storage, read_write> histogram: array<atomic<u32>>;
+
+// Two halves, the scans ping-pong between them
+var<workgroup> sScan: array<u32, 2u * WORKGROUP_SIZE>;
+var<workgroup> sFlags: array<u32, 2u * WORKGROUP_SIZE>;
+
+// Inclusive scan of one value per thread, same single barrier form as scan_main in radix.wgsl
+fn workgroup_scan(t: u32, value: u32) -> u32 {
+    var inclusive = value;
+    var src = 0u;
+    sScan[t] = inclusive;
+    for (var offset = 1u; offset < WORKGROUP_SIZE; offset <<= 1u) {
+        workgroupBarrier();
+        if (t >= offset) {
+            inclusive += sScan[src + t - offset];
+        }
+        src = WORKGROUP_SIZE - src;
+        sScan[src + t] = inclusive;
+    }
+    return inclusive;
+}
+
+// Inclusive scan of (head seen, sum since the last head) pairs. The final pairs end up
+// in the first half (an even number of steps), where the caller reads its neighbour.
+fn workgroup_segmented_scan(t: u32, flag: u32, value: u32) -> vec2u {
+    var f = flag;
+    var v = value;
+    var src = 0u;
+    sFlags[t] = f;
+    sScan[t] = v;
+    for (var offset = 1u; offset < WORKGROUP_SIZE; offset <<= 1u) {
+        workgroupBarrier();
+        if (t >= offset) {
+            if (f == 0u) {
+                v += sScan[src + t - offset];
+            }
+            f |= sFlags[src + t - offset];
+        }
+        src = WORKGROUP_SIZE - src;
+        sFlags[src + t] = f;
+        sScan[src + t] = v;
+    }
+    return vec2u(f, v);
+}
+
+// Sum of every block into sums
+@compute @workgroup_size(256)
+fn reduce_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    var sum = 0u;
+    for (var k = 0u; k < ITEMS; k++) {
+        let i = wid.x * BLOCK + k * WORKGROUP_SIZE + t;
+        if (i < params.count) {
+            sum += data[i];
+        }
+    }
+    let total = workgroup_scan(t, sum);
+    if (t == WORKGROUP_SIZE - 1u) {
+        sums[wid.x] = total;
+    }
+}
+
+// Exclusive scan inside every block, the block totals go to sums
+@compute @workgroup_size(256)
+fn scan_block_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let base = wid.x * BLOCK + t * ITEMS;
+    var items: array<u32, ITEMS>;
+    var sum = 0u;
+    for (var k = 0u; k < ITEMS; k++) {
+        items[k] = 0u;
+        if (base + k < params.count) {
+            items[k] = data[base + k];
+        }
+        sum += items[k];
+    }
+    let inclusive = workgroup_scan(t, sum);
+    var prefix = inclusive - sum;
+    for (var k = 0u; k < ITEMS; k++) {
+        if (base + k < params.count) {
+            data[base + k] = prefix;
+        }
+        prefix += items[k];
+    }
+    if (t == WORKGROUP_SIZE - 1u) {
+        sums[wid.x] = inclusive;
+    }
+}
+
+// Adds the scanned block totals
+@compute @workgroup_size(256)
+fn scan_add_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let carry = sums[wid.x];
+    for (var k = 0u; k < ITEMS; k++) {
+        let i = wid.x * BLOCK + k * WORKGROUP_SIZE + t;
+        if (i < params.count) {
+            data[i] += carry;
+        }
+    }
+}
+
+// Segmented version of scan_block_main, block totals to sums and whether the block
+// has a head to sumFlags
+@compute @workgroup_size(256)
+fn segmented_block_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    let base = wid.x * BLOCK + t * ITEMS;
+    var items: array<u32, ITEMS>;
+    var heads: array<bool, ITEMS>;
+    var f = 0u;
+    var v = 0u;
+    for (var k = 0u; k < ITEMS; k++) {
+        items[k] = 0u;
+        heads[k] = false;
+        if (base + k < params.count) {
+            items[k] = data[base + k];
+            heads[k] = flags[base + k] != 0u;
+        }
+        if (heads[k]) {
+            f = 1u;
+            v = 0u;
+        }
+        v += items[k];
+    }
+    let inclusive = workgroup_segmented_scan(t, f, v);
+    workgroupBarrier();
+    var prefix = 0u;
+    if (t > 0u) {
+        prefix = sScan[t - 1u];
+    }
+    for (var k = 0u; k < ITEMS; k++) {
+        if (base + k < params.count) {
+            data[base + k] = select(prefix, 0u, heads[k] && params.reset != 0u);
+        }
+        if (heads[k]) {
+            prefix = 0u;
+        }
+        prefix += items[k];
+    }
+    if (t == WORKGROUP_SIZE - 1u) {
+        sums[wid.x] = inclusive.y;
+        sumFlags[wid.x] = inclusive.x;
+    }
+}
+
+var<workgroup> sFirstHead: atomic<u32>;
+
+// Adds the scanned block totals up to the first head of every block
+@compute @workgroup_size(256)
+fn segmented_add_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    if (t == 0u) {
+        atomicStore(&sFirstHead, BLOCK);
+    }
+    workgroupBarrier();
+    for (var k = 0u; k < ITEMS; k++) {
+        let local = k * WORKGROUP_SIZE + t;
+        let i = wid.x * BLOCK + local;
+        if (i < params.count && flags[i] != 0u) {
+            atomicMin(&sFirstHead, local);
+        }
+    }
+    workgroupBarrier();
+    let firstHead = atomicLoad(&sFirstHead);
+
+    let carry = sums[wid.x];
+    for (var k = 0u; k < ITEMS; k++) {
+        let local = k * WORKGROUP_SIZE + t;
+        let i = wid.x * BLOCK + local;
+        // A head only takes the carry when it is not reset
+        if (i < params.count && (local < firstHead || (local == firstHead && params.reset == 0u))) {
+            data[i] += carry;
+        }
+    }
+}
+
+var<workgroup> sBins: array<atomic<u32>, MAX_BINS>;
+
+// Counted in workgroup memory first, then one global atomic per bin and block
+@compute @workgroup_size(256)
+fn histogram_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    for (var b = t; b < params.bins; b += WORKGROUP_SIZE) {
+        atomicStore(&sBins[b], 0u);
+    }
+    workgroupBarrier();
+    for (var k = 0u; k < ITEMS; k++) {
+        let i = wid.x * BLOCK + k * WORKGROUP_SIZE + t;
+        if (i < params.count) {
+            atomicAdd(&sBins[(data[i] >> params.shift) % params.bins], 1u);
+        }
+    }
+    workgroupBarrier();
+    for (var b = t; b < params.bins; b += WORKGROUP_SIZE) {
+        let count = atomicLoad(&sBins[b]);
+        if (count != 0u) {
+            atomicAdd(&histogram[b], count);
+        }
+    }
+}
+
+// 0 / 1 per flag, scanned into the output indices afterwards
+@compute @workgroup_size(256)
+fn compact_flags_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    for (var k = 0u; k < ITEMS; k++) {
+        let i = wid.x * BLOCK + k * WORKGROUP_SIZE + t;
+        if (i < params.count) {
+            sums[i] = select(0u, 1u, flags[i] != 0u);
+        }
+    }
+}
+
+@compute @workgroup_size(256)
+fn compact_scatter_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    for (var k = 0u; k < ITEMS; k++) {
+        let i = wid.x * BLOCK + k * WORKGROUP_SIZE + t;
+        if (i >= params.count) {
+            continue;
+        }
+        let keep = flags[i] != 0u;
+        if (keep) {
+            output[sums[i]] = data[i];
+        }
+        if (i == params.count - 1u) {
+            result[0] = sums[i] + select(0u, 1u, keep);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// Screen space footprint of a splat, prepended (after precision-*.wgsl) to every
+// splat shader, so the sorted quads and the tile renderer draw the same gaussians
+
+// Quads never reach past this many standard deviations
+const MAX_SIGMA: f32 = 3.0;
+// Fainter fragments do not change an 8 bit target
+const MIN_ALPHA: f32 = 1.0 / 255.0;
+// Added to the projected variances, keeps every splat about a pixel wide
+const LOW_PASS: f32 = 0.3;
+
+// World space covariance R S S^T R^T. The .splat format packs the rotation
+// quaternion (w, x, y, z) as bytes of q * 128 + 128.
+fn splat_covariance(scale: vec3f, rotation: u32) -> mat3x3f {
+    let q = normalize(unpack4x8unorm(rotation) * 255.0 - 128.0);
+    let w = q.x;
+    let x = q.y;
+    let y = q.z;
+    let z = q.w;
+    let r = mat3x3f(
+        vec3f(1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y + w * z), 2.0 * (x * z - w * y)),
+        vec3f(2.0 * (x * y - w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z + w * x)),
+        vec3f(2.0 * (x * z + w * y), 2.0 * (y * z - w * x), 1.0 - 2.0 * (x * x + y * y)),
+    );
+    let m = mat3x3f(r[0] * scale.x, r[1] * scale.y, r[2] * scale.z);
+    return m * transpose(m);
+}
+
+// Covariance in pixels (y up) of a splat at view space t, as (xx, xy, yy). focal and
+// viewport are in pixels. Linearized perspective, see EWA splatting.
+fn project_covariance(cov: mat3x3f, t: vec3f, view: mat4x4f, focal: vec2f, viewport: vec2f) -> vec3f {
+    // The camera looks down -z
+    let d = -t.z;
+    // The linearization falls apart far off screen
+    let limit = 1.3 * 0.5 * viewport / focal;
+    let xy = clamp(t.xy / d, -limit, limit) * d;
+    let j = mat3x3f(
+        vec3f(focal.x / d, 0.0, 0.0),
+        vec3f(0.0, focal.y / d, 0.0),
+        vec3f(focal.x * xy.x / (d * d), focal.y * xy.y / (d * d), 0.0),
+    );
+    let w = mat3x3f(view[0].xyz, view[1].xyz, view[2].xyz);
+    let m = j * w;
+    let projected = m * cov * transpose(m);
+    return vec3f(projected[0][0] + LOW_PASS, projected[0][1], projected[1][1] + LOW_PASS);
+}
+
+// Ellipse of a projected covariance
+struct Footprint {
+    // Unit major axis, the minor one is perpendicular to it (pixels, y up)
+    axis: vec2f,
+    // Standard deviations along the major and the minor axis, in pixels
+    sigma: vec2f,
+    // Standard deviations it reaches out to: until opacity * exp(-r^2 / 2) drops
+    // below MIN_ALPHA, at most MAX_SIGMA
+    extent: f32,
+}
+
+fn splat_footprint(cov: vec3f, opacity: f32) -> Footprint {
+    // Eigen decomposition of [[a, b], [b, c]]
+    let mid = 0.5 * (cov.x + cov.z);
+    let radius = length(vec2f(0.5 * (cov.x - cov.z), cov.y));
+    let lambda1 = mid + radius;
+    let lambda2 = max(mid - radius, 0.0);
+    // Either is the major axis (unless zero), the longer one is better conditioned
+    let v1 = vec2f(lambda1 - cov.z, cov.y);
+    let v2 = vec2f(cov.y, lambda1 - cov.x);
+    let major = select(v2, v1, dot(v1, v1) >= dot(v2, v2));
+
+    var footprint: Footprint;
+    footprint.axis = select(vec2f(1.0, 0.0), normalize(major), dot(major, major) > 1e-12);
+    footprint.sigma = sqrt(vec2f(lambda1, lambda2));
+    footprint.extent = min(MAX_SIGMA, sqrt(2.0 * log(opacity / MIN_ALPHA)));
+    return footprint;
+}
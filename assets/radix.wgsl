@@ -0,0 +1,155 @@
+// LSD radix sort of (depth key, splat index) pairs, 4 bits per pass. The keys and the
+// count come from transform_main. Every pass is count_main -> scan_main -> scatter_main
+// (reduce-then-scan).
+
+const RADIX_BITS: u32 = 4u;
+const RADIX_SIZE: u32 = 16u;
+const WORKGROUP_SIZE: u32 = 256u;
+const ITEMS_PER_THREAD: u32 = 4u;
+const BLOCK_SIZE: u32 = 1024u;
+
+struct RadixParams {
+    shift: u32,
+}
+
+@group(0) @binding(0) var<uniform> params: RadixParams;
+@group(0) @binding(1) var<storage, read> keysIn: array<u32>;
+@group(0) @binding(2) var<storage, read> valuesIn: array<u32>;
+@group(0) @binding(3) var<storage, read_write> keysOut: array<u32>;
+@group(0) @binding(4) var<storage, read_write> valuesOut: array<u32>;
+// Digit major: histograms[digit * blocks + block]
+@group(0) @binding(5) var<storage, read_write> histograms: array<u32>;
+// Number of visible splats, only the first sortCount keys are sorted
+@group(0) @binding(6) var<storage, read> sortCount: u32;
+
+var<workgroup> sHistogram: array<atomic<u32>, RADIX_SIZE>;
+// Two halves, the scan ping-pongs between them
+var<workgroup> sScan: array<u32, 2u * WORKGROUP_SIZE>;
+// 16 digits as packed 16 bit counters, digits 0..7 in lo and 8..15 in hi
+var<workgroup> sRanksLo: array<vec4<u32>, WORKGROUP_SIZE>;
+var<workgroup> sRanksHi: array<vec4<u32>, WORKGROUP_SIZE>;
+var<workgroup> sDigitOffsets: array<u32, RADIX_SIZE>;
+
+fn radix_digit(key: u32) -> u32 {
+    return (key >> params.shift) & (RADIX_SIZE - 1u);
+}
+
+fn radix_blocks() -> u32 {
+    return max((sortCount + BLOCK_SIZE - 1u) / BLOCK_SIZE, 1u);
+}
+
+fn packed_count(lo: vec4<u32>, hi: vec4<u32>, digit: u32) -> u32 {
+    let word = digit >> 1u;
+    var packed: u32;
+    if (word < 4u) {
+        packed = lo[word];
+    } else {
+        packed = hi[word - 4u];
+    }
+    return (packed >> ((digit & 1u) * 16u)) & 0xffffu;
+}
+
+@compute @workgroup_size(256)
+fn count_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let i = wid.x * BLOCK_SIZE + k * WORKGROUP_SIZE + t;
+        if (i < sortCount) {
+            atomicAdd(&sHistogram[radix_digit(keysIn[i])], 1u);
+        }
+    }
+    workgroupBarrier();
+    if (t < RADIX_SIZE) {
+        histograms[t * radix_blocks() + wid.x] = atomicLoad(&sHistogram[t]);
+    }
+}
+
+// Exclusive scan of the whole histogram in a single workgroup
+@compute @workgroup_size(256)
+fn scan_main(@builtin(local_invocation_index) t: u32) {
+    let len = RADIX_SIZE * radix_blocks();
+    let perThread = (len + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE;
+    let begin = min(t * perThread, len);
+    let end = min(begin + perThread, len);
+
+    var sum = 0u;
+    for (var i = begin; i < end; i++) {
+        sum += histograms[i];
+    }
+
+    // One barrier per step, every step writes the other half
+    var inclusive = sum;
+    var src = 0u;
+    sScan[t] = inclusive;
+    for (var offset = 1u; offset < WORKGROUP_SIZE; offset <<= 1u) {
+        workgroupBarrier();
+        if (t >= offset) {
+            inclusive += sScan[src + t - offset];
+        }
+        src = WORKGROUP_SIZE - src;
+        sScan[src + t] = inclusive;
+    }
+
+    var prefix = inclusive - sum;
+    for (var i = begin; i < end; i++) {
+        let count = histograms[i];
+        histograms[i] = prefix;
+        prefix += count;
+    }
+}
+
+@compute @workgroup_size(256)
+fn scatter_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) t: u32) {
+    if (t < RADIX_SIZE) {
+        sDigitOffsets[t] = histograms[t * radix_blocks() + wid.x];
+    }
+
+    // Rows of 256 elements in order, so equal digits keep their relative order
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let i = wid.x * BLOCK_SIZE + k * WORKGROUP_SIZE + t;
+        let valid = i < sortCount;
+        var key = 0u;
+        var digit = 0u;
+        var lo = vec4<u32>(0u);
+        var hi = vec4<u32>(0u);
+        if (valid) {
+            key = keysIn[i];
+            digit = radix_digit(key);
+            let one = 1u << ((digit & 1u) * 16u);
+            let word = digit >> 1u;
+            if (word < 4u) {
+                lo[word] = one;
+            } else {
+                hi[word - 4u] = one;
+            }
+        }
+
+        // Inclusive scan of the one-hot digit counters gives the rank within the row
+        sRanksLo[t] = lo;
+        sRanksHi[t] = hi;
+        workgroupBarrier();
+        for (var offset = 1u; offset < WORKGROUP_SIZE; offset <<= 1u) {
+            if (t >= offset) {
+                lo += sRanksLo[t - offset];
+                hi += sRanksHi[t - offset];
+            }
+            workgroupBarrier();
+            sRanksLo[t] = lo;
+            sRanksHi[t] = hi;
+            workgroupBarrier();
+        }
+
+        if (valid) {
+            let dst = sDigitOffsets[digit] + packed_count(lo, hi, digit) - 1u;
+            keysOut[dst] = key;
+            valuesOut[dst] = valuesIn[i];
+        }
+        var rowCount = 0u;
+        if (t < RADIX_SIZE) {
+            rowCount = packed_count(sRanksLo[WORKGROUP_SIZE - 1u], sRanksHi[WORKGROUP_SIZE - 1u], t);
+        }
+        workgroupBarrier();
+        if (t < RADIX_SIZE) {
+            sDigitOffsets[t] += rowCount;
+        }
+    }
+}
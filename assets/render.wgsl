@@ -1,73 +1,66 @@
-struct Splat {
-    @align(16) pos: vec3f,
-    @align(16) scale: vec3f,
-    @align(4) color: u32,
-    @align(4) rotation: u32,
-}
+// RenderRecord and real come from precision-f32.wgsl / precision-f16.wgsl, MIN_ALPHA
+// from projection.wgsl, which main.c prepends
 
 struct VertexOutput {
     @builtin(position) pos: vec4f,
-    @location(0) @interpolate(perspective) offset: vec2f,
-    @location(1) @interpolate(flat) scale: vec3f,
-    @location(2) @interpolate(flat) depth: f32,
-    @location(3) @interpolate(flat) color: u32,
-    @location(4) @interpolate(flat) rotation: u32,
+    // Position along the axes of the projected gaussian, in standard deviations
+    @location(0) @interpolate(linear) offset: vec2f,
+    // Premultiplied
+    @location(1) @interpolate(flat) color: vec4f,
 }
 
-struct Uniforms {
-    viewProj: mat4x4<f32>,
-    scale: f32,
+@group(0) @binding(0) var<storage, read> records: array<RenderRecord>;
+@group(0) @binding(1) var<storage, read> sorted: array<u32>;
+// First instance of the draw, front to back the splats are drawn in batches. Written
+// by cull_finalize_main (INDIRECT_DRAW_BATCHES in compute.wgsl).
+struct DrawBatch {
+    base: u32,
 }
+@group(0) @binding(2) var<uniform> batch: DrawBatch;
 
-@group(0) @binding(0) var<uniform> uniforms: Uniforms;
-@group(0) @binding(1) var<storage, read> splats: array<Splat>;
-@group(0) @binding(2) var<storage, read> transformedPos: array<vec4f>;
-@group(0) @binding(3) var<storage, read> sorted: array<u32>;
-
-
-@vertex
-fn vs_main(
-    @builtin(vertex_index) vIdx: u32,
-    @builtin(instance_index) iIdx: u32,
-) -> VertexOutput {
+// The projection and the quad fit happen once per view in write_record (compute.wgsl)
+fn quad_vertex(record: RenderRecord, vIdx: u32) -> VertexOutput {
     var quad = array(
         vec2f(1, -1),
         vec2f(1, 1),
         vec2f(-1, -1),
         vec2f(-1, 1),
     );
-    let sIdx = sorted[iIdx];
-    let splat = splats[sIdx];
-    let pos = transformedPos[sIdx];
-    let s = uniforms.scale;
-    let z = max(pos.z, 1.0);
-    //let z = pos.z;
+    // extent 0 collapses the quad, nothing is rasterized
+    let corner = quad[vIdx] * record_extent(record);
+    let axes = record_axes(record);
 
     var out: VertexOutput;
-    out.pos = pos + vec4f(quad[vIdx] * (s / z), 0.0, 0.0);
-    out.offset = quad[vIdx];
-    //out.offset = quad[vIdx] * (s / z);
-    out.scale = splat.scale;
-    out.depth = s / z;
-    out.color = splat.color;
-    out.rotation = splat.rotation;
-    //out.pos.w = 0.0;
+    out.pos = vec4f(record.center + corner.x * axes.xy + corner.y * axes.zw, 0.0, 1.0);
+    out.offset = corner;
+    out.color = unpack4x8unorm(record.color);
     return out;
 }
 
-@fragment
-fn fs_main(in: VertexOutput) -> @location(0) vec4f {
-    let r = f32((in.color >> 0) & 0xff) / 255.0f;
-    let g = f32((in.color >> 8) & 0xff) / 255.0f;
-    let b = f32((in.color >> 16) & 0xff) / 255.0f;
-    let a = f32((in.color >> 24) & 0xff) / 255.0f;
-    let color = vec4f(r, g, b, a);
-
-    let offset = sqrt(dot(in.offset, in.offset));
-    let sigma = 1 / in.depth; // (s / z) ^ (-1)
-    let gaus = exp(-0.5 * offset * offset * sigma);
-    let finalAlpha = color.a * gaus;
+@vertex
+fn vs_main(
+    @builtin(vertex_index) vIdx: u32,
+    @builtin(instance_index) iIdx: u32,
+) -> VertexOutput {
+    return quad_vertex(records[sorted[batch.base + iIdx]], vIdx);
+}
 
+// records already are in draw order (gather_main in compute.wgsl), sorted is unused
+@vertex
+fn vs_gathered_main(
+    @builtin(vertex_index) vIdx: u32,
+    @builtin(instance_index) iIdx: u32,
+) -> VertexOutput {
+    return quad_vertex(records[batch.base + iIdx], vIdx);
+}
 
-    return vec4f(color.rgb,  finalAlpha);
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    let offset = vec2<real>(in.offset);
+    let color = vec4<real>(in.color);
+    let falloff = exp(real(-0.5) * dot(offset, offset));
+    if (color.a * falloff < real(MIN_ALPHA)) {
+        discard;
+    }
+    return vec4f(color * falloff);
 }
@@ -0,0 +1,238 @@
+// Tile based rasterizer: splats are binned into TILE_SIZE x TILE_SIZE screen tiles,
+// sorted by (tile, depth) with radix.wgsl and composited front to back per pixel.
+// tile_project_main -> tile_finalize_main -> radix sort -> tile_ranges_main -> tile_render_main
+
+// Splat comes from precision-f32.wgsl / precision-f16.wgsl, the projection from
+// projection.wgsl, tileRendererInit prepends them
+
+struct TileUniforms {
+    viewProj: mat4x4<f32>,
+    view: mat4x4<f32>,
+    // Pixels per unit of view space x / z and y / z
+    focal: vec2f,
+    width: u32,
+    height: u32,
+    tilesX: u32,
+    tilesY: u32,
+    // The tile index takes the top tileBits of a key, depth the rest
+    tileBits: u32,
+    capacity: u32,
+}
+
+// Screen space footprint of a splat, in pixels
+struct Projected {
+    center: vec2f,
+    // Pixel offset to standard deviations along the major / minor axis (dot product)
+    major: vec2f,
+    minor: vec2f,
+    // Standard deviations the quad would reach out to
+    extent: f32,
+    color: u32,
+}
+
+@group(0) @binding(0) var<uniform> tUniforms: TileUniforms;
+@group(0) @binding(1) var<storage, read> tSplats: array<Splat>;
+@group(0) @binding(2) var<storage, read_write> tProjected: array<Projected>;
+// Instances allocated by tile_project_main, may exceed the capacity
+@group(0) @binding(3) var<storage, read_write> tAllocated: atomic<u32>;
+// Instances that were written, what the sort and tile_ranges_main cover
+@group(0) @binding(4) var<storage, read_write> tCount: u32;
+@group(0) @binding(5) var<storage, read_write> tKeys: array<u32>;
+@group(0) @binding(6) var<storage, read_write> tValues: array<u32>;
+// [begin, end) of every tile in the sorted instances
+@group(0) @binding(7) var<storage, read_write> tRanges: array<vec2u>;
+@group(0) @binding(8) var tOutput: texture_storage_2d<rgba8unorm, write>;
+
+// Only bound for tile_finalize_main, see TILE_INDIRECT_* for the layout
+@group(1) @binding(0) var<storage, read_write> tIndirect: array<u32>;
+
+// Must match tile-render.h
+const TILE_SIZE: u32 = 16u;
+const TILE_INDIRECT_RADIX_BLOCKS: u32 = 0u;
+const TILE_INDIRECT_RANGE_GROUPS: u32 = 3u;
+
+const TILE_BATCH: u32 = TILE_SIZE * TILE_SIZE;
+// A pixel stops once less than this much of the background shows through
+const TILE_MIN_TRANSMITTANCE: f32 = 1.0 / 255.0;
+
+// Same footprint write_record (compute.wgsl) fits the quads to
+@compute @workgroup_size(256)
+fn tile_project_main(@builtin(global_invocation_id) id: vec3u) {
+    if (id.x >= arrayLength(&tSplats)) {
+        return;
+    }
+    let splat = tSplats[id.x];
+    let color = unpack4x8unorm(splat.color);
+    let pos = tUniforms.viewProj * vec4f(splat.pos, 1.0);
+    let t = (tUniforms.view * vec4f(splat.pos, 1.0)).xyz;
+    if (color.a < MIN_ALPHA || t.z >= 0.0 || pos.z < 0.0 || pos.z > pos.w) {
+        return;
+    }
+
+    let size = vec2f(f32(tUniforms.width), f32(tUniforms.height));
+    let cov = project_covariance(splat_covariance(splat_scale(splat), splat.rotation), t, tUniforms.view,
+                                 tUniforms.focal, size);
+    let footprint = splat_footprint(cov, color.a);
+    // Pixels have y down here
+    let major = vec2f(footprint.axis.x, -footprint.axis.y);
+    let minor = vec2f(-major.y, major.x);
+    // Bounds of the oriented box the quad covers
+    let bounds = footprint.extent * (abs(major) * footprint.sigma.x + abs(minor) * footprint.sigma.y);
+    let ndc = pos.xy / pos.w;
+    let center = vec2f(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5) * size;
+    if (footprint.extent <= 0.0 || any(center + bounds < vec2f(0.0)) || any(center - bounds > size)) {
+        return;
+    }
+
+    var projected: Projected;
+    projected.center = center;
+    projected.major = major / footprint.sigma.x;
+    projected.minor = minor / max(footprint.sigma.y, 1e-6);
+    projected.extent = footprint.extent;
+    projected.color = splat.color;
+    tProjected[id.x] = projected;
+
+    let tiles = vec2i(i32(tUniforms.tilesX), i32(tUniforms.tilesY));
+    let lo = clamp(vec2i(floor((center - bounds) / f32(TILE_SIZE))), vec2i(0), tiles - 1);
+    let hi = clamp(vec2i(floor((center + bounds) / f32(TILE_SIZE))), vec2i(0), tiles - 1);
+    let count = u32((hi.x - lo.x + 1) * (hi.y - lo.y + 1));
+    let base = atomicAdd(&tAllocated, count);
+    if (base >= tUniforms.capacity) {
+        return;
+    }
+
+    // Front to back: positive floats order like their bits, the sign bit is always 0
+    let depth = (bitcast<u32>(pos.z) << 1u) >> tUniforms.tileBits;
+    // The allocation that crosses the capacity still writes the instances that fit, so
+    // every one of [0, tCount) tile_finalize_main hands to the sort was written this frame
+    let end = min(base + count, tUniforms.capacity);
+    var i = base;
+    for (var y = lo.y; y <= hi.y && i < end; y++) {
+        for (var x = lo.x; x <= hi.x && i < end; x++) {
+            let tile = u32(y) * tUniforms.tilesX + u32(x);
+            tKeys[i] = (tile << (32u - tUniforms.tileBits)) | depth;
+            tValues[i] = id.x;
+            i++;
+        }
+    }
+}
+
+// Turns the allocated instances into the sorted count and dispatch arguments
+@compute @workgroup_size(1)
+fn tile_finalize_main() {
+    let count = min(atomicLoad(&tAllocated), tUniforms.capacity);
+    tCount = count;
+    // Radix blocks (radix.wgsl BLOCK_SIZE)
+    tIndirect[TILE_INDIRECT_RADIX_BLOCKS + 0u] = max((count + 1023u) / 1024u, 1u);
+    tIndirect[TILE_INDIRECT_RADIX_BLOCKS + 1u] = 1u;
+    tIndirect[TILE_INDIRECT_RADIX_BLOCKS + 2u] = 1u;
+    tIndirect[TILE_INDIRECT_RANGE_GROUPS + 0u] = (count + 255u) / 256u;
+    tIndirect[TILE_INDIRECT_RANGE_GROUPS + 1u] = 1u;
+    tIndirect[TILE_INDIRECT_RANGE_GROUPS + 2u] = 1u;
+}
+
+fn key_tile(key: u32) -> u32 {
+    return key >> (32u - tUniforms.tileBits);
+}
+
+// Every tile boundary in the sorted keys sets one end of a range
+@compute @workgroup_size(256)
+fn tile_ranges_main(@builtin(global_invocation_id) id: vec3u) {
+    let count = tCount;
+    let i = id.x;
+    if (i >= count) {
+        return;
+    }
+    let tile = key_tile(tKeys[i]);
+    if (i == 0u || key_tile(tKeys[i - 1u]) != tile) {
+        tRanges[tile].x = i;
+    }
+    if (i == count - 1u || key_tile(tKeys[i + 1u]) != tile) {
+        tRanges[tile].y = i + 1u;
+    }
+}
+
+var<workgroup> sBatch: array<Projected, TILE_BATCH>;
+var<workgroup> sRange: vec2u;
+var<workgroup> sDone: atomic<u32>;
+var<workgroup> sAllDone: u32;
+
+// One workgroup per tile, one thread per pixel. The tile's splats are loaded in
+// batches of TILE_BATCH into workgroup memory.
+@compute @workgroup_size(16, 16)
+fn tile_render_main(@builtin(workgroup_id) wid: vec3u, @builtin(global_invocation_id) gid: vec3u,
+                    @builtin(local_invocation_index) t: u32) {
+    let inside = gid.x < tUniforms.width && gid.y < tUniforms.height;
+    let pixel = vec2f(gid.xy) + 0.5;
+    var color = vec3f(0.0);
+    var transmittance = 1.0;
+    var done = !inside;
+    if (done) {
+        atomicAdd(&sDone, 1u);
+    }
+    if (t == 0u) {
+        sRange = tRanges[wid.y * tUniforms.tilesX + wid.x];
+    }
+    let range = workgroupUniformLoad(&sRange);
+
+    for (var start = range.x; start < range.y; start += TILE_BATCH) {
+        if (start + t < range.y) {
+            sBatch[t] = tProjected[tValues[start + t]];
+        }
+        workgroupBarrier();
+
+        if (!done) {
+            let n = min(TILE_BATCH, range.y - start);
+            for (var k = 0u; k < n; k++) {
+                let splat = sBatch[k];
+                // Same falloff as fs_main, over the quad only
+                let d = pixel - splat.center;
+                let offset = vec2f(dot(d, splat.major), dot(d, splat.minor));
+                if (abs(offset.x) > splat.extent || abs(offset.y) > splat.extent) {
+                    continue;
+                }
+                let gaus = exp(-0.5 * dot(offset, offset));
+                let alpha = f32((splat.color >> 24u) & 0xffu) / 255.0 * gaus;
+                if (alpha < MIN_ALPHA) {
+                    continue;
+                }
+                let rgb = vec3f(f32(splat.color & 0xffu), f32((splat.color >> 8u) & 0xffu),
+                                f32((splat.color >> 16u) & 0xffu)) / 255.0;
+                color += transmittance * alpha * rgb;
+                transmittance *= 1.0 - alpha;
+                if (transmittance < TILE_MIN_TRANSMITTANCE) {
+                    done = true;
+                    atomicAdd(&sDone, 1u);
+                    break;
+                }
+            }
+        }
+
+        // The whole tile stops once every pixel is saturated
+        workgroupBarrier();
+        if (t == 0u) {
+            sAllDone = atomicLoad(&sDone);
+        }
+        if (workgroupUniformLoad(&sAllDone) == TILE_BATCH) {
+            break;
+        }
+    }
+
+    if (inside) {
+        // White background, like the clear color of the quad renderer
+        textureStore(tOutput, vec2i(gid.xy), vec4f(color + transmittance * vec3f(1.0), 1.0));
+    }
+}
+
+@group(0) @binding(9) var bTexture: texture_2d<f32>;
+
+@vertex
+fn vs_blit(@builtin(vertex_index) vIdx: u32) -> @builtin(position) vec4f {
+    let uv = vec2f(f32((vIdx << 1u) & 2u), f32(vIdx & 2u));
+    return vec4f(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+
+@fragment
+fn fs_blit(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+    return textureLoad(bTexture, vec2i(pos.xy), 0);
+}
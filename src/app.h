@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
 
 #include <webgpu/webgpu.h>
@@ -36,6 +37,9 @@ typedef struct AppState {
     WGPUTextureFormat format;
     WGPUSurfaceConfiguration config;
     WGPUTextureView view;
+    // Optional device features, enabled when the adapter has them
+    bool shaderF16;
+    bool timestampQuery;
 } AppState;
 
 typedef int (*AppInitFn)(const AppState *app, int argc, char **argv);
@@ -102,13 +106,34 @@ static bool _initWebGPU(AppState *state) {
         return false;
     }
 
+    const WGPUFeatureName optionalFeatures[] = {
+        WGPUFeatureName_ShaderF16,
+        WGPUFeatureName_TimestampQuery,
+    };
+    WGPUFeatureName features[sizeof(optionalFeatures) / sizeof(optionalFeatures[0])];
+    size_t featureCount = 0;
+    for (size_t i = 0; i < sizeof(optionalFeatures) / sizeof(optionalFeatures[0]); i++) {
+        if (wgpuAdapterHasFeature(state->adapter, optionalFeatures[i]))
+            features[featureCount++] = optionalFeatures[i];
+    }
+    // Default limits, except for storage buffers, which may hold tens of millions of u32s
+    WGPUSupportedLimits supported = {0};
+    wgpuAdapterGetLimits(state->adapter, &supported);
+    WGPURequiredLimits required = {0};
+    memset(&required.limits, 0xff, sizeof(required.limits));
+    required.limits.maxStorageBufferBindingSize = supported.limits.maxStorageBufferBindingSize;
+    required.limits.maxBufferSize = supported.limits.maxBufferSize;
     state->device = requestDeviceSync(state->adapter, &(WGPUDeviceDescriptor){
-        .requiredFeatureCount = 0,
+        .requiredFeatureCount = featureCount,
+        .requiredFeatures = features,
+        .requiredLimits = &required,
     });
     if (state->device == NULL) {
         fprintf(stderr, "Failed to create WebGPU device\n");
         return false;
     }
+    state->shaderF16 = wgpuDeviceHasFeature(state->device, WGPUFeatureName_ShaderF16);
+    state->timestampQuery = wgpuDeviceHasFeature(state->device, WGPUFeatureName_TimestampQuery);
 
     return true;
 }
@@ -0,0 +1,307 @@
+#include "cpu-sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "depth.h"
+#include "threads.h"
+
+#define CPU_SORT_MIN_CHUNK (32 * 1024)
+
+// Buckets of the incremental pass hold about this many splats, small enough
+// that insertion sort inside them is cheap
+#define BUCKET_TARGET_SIZE 8
+#define BUCKET_MIN_BITS 10
+#define BUCKET_MAX_BITS 18
+
+void cpuSortInit(CpuSort *sort, uint32_t count) {
+    CpuSortConfig config = sort->config.keyBits ? sort->config : CPU_SORT_CONFIG_DEFAULT;
+    cpuSortFree(sort);
+    sort->config = config;
+    sort->count = count;
+    radixSorterInit(&sort->radix, count);
+    sort->blockCount = (count + CPU_SORT_UPLOAD_BLOCK - 1) / CPU_SORT_UPLOAD_BLOCK;
+    sort->dirty = calloc(sort->blockCount ? sort->blockCount : 1, sizeof(*sort->dirty));
+    uint32_t bucketBits = BUCKET_MIN_BITS;
+    while (bucketBits < BUCKET_MAX_BITS && (1u << bucketBits) * BUCKET_TARGET_SIZE < count)
+        bucketBits++;
+    sort->bucketCount = 1u << bucketBits;
+    sort->bucketHistograms = malloc((size_t) threadsCount() * sort->bucketCount * sizeof(uint32_t));
+    sort->bucketStarts = malloc((sort->bucketCount + 1) * sizeof(uint32_t));
+    sort->reason = "not sorted yet";
+}
+
+void cpuSortFree(CpuSort *sort) {
+    radixSorterFree(&sort->radix);
+    free(sort->dirty);
+    free(sort->bucketHistograms);
+    free(sort->bucketStarts);
+    CpuSortConfig config = sort->config;
+    *sort = (CpuSort) {0};
+    sort->config = config;
+}
+
+static void markDirty(CpuSort *sort, uint32_t begin, uint32_t end) {
+    for (uint32_t b = begin / CPU_SORT_UPLOAD_BLOCK; b <= (end - 1) / CPU_SORT_UPLOAD_BLOCK; b++) {
+        atomic_store_explicit(&sort->dirty[b], 1, memory_order_relaxed);
+    }
+}
+
+void cpuSortMarkAllDirty(CpuSort *sort) {
+    if (sort->count > 0)
+        markDirty(sort, 0, sort->count);
+}
+
+bool cpuSortNextDirtyRange(CpuSort *sort, uint32_t *cursor, uint32_t *begin, uint32_t *end) {
+    uint32_t b = *cursor;
+    while (b < sort->blockCount && !atomic_load_explicit(&sort->dirty[b], memory_order_relaxed))
+        b++;
+    if (b >= sort->blockCount) {
+        *cursor = b;
+        return false;
+    }
+    uint32_t first = b;
+    while (b < sort->blockCount && atomic_load_explicit(&sort->dirty[b], memory_order_relaxed)) {
+        atomic_store_explicit(&sort->dirty[b], 0, memory_order_relaxed);
+        b++;
+    }
+    *cursor = b;
+    *begin = first * CPU_SORT_UPLOAD_BLOCK;
+    *end = glm_min(b * CPU_SORT_UPLOAD_BLOCK, sort->count);
+    return true;
+}
+
+typedef struct IncrementalJob {
+    CpuSort *sort;
+    const uint32_t *splatKeys;
+    uint32_t (*minMax)[2];
+    uint32_t *descents;
+    uint64_t *moves;
+    bool *overflow;
+    float bucketMin;
+    float bucketScale;
+} IncrementalJob;
+
+// Buckets are linear in depth, like the 16 bit radix keys
+static inline uint32_t bucketOf(const IncrementalJob *job, uint32_t key) {
+    uint32_t b = (uint32_t) ((floatFromSortKey(key) - job->bucketMin) * job->bucketScale);
+    return b < job->sort->bucketCount ? b : job->sort->bucketCount - 1;
+}
+
+// Keys of the new camera in the previous order
+static void gatherChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    IncrementalJob *job = userData;
+    uint32_t *keys = job->sort->radix.keys;
+    const uint32_t *order = job->sort->radix.values;
+    const uint32_t *splatKeys = job->splatKeys;
+
+    uint32_t descents = 0;
+    uint32_t lo = UINT32_MAX, hi = 0;
+    uint32_t prev = begin > 0 ? splatKeys[order[begin - 1]] : 0;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t k = splatKeys[order[i]];
+        descents += k < prev;
+        lo = k < lo ? k : lo;
+        hi = k > hi ? k : hi;
+        keys[i] = k;
+        prev = k;
+    }
+    job->descents[chunk] = descents;
+    job->minMax[chunk][0] = lo;
+    job->minMax[chunk][1] = hi;
+}
+
+static void bucketHistogramChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    IncrementalJob *job = userData;
+    const uint32_t *keys = job->sort->radix.keys;
+    uint32_t *hist = job->sort->bucketHistograms + (size_t) chunk * job->sort->bucketCount;
+    memset(hist, 0, job->sort->bucketCount * sizeof(*hist));
+    for (uint32_t i = begin; i < end; i++) {
+        hist[bucketOf(job, keys[i])]++;
+    }
+}
+
+// Stable, so every bucket keeps the previous relative order
+static void bucketScatterChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    IncrementalJob *job = userData;
+    RadixSorter *r = &job->sort->radix;
+    uint32_t *offsets = job->sort->bucketHistograms + (size_t) chunk * job->sort->bucketCount;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t k = r->keys[i];
+        uint32_t dst = offsets[bucketOf(job, k)]++;
+        r->tmpKeys[dst] = k;
+        r->tmpValues[dst] = r->values[i];
+    }
+}
+
+static void bucketInsertionChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    IncrementalJob *job = userData;
+    CpuSort *sort = job->sort;
+    uint32_t *keys = sort->radix.keys;
+    uint32_t *values = sort->radix.values;
+    const uint32_t *starts = sort->bucketStarts;
+
+    // Past this, radix sort would have been cheaper
+    uint64_t budget = 16ull * (starts[end] - starts[begin]) + 65536;
+    uint64_t moves = 0;
+    // Checked while shifting, so a single skewed bucket cannot go quadratic. The
+    // element in hand is put down first, the arrays stay a permutation for the radix
+    // sort that takes over.
+    bool overflow = false;
+    for (uint32_t b = begin; b < end && !overflow; b++) {
+        uint32_t first = starts[b], last = starts[b + 1];
+        for (uint32_t j = first + 1; j < last && !overflow; j++) {
+            uint32_t k = keys[j];
+            if (k >= keys[j - 1])
+                continue;
+            uint32_t v = values[j];
+            uint32_t p = j;
+            while (p > first && keys[p - 1] > k) {
+                keys[p] = keys[p - 1];
+                values[p] = values[p - 1];
+                p--;
+                if (++moves > budget) {
+                    overflow = true;
+                    break;
+                }
+            }
+            keys[p] = k;
+            values[p] = v;
+        }
+    }
+    job->overflow[chunk] = overflow;
+    job->moves[chunk] = moves;
+}
+
+// Upload only blocks whose order changed (the previous order is in tmpValues)
+static void diffChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    (void) chunk;
+    IncrementalJob *job = userData;
+    CpuSort *sort = job->sort;
+    for (uint32_t b = begin; b < end; b++) {
+        uint32_t first = b * CPU_SORT_UPLOAD_BLOCK;
+        uint32_t last = glm_min(first + CPU_SORT_UPLOAD_BLOCK, sort->count);
+        if (memcmp(sort->radix.values + first, sort->radix.tmpValues + first, (last - first) * sizeof(uint32_t)) != 0)
+            markDirty(sort, first, last);
+    }
+}
+
+static void swapRadixBuffers(RadixSorter *r) {
+    uint32_t *tmp = r->keys;
+    r->keys = r->tmpKeys;
+    r->tmpKeys = tmp;
+    tmp = r->values;
+    r->values = r->tmpValues;
+    r->tmpValues = tmp;
+}
+
+static void fullSort(CpuSort *sort, const float *posX, const float *posY, const float *posZ, mat4 viewProj) {
+    depthKeysCompute(posX, posY, posZ, sort->count, viewProj, sort->radix.keys, sort->radix.values);
+    radixSort(&sort->radix, sort->count, sort->config.keyBits);
+    cpuSortMarkAllDirty(sort);
+    sort->kind = CPU_SORT_FULL;
+}
+
+void cpuSortRun(CpuSort *sort, const float *posX, const float *posY, const float *posZ, mat4 viewProj) {
+    uint32_t n = sort->count;
+    sort->descents = 0;
+    sort->moves = 0;
+
+    // Order only depends on the direction depth is measured along
+    vec4 depthRow = {viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]};
+    vec3 dirNew, dirOld;
+    glm_vec3_normalize_to(depthRow, dirNew);
+    glm_vec3_normalize_to(sort->lastDepthRow, dirOld);
+    float angle = acosf(glm_clamp(glm_vec3_dot(dirNew, dirOld), -1.0f, 1.0f));
+    glm_vec4_copy(depthRow, sort->lastDepthRow);
+
+    if (!sort->config.incremental || !sort->hasOrder || angle > sort->config.maxAngle || n < 2) {
+        sort->reason = !sort->config.incremental ? "incremental off" : !sort->hasOrder ? "no previous order" : "camera jump";
+        fullSort(sort, posX, posY, posZ, viewProj);
+        sort->hasOrder = true;
+        return;
+    }
+
+    uint32_t chunks = parallelChunks(n, CPU_SORT_MIN_CHUNK);
+    uint32_t minMax[chunks][2];
+    uint32_t descents[chunks];
+    IncrementalJob job = {
+        .sort = sort,
+        .splatKeys = sort->radix.tmpKeys,
+        .minMax = minMax,
+        .descents = descents,
+    };
+    // Per splat keys go to the radix scratch, which is free between sorts
+    depthKeysCompute(posX, posY, posZ, n, viewProj, sort->radix.tmpKeys, NULL);
+    parallelFor(n, CPU_SORT_MIN_CHUNK, gatherChunk, &job);
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint32_t c = 0; c < chunks; c++) {
+        sort->descents += descents[c];
+        lo = minMax[c][0] < lo ? minMax[c][0] : lo;
+        hi = minMax[c][1] > hi ? minMax[c][1] : hi;
+    }
+    if (sort->descents == 0) {
+        sort->kind = CPU_SORT_NONE;
+        sort->reason = "already sorted";
+        return;
+    }
+    if (sort->descents > sort->config.maxDescents * n) {
+        // Radix sort is stable and fine with any starting order
+        radixSort(&sort->radix, n, sort->config.keyBits);
+        cpuSortMarkAllDirty(sort);
+        sort->kind = CPU_SORT_FULL;
+        sort->reason = "too many inversions";
+        return;
+    }
+
+    // One stable bucketing pass over the depth range. Coming from the previous
+    // order, its writes are close to sequential and the buckets nearly sorted.
+    float min = floatFromSortKey(lo);
+    float max = floatFromSortKey(hi);
+    job.bucketMin = min;
+    job.bucketScale = max > min ? sort->bucketCount / (max - min) : 0.0f;
+    parallelFor(n, CPU_SORT_MIN_CHUNK, bucketHistogramChunk, &job);
+    uint32_t buckets = sort->bucketCount;
+    uint32_t sum = 0;
+    for (uint32_t b = 0; b < buckets; b++) {
+        sort->bucketStarts[b] = sum;
+        for (uint32_t c = 0; c < chunks; c++) {
+            uint32_t *h = sort->bucketHistograms + (size_t) c * buckets + b;
+            uint32_t count = *h;
+            *h = sum;
+            sum += count;
+        }
+    }
+    sort->bucketStarts[buckets] = sum;
+    parallelFor(n, CPU_SORT_MIN_CHUNK, bucketScatterChunk, &job);
+    swapRadixBuffers(&sort->radix);
+
+    // Finish every bucket with an insertion sort
+    uint32_t bucketChunks = parallelChunks(buckets, 1024);
+    uint64_t moves[bucketChunks];
+    bool overflow[bucketChunks];
+    for (uint32_t c = 0; c < bucketChunks; c++) {
+        moves[c] = 0;
+        overflow[c] = false;
+    }
+    job.moves = moves;
+    job.overflow = overflow;
+    parallelFor(buckets, 1024, bucketInsertionChunk, &job);
+    bool overflowed = false;
+    for (uint32_t c = 0; c < bucketChunks; c++) {
+        sort->moves += moves[c];
+        overflowed |= overflow[c];
+    }
+    if (overflowed) {
+        radixSort(&sort->radix, n, sort->config.keyBits);
+        cpuSortMarkAllDirty(sort);
+        sort->kind = CPU_SORT_FULL;
+        sort->reason = "move budget exceeded";
+        return;
+    }
+
+    parallelFor(sort->blockCount, 16, diffChunk, &job);
+    sort->kind = CPU_SORT_INCREMENTAL;
+    sort->reason = "small view change";
+}
@@ -0,0 +1,81 @@
+#ifndef CPU_SORT_H
+#define CPU_SORT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "sort.h"
+
+// Granularity of partial sortedIndexBuffer uploads (in elements)
+#define CPU_SORT_UPLOAD_BLOCK 4096
+
+typedef enum CpuSortKind {
+    CPU_SORT_NONE,
+    CPU_SORT_FULL,
+    CPU_SORT_INCREMENTAL,
+} CpuSortKind;
+
+typedef struct CpuSortConfig {
+    bool incremental;
+    uint32_t keyBits;
+    // Depth direction change (radians) that counts as a camera jump
+    float maxAngle;
+    // Fraction of out of order neighbours above which the order is treated as lost
+    float maxDescents;
+} CpuSortConfig;
+
+static const CpuSortConfig CPU_SORT_CONFIG_DEFAULT = {
+    .incremental = true,
+    .keyBits = 32,
+    .maxAngle = 0.2f,
+    .maxDescents = 0.75f,
+};
+
+typedef struct CpuSort {
+    CpuSortConfig config;
+    uint32_t count;
+
+    // radix.values holds the current order, radix.keys its keys
+    RadixSorter radix;
+    bool hasOrder;
+    vec4 lastDepthRow;
+
+    atomic_uchar *dirty;
+    uint32_t blockCount;
+
+    uint32_t bucketCount;
+    uint32_t *bucketHistograms;
+    uint32_t *bucketStarts;
+
+    // Stats of the last cpuSortRun
+    CpuSortKind kind;
+    const char *reason;
+    uint32_t descents;
+    uint64_t moves;
+} CpuSort;
+
+void cpuSortInit(CpuSort *sort, uint32_t count);
+void cpuSortFree(CpuSort *sort);
+
+// Sorts the splats back to front for viewProj. In incremental mode the previous
+// order is the starting point: one stable bucketing pass over the depth range,
+// then insertion sort inside the (nearly sorted) buckets. Only blocks of the
+// order that actually changed are marked dirty.
+void cpuSortRun(CpuSort *sort, const float *posX, const float *posY, const float *posZ, mat4 viewProj);
+
+// Forget what the GPU has, next upload sends the whole order
+void cpuSortMarkAllDirty(CpuSort *sort);
+
+// Iterates and clears the dirty ranges of the order:
+//     uint32_t cursor = 0, begin, end;
+//     while (cpuSortNextDirtyRange(sort, &cursor, &begin, &end)) upload(begin, end);
+bool cpuSortNextDirtyRange(CpuSort *sort, uint32_t *cursor, uint32_t *begin, uint32_t *end);
+
+static inline const uint32_t *cpuSortOrder(const CpuSort *sort) {
+    return sort->radix.values;
+}
+
+#endif //CPU_SORT_H
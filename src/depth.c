@@ -0,0 +1,190 @@
+#include "depth.h"
+
+#include <stdatomic.h>
+
+#include "sort.h"
+#include "threads.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEPTH_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DEPTH_NEON
+#endif
+
+#define DEPTH_MIN_CHUNK (64 * 1024)
+
+typedef struct DepthJob DepthJob;
+typedef void (*DepthKernelFn)(const DepthJob *job, uint32_t begin, uint32_t end);
+
+struct DepthJob {
+    DepthKernelFn kernel;
+    const float *x, *y, *z;
+    uint32_t *keys;
+    uint32_t *values;
+    // Third row of viewProj, clip z = dot(row, (x, y, z, 1))
+    float row[4];
+};
+
+static void depthKernelScalar(const DepthJob *job, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        float depth = job->row[0] * job->x[i] + job->row[1] * job->y[i] + job->row[2] * job->z[i] + job->row[3];
+        job->keys[i] = depthSortKey(depth);
+        if (job->values)
+            job->values[i] = i;
+    }
+}
+
+#ifdef DEPTH_X86
+
+// depthSortKey for 4 lanes: negative depths keep their bits, positive get 0x7fffffff flipped
+__attribute__((target("sse2")))
+static inline __m128i depthKeySse2(__m128 depth) {
+    __m128i bits = _mm_castps_si128(depth);
+    return _mm_xor_si128(bits, _mm_andnot_si128(_mm_srai_epi32(bits, 31), _mm_set1_epi32(0x7fffffff)));
+}
+
+__attribute__((target("sse2")))
+static void depthKernelSse2(const DepthJob *job, uint32_t begin, uint32_t end) {
+    const __m128 r0 = _mm_set1_ps(job->row[0]);
+    const __m128 r1 = _mm_set1_ps(job->row[1]);
+    const __m128 r2 = _mm_set1_ps(job->row[2]);
+    const __m128 r3 = _mm_set1_ps(job->row[3]);
+    const __m128i four = _mm_set1_epi32(4);
+    __m128i index = _mm_add_epi32(_mm_set1_epi32((int) begin), _mm_setr_epi32(0, 1, 2, 3));
+
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        for (uint32_t h = 0; h < 8; h += 4) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(r0, _mm_loadu_ps(job->x + i + h)), r3);
+            d = _mm_add_ps(d, _mm_mul_ps(r1, _mm_loadu_ps(job->y + i + h)));
+            d = _mm_add_ps(d, _mm_mul_ps(r2, _mm_loadu_ps(job->z + i + h)));
+            _mm_storeu_si128((__m128i *) (job->keys + i + h), depthKeySse2(d));
+            if (job->values)
+                _mm_storeu_si128((__m128i *) (job->values + i + h), index);
+            index = _mm_add_epi32(index, four);
+        }
+    }
+    depthKernelScalar(job, i, end);
+}
+
+__attribute__((target("avx2,fma")))
+static void depthKernelAvx2(const DepthJob *job, uint32_t begin, uint32_t end) {
+    const __m256 r0 = _mm256_set1_ps(job->row[0]);
+    const __m256 r1 = _mm256_set1_ps(job->row[1]);
+    const __m256 r2 = _mm256_set1_ps(job->row[2]);
+    const __m256 r3 = _mm256_set1_ps(job->row[3]);
+    const __m256i flip = _mm256_set1_epi32(0x7fffffff);
+    const __m256i eight = _mm256_set1_epi32(8);
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int) begin), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    uint32_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        for (uint32_t h = 0; h < 16; h += 8) {
+            __m256 d = _mm256_fmadd_ps(r0, _mm256_loadu_ps(job->x + i + h), r3);
+            d = _mm256_fmadd_ps(r1, _mm256_loadu_ps(job->y + i + h), d);
+            d = _mm256_fmadd_ps(r2, _mm256_loadu_ps(job->z + i + h), d);
+            __m256i bits = _mm256_castps_si256(d);
+            __m256i key = _mm256_xor_si256(bits, _mm256_andnot_si256(_mm256_srai_epi32(bits, 31), flip));
+            _mm256_storeu_si256((__m256i *) (job->keys + i + h), key);
+            if (job->values)
+                _mm256_storeu_si256((__m256i *) (job->values + i + h), index);
+            index = _mm256_add_epi32(index, eight);
+        }
+    }
+    depthKernelSse2(job, i, end);
+}
+
+#endif
+
+#ifdef DEPTH_NEON
+
+static void depthKernelNeon(const DepthJob *job, uint32_t begin, uint32_t end) {
+    const float32x4_t r0 = vdupq_n_f32(job->row[0]);
+    const float32x4_t r1 = vdupq_n_f32(job->row[1]);
+    const float32x4_t r2 = vdupq_n_f32(job->row[2]);
+    const float32x4_t r3 = vdupq_n_f32(job->row[3]);
+    const uint32x4_t flip = vdupq_n_u32(0x7fffffff);
+    const uint32x4_t four = vdupq_n_u32(4);
+    const uint32_t first[4] = {0, 1, 2, 3};
+    uint32x4_t index = vaddq_u32(vdupq_n_u32(begin), vld1q_u32(first));
+
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        for (uint32_t h = 0; h < 8; h += 4) {
+            float32x4_t d = vmlaq_f32(r3, r0, vld1q_f32(job->x + i + h));
+            d = vmlaq_f32(d, r1, vld1q_f32(job->y + i + h));
+            d = vmlaq_f32(d, r2, vld1q_f32(job->z + i + h));
+            int32x4_t bits = vreinterpretq_s32_f32(d);
+            uint32x4_t negative = vreinterpretq_u32_s32(vshrq_n_s32(bits, 31));
+            uint32x4_t key = veorq_u32(vreinterpretq_u32_s32(bits), vbicq_u32(flip, negative));
+            vst1q_u32(job->keys + i + h, key);
+            if (job->values)
+                vst1q_u32(job->values + i + h, index);
+            index = vaddq_u32(index, four);
+        }
+    }
+    depthKernelScalar(job, i, end);
+}
+
+#endif
+
+typedef struct DepthKernel {
+    DepthKernelFn fn;
+    const char *isa;
+} DepthKernel;
+
+static const DepthKernel DEPTH_KERNEL_SCALAR = {depthKernelScalar, "scalar"};
+#if defined(DEPTH_X86)
+static const DepthKernel DEPTH_KERNEL_SSE2 = {depthKernelSse2, "sse2"};
+static const DepthKernel DEPTH_KERNEL_AVX2 = {depthKernelAvx2, "avx2"};
+#elif defined(DEPTH_NEON)
+static const DepthKernel DEPTH_KERNEL_NEON = {depthKernelNeon, "neon"};
+#endif
+
+// Read by the pool threads (through the sorts) and the render thread (depthKernelName).
+// Every caller picks the same kernel, so concurrent first uses only store it twice.
+static _Atomic(const DepthKernel *) depthKernel;
+
+static const DepthKernel *depthKernelSelect() {
+    const DepthKernel *kernel = atomic_load_explicit(&depthKernel, memory_order_acquire);
+    if (kernel)
+        return kernel;
+    kernel = &DEPTH_KERNEL_SCALAR;
+#if defined(DEPTH_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernel = &DEPTH_KERNEL_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        kernel = &DEPTH_KERNEL_SSE2;
+#elif defined(DEPTH_NEON)
+    kernel = &DEPTH_KERNEL_NEON;
+#endif
+    atomic_store_explicit(&depthKernel, kernel, memory_order_release);
+    return kernel;
+}
+
+const char *depthKernelName() {
+    return depthKernelSelect()->isa;
+}
+
+static void depthChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    (void) chunk;
+    const DepthJob *job = userData;
+    job->kernel(job, begin, end);
+}
+
+void depthKeysCompute(const float *posX, const float *posY, const float *posZ, uint32_t count,
+                      mat4 viewProj, uint32_t *keys, uint32_t *values) {
+    DepthJob job = {
+        .kernel = depthKernelSelect()->fn,
+        .x = posX,
+        .y = posY,
+        .z = posZ,
+        .keys = keys,
+        .values = values,
+        .row = {viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]},
+    };
+    parallelFor(count, DEPTH_MIN_CHUNK, depthChunk, &job);
+}
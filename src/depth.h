@@ -0,0 +1,18 @@
+#ifndef DEPTH_H
+#define DEPTH_H
+
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// Computes only the clip space depth of every splat and writes its sort key
+// (see depthSortKey) together with the identity index (values may be NULL),
+// on all threads. The widest instruction set the CPU supports is picked on
+// first use.
+void depthKeysCompute(const float *posX, const float *posY, const float *posZ, uint32_t count,
+                      mat4 viewProj, uint32_t *keys, uint32_t *values);
+
+// Name of the selected kernel ("avx2", "sse2", "neon" or "scalar")
+const char *depthKernelName();
+
+#endif //DEPTH_H
@@ -0,0 +1,468 @@
+#include "gpu-primitives.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+typedef struct PrimitiveParams {
+    alignas(16) uint32_t count;
+    uint32_t shift;
+    uint32_t bins;
+    uint32_t reset;
+} PrimitiveParams;
+_Static_assert(sizeof(PrimitiveParams) == 16, "");
+
+// Buffers of bindings 1 to 7 in primitives.wgsl, NULL ones get their emptyBuffers slot
+typedef struct PrimitiveBindings {
+    WGPUBuffer data;
+    WGPUBuffer sums;
+    WGPUBuffer flags;
+    WGPUBuffer sumFlags;
+    WGPUBuffer output;
+    WGPUBuffer result;
+    WGPUBuffer histogram;
+} PrimitiveBindings;
+
+static uint32_t blockCount(uint32_t count) {
+    return (count + GPU_PRIMITIVES_BLOCK - 1) / GPU_PRIMITIVES_BLOCK;
+}
+
+static WGPUComputePipeline createPipeline(const GpuPrimitives *prims, const char *entryPoint) {
+    return wgpuDeviceCreateComputePipeline(prims->device, &(WGPUComputePipelineDescriptor) {
+        .layout = prims->layout,
+        .compute = {
+            .module = prims->module,
+            .entryPoint = entryPoint,
+        }
+    });
+}
+
+void gpuPrimitivesInit(GpuPrimitives *prims, WGPUDevice device, WGPUQueue queue, uint32_t capacity) {
+    gpuPrimitivesFree(prims);
+    assert(capacity <= GPU_PRIMITIVES_MAX_COUNT);
+    prims->device = device;
+    prims->queue = queue;
+    prims->capacity = capacity;
+
+    char *shader = (char *) readFile("assets/primitives.wgsl");
+    prims->module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = "Primitives Shader",
+    });
+    free(shader);
+
+    prims->paramsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Primitive Params",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size = GPU_PRIMITIVES_SLOTS * GPU_PRIMITIVES_PARAMS_STRIDE,
+    });
+    uint32_t levelSize = capacity;
+    for (uint32_t level = 0; level < GPU_PRIMITIVES_MAX_LEVELS; level++) {
+        levelSize = blockCount(levelSize > 0 ? levelSize : 1);
+        prims->levelSums[level] = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+            .label = "Primitive Block Sums",
+            .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+            .size = levelSize * sizeof(uint32_t),
+        });
+        prims->levelFlags[level] = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+            .label = "Primitive Block Flags",
+            .usage = WGPUBufferUsage_Storage,
+            .size = levelSize * sizeof(uint32_t),
+        });
+    }
+    prims->indicesBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Primitive Compact Indices",
+        .usage = WGPUBufferUsage_Storage,
+        .size = (uint64_t) (capacity > 0 ? capacity : 1) * sizeof(uint32_t),
+    });
+    prims->countBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Primitive Compact Count",
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+        .size = 4 * sizeof(uint32_t),
+    });
+    for (uint32_t i = 0; i < 7; i++) {
+        prims->emptyBuffers[i] = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+            .label = "Primitive Unused Binding",
+            .usage = WGPUBufferUsage_Storage,
+            .size = 4 * sizeof(uint32_t),
+        });
+    }
+
+    // Everything is read_write storage, so in place calls never mix read-only and
+    // writable usages of one buffer
+    WGPUBindGroupLayoutEntry layoutEntries[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        layoutEntries[i] = (WGPUBindGroupLayoutEntry) {
+            .binding = i,
+            .visibility = WGPUShaderStage_Compute,
+            .buffer.type = WGPUBufferBindingType_Storage,
+        };
+    }
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[0].buffer.hasDynamicOffset = true;
+    prims->bindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 8,
+        .entries = layoutEntries,
+    });
+    prims->layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            prims->bindLayout,
+        },
+        .label = "Primitives Layout",
+    });
+
+    prims->reducePipeline = createPipeline(prims, "reduce_main");
+    prims->scanBlockPipeline = createPipeline(prims, "scan_block_main");
+    prims->scanAddPipeline = createPipeline(prims, "scan_add_main");
+    prims->segmentedBlockPipeline = createPipeline(prims, "segmented_block_main");
+    prims->segmentedAddPipeline = createPipeline(prims, "segmented_add_main");
+    prims->histogramPipeline = createPipeline(prims, "histogram_main");
+    prims->compactFlagsPipeline = createPipeline(prims, "compact_flags_main");
+    prims->compactScatterPipeline = createPipeline(prims, "compact_scatter_main");
+}
+
+void gpuPrimitivesFree(GpuPrimitives *prims) {
+    gpuPrimitivesReset(prims);
+    if (prims->reducePipeline) wgpuComputePipelineRelease(prims->reducePipeline);
+    if (prims->scanBlockPipeline) wgpuComputePipelineRelease(prims->scanBlockPipeline);
+    if (prims->scanAddPipeline) wgpuComputePipelineRelease(prims->scanAddPipeline);
+    if (prims->segmentedBlockPipeline) wgpuComputePipelineRelease(prims->segmentedBlockPipeline);
+    if (prims->segmentedAddPipeline) wgpuComputePipelineRelease(prims->segmentedAddPipeline);
+    if (prims->histogramPipeline) wgpuComputePipelineRelease(prims->histogramPipeline);
+    if (prims->compactFlagsPipeline) wgpuComputePipelineRelease(prims->compactFlagsPipeline);
+    if (prims->compactScatterPipeline) wgpuComputePipelineRelease(prims->compactScatterPipeline);
+    if (prims->layout) wgpuPipelineLayoutRelease(prims->layout);
+    if (prims->bindLayout) wgpuBindGroupLayoutRelease(prims->bindLayout);
+    if (prims->module) wgpuShaderModuleRelease(prims->module);
+    if (prims->paramsBuffer) wgpuBufferRelease(prims->paramsBuffer);
+    for (uint32_t level = 0; level < GPU_PRIMITIVES_MAX_LEVELS; level++) {
+        if (prims->levelSums[level]) wgpuBufferRelease(prims->levelSums[level]);
+        if (prims->levelFlags[level]) wgpuBufferRelease(prims->levelFlags[level]);
+    }
+    if (prims->indicesBuffer) wgpuBufferRelease(prims->indicesBuffer);
+    if (prims->countBuffer) wgpuBufferRelease(prims->countBuffer);
+    for (uint32_t i = 0; i < 7; i++) {
+        if (prims->emptyBuffers[i]) wgpuBufferRelease(prims->emptyBuffers[i]);
+    }
+    memset(prims, 0, sizeof(*prims));
+}
+
+void gpuPrimitivesReset(GpuPrimitives *prims) {
+    for (uint32_t slot = 0; slot < prims->slots; slot++) {
+        wgpuBindGroupRelease(prims->bindGroups[slot]);
+    }
+    prims->slots = 0;
+}
+
+// One workgroup per block of count elements, with its own params slot and bind group
+static void dispatch(GpuPrimitives *prims, WGPUComputePassEncoder pass, WGPUComputePipeline pipeline,
+                     PrimitiveParams params, PrimitiveBindings bindings) {
+    assert(prims->slots < GPU_PRIMITIVES_SLOTS && "gpuPrimitivesReset was not called after a submit");
+    uint32_t slot = prims->slots++;
+    uint32_t offset = slot * GPU_PRIMITIVES_PARAMS_STRIDE;
+    wgpuQueueWriteBuffer(prims->queue, prims->paramsBuffer, offset, &params, sizeof(params));
+
+    WGPUBuffer buffers[7] = {
+        bindings.data, bindings.sums, bindings.flags, bindings.sumFlags,
+        bindings.output, bindings.result, bindings.histogram,
+    };
+    WGPUBindGroupEntry entries[8];
+    entries[0] = (WGPUBindGroupEntry) {.binding = 0, .buffer = prims->paramsBuffer, .offset = 0, .size = sizeof(PrimitiveParams)};
+    for (uint32_t i = 0; i < 7; i++) {
+        WGPUBuffer buffer = buffers[i] ? buffers[i] : prims->emptyBuffers[i];
+        entries[i + 1] = (WGPUBindGroupEntry) {.binding = i + 1, .buffer = buffer, .offset = 0, .size = wgpuBufferGetSize(buffer)};
+    }
+    prims->bindGroups[slot] = wgpuDeviceCreateBindGroup(prims->device, &(WGPUBindGroupDescriptor) {
+        .layout = prims->bindLayout,
+        .entryCount = 8,
+        .entries = entries,
+        .label = "Primitives Bind Group",
+    });
+
+    wgpuComputePassEncoderSetPipeline(pass, pipeline);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, prims->bindGroups[slot], 1, &offset);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, blockCount(params.count), 1, 1);
+}
+
+// Scans every block, then the block totals one level down, then adds those back.
+// heads == NULL is a plain scan.
+static void encodeScan(GpuPrimitives *prims, WGPUComputePassEncoder pass, WGPUBuffer data, WGPUBuffer heads,
+                       uint32_t count, uint32_t level, bool reset) {
+    assert(level < GPU_PRIMITIVES_MAX_LEVELS);
+    PrimitiveParams params = {.count = count, .reset = reset};
+    PrimitiveBindings bindings = {
+        .data = data,
+        .sums = prims->levelSums[level],
+        .flags = heads,
+        .sumFlags = prims->levelFlags[level],
+    };
+    dispatch(prims, pass, heads ? prims->segmentedBlockPipeline : prims->scanBlockPipeline, params, bindings);
+    uint32_t blocks = blockCount(count);
+    if (blocks > 1) {
+        // The totals only carry across blocks, a head among them does not reset itself
+        encodeScan(prims, pass, prims->levelSums[level], heads ? prims->levelFlags[level] : NULL, blocks, level + 1, false);
+        dispatch(prims, pass, heads ? prims->segmentedAddPipeline : prims->scanAddPipeline, params, bindings);
+    }
+}
+
+void gpuPrimitivesScan(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count) {
+    assert(count <= prims->capacity);
+    if (count == 0)
+        return;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    encodeScan(prims, pass, data, NULL, count, 0, false);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+}
+
+void gpuPrimitivesSegmentedScan(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, WGPUBuffer heads,
+                                uint32_t count) {
+    assert(count <= prims->capacity);
+    if (count == 0)
+        return;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    encodeScan(prims, pass, data, heads, count, 0, true);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+}
+
+void gpuPrimitivesReduce(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count,
+                         WGPUBuffer result, uint64_t resultOffset) {
+    assert(count <= prims->capacity);
+    if (count == 0) {
+        wgpuCommandEncoderClearBuffer(encoder, result, resultOffset, sizeof(uint32_t));
+        return;
+    }
+    // Block sums of block sums until one is left
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    WGPUBuffer source = data;
+    for (uint32_t level = 0; ; level++) {
+        assert(level < GPU_PRIMITIVES_MAX_LEVELS);
+        dispatch(prims, pass, prims->reducePipeline, (PrimitiveParams) {.count = count},
+                 (PrimitiveBindings) {.data = source, .sums = prims->levelSums[level]});
+        source = prims->levelSums[level];
+        count = blockCount(count);
+        if (count == 1)
+            break;
+    }
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, source, 0, result, resultOffset, sizeof(uint32_t));
+}
+
+void gpuPrimitivesHistogram(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count,
+                            uint32_t shift, uint32_t bins, WGPUBuffer histogram) {
+    assert(count <= prims->capacity);
+    assert(bins > 0 && bins <= GPU_PRIMITIVES_MAX_BINS);
+    wgpuCommandEncoderClearBuffer(encoder, histogram, 0, bins * sizeof(uint32_t));
+    if (count == 0)
+        return;
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    dispatch(prims, pass, prims->histogramPipeline, (PrimitiveParams) {.count = count, .shift = shift, .bins = bins},
+             (PrimitiveBindings) {.data = data, .histogram = histogram});
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+}
+
+void gpuPrimitivesCompact(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer values, WGPUBuffer flags,
+                          uint32_t count, WGPUBuffer output, WGPUBuffer countBuffer, uint64_t countOffset) {
+    assert(count <= prims->capacity);
+    if (count == 0) {
+        wgpuCommandEncoderClearBuffer(encoder, countBuffer, countOffset, sizeof(uint32_t));
+        return;
+    }
+    // Output index = exclusive scan of the flags
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    PrimitiveParams params = {.count = count};
+    dispatch(prims, pass, prims->compactFlagsPipeline, params,
+             (PrimitiveBindings) {.sums = prims->indicesBuffer, .flags = flags});
+    encodeScan(prims, pass, prims->indicesBuffer, NULL, count, 0, false);
+    dispatch(prims, pass, prims->compactScatterPipeline, params, (PrimitiveBindings) {
+        .data = values,
+        .sums = prims->indicesBuffer,
+        .flags = flags,
+        .output = output,
+        .result = prims->countBuffer,
+    });
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, prims->countBuffer, 0, countBuffer, countOffset, sizeof(uint32_t));
+}
+
+#ifndef __EMSCRIPTEN__
+#include <stdio.h>
+#include <time.h>
+
+#include <webgpu/wgpu.h>
+
+#define BENCHMARK_RUNS 20
+
+static void submitAndWait(GpuPrimitives *prims, WGPUCommandEncoder encoder) {
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+    wgpuQueueSubmit(prims->queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    wgpuCommandEncoderRelease(encoder);
+    wgpuDevicePoll(prims->device, true, NULL);
+    gpuPrimitivesReset(prims);
+}
+
+static void onBenchmarkMapped(WGPUBufferMapAsyncStatus status, void *userdata) {
+    *(bool *) userdata = status == WGPUBufferMapAsyncStatus_Success;
+}
+
+static uint32_t readU32(GpuPrimitives *prims, WGPUBuffer buffer, uint64_t offset) {
+    WGPUBuffer staging = wgpuDeviceCreateBuffer(prims->device, &(WGPUBufferDescriptor) {
+        .label = "Benchmark Readback",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+        .size = sizeof(uint32_t),
+    });
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(prims->device, NULL);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, buffer, offset, staging, 0, sizeof(uint32_t));
+    submitAndWait(prims, encoder);
+
+    bool mapped = false;
+    wgpuBufferMapAsync(staging, WGPUMapMode_Read, 0, sizeof(uint32_t), onBenchmarkMapped, &mapped);
+    wgpuDevicePoll(prims->device, true, NULL);
+    uint32_t value = 0;
+    if (mapped) {
+        value = *(const uint32_t *) wgpuBufferGetConstMappedRange(staging, 0, sizeof(uint32_t));
+        wgpuBufferUnmap(staging);
+    }
+    wgpuBufferRelease(staging);
+    return value;
+}
+
+static WGPUBuffer createBenchmarkBuffer(WGPUDevice device, uint64_t size) {
+    return wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Benchmark Data",
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc,
+        .size = size,
+    });
+}
+
+typedef enum BenchmarkKind {
+    BENCH_SCAN,
+    BENCH_SEGMENTED_SCAN,
+    BENCH_REDUCE,
+    BENCH_HISTOGRAM,
+    BENCH_COMPACT,
+} BenchmarkKind;
+
+typedef struct BenchmarkBuffers {
+    uint32_t count;
+    WGPUBuffer values;
+    WGPUBuffer work;
+    WGPUBuffer flags;
+    WGPUBuffer heads;
+    WGPUBuffer output;
+    WGPUBuffer small;
+} BenchmarkBuffers;
+
+static void encodeBenchmark(GpuPrimitives *prims, WGPUCommandEncoder encoder, const BenchmarkBuffers *b, BenchmarkKind kind) {
+    switch (kind) {
+        case BENCH_SCAN: gpuPrimitivesScan(prims, encoder, b->work, b->count); break;
+        case BENCH_SEGMENTED_SCAN: gpuPrimitivesSegmentedScan(prims, encoder, b->work, b->heads, b->count); break;
+        case BENCH_REDUCE: gpuPrimitivesReduce(prims, encoder, b->values, b->count, b->small, 0); break;
+        case BENCH_HISTOGRAM: gpuPrimitivesHistogram(prims, encoder, b->values, b->count, 0, 256, b->small); break;
+        case BENCH_COMPACT: gpuPrimitivesCompact(prims, encoder, b->values, b->flags, b->count, b->output, b->small, 0); break;
+    }
+}
+
+void gpuPrimitivesBenchmark(WGPUDevice device, WGPUQueue queue) {
+    static const uint32_t counts[] = {1000000, 5000000, 10000000, 25000000, 50000000};
+    static const char *names[] = {"scan", "segscan", "reduce", "histogram", "compact"};
+    GpuPrimitives prims = {0};
+    gpuPrimitivesInit(&prims, device, queue, counts[sizeof(counts) / sizeof(counts[0]) - 1]);
+
+    printf("GPU primitives, average of %d runs (submit to completion):\n", BENCHMARK_RUNS);
+    printf("%10s  %-10s %10s %12s %8s  %s\n", "count", "primitive", "ms", "Melem/s", "GB/s", "check");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t n = counts[c];
+        uint64_t size = (uint64_t) n * sizeof(uint32_t);
+        // values i % 4, every third flag set, a segment every 1000 values
+        uint32_t *host = malloc(size);
+        BenchmarkBuffers b = {
+            .count = n,
+            .values = createBenchmarkBuffer(device, size),
+            .work = createBenchmarkBuffer(device, size),
+            .flags = createBenchmarkBuffer(device, size),
+            .heads = createBenchmarkBuffer(device, size),
+            .output = createBenchmarkBuffer(device, size),
+            .small = createBenchmarkBuffer(device, GPU_PRIMITIVES_MAX_BINS * sizeof(uint32_t)),
+        };
+        for (uint32_t i = 0; i < n; i++)
+            host[i] = i & 3;
+        wgpuQueueWriteBuffer(queue, b.values, 0, host, size);
+        for (uint32_t i = 0; i < n; i++)
+            host[i] = i % 3 == 0;
+        wgpuQueueWriteBuffer(queue, b.flags, 0, host, size);
+        for (uint32_t i = 0; i < n; i++)
+            host[i] = i % 1000 == 0;
+        wgpuQueueWriteBuffer(queue, b.heads, 0, host, size);
+        free(host);
+
+        for (BenchmarkKind kind = BENCH_SCAN; kind <= BENCH_COMPACT; kind++) {
+            // First run on fresh data is checked, the timed runs scan in place again
+            WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+            wgpuCommandEncoderCopyBufferToBuffer(encoder, b.values, 0, b.work, 0, size);
+            encodeBenchmark(&prims, encoder, &b, kind);
+            submitAndWait(&prims, encoder);
+
+            uint32_t last = n - 1, got = 0, expected = 0;
+            switch (kind) {
+                case BENCH_SCAN:
+                    got = readU32(&prims, b.work, (uint64_t) last * sizeof(uint32_t));
+                    expected = (last / 4) * 6 + (last % 4) * (last % 4 - 1) / 2;
+                    break;
+                case BENCH_SEGMENTED_SCAN: {
+                    got = readU32(&prims, b.work, (uint64_t) last * sizeof(uint32_t));
+                    for (uint32_t i = last - last % 1000; i < last; i++)
+                        expected += i & 3;
+                    break;
+                }
+                case BENCH_REDUCE:
+                    got = readU32(&prims, b.small, 0);
+                    expected = (n / 4) * 6 + (n % 4) * (n % 4 - 1) / 2;
+                    break;
+                case BENCH_HISTOGRAM:
+                    got = readU32(&prims, b.small, 1 * sizeof(uint32_t));
+                    expected = n / 4 + (n % 4 > 1);
+                    break;
+                case BENCH_COMPACT:
+                    got = readU32(&prims, b.small, 0);
+                    expected = (n + 2) / 3;
+                    break;
+            }
+
+            struct timespec start, end;
+            timespec_get(&start, TIME_UTC);
+            for (int run = 0; run < BENCHMARK_RUNS; run++) {
+                encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+                encodeBenchmark(&prims, encoder, &b, kind);
+                submitAndWait(&prims, encoder);
+            }
+            timespec_get(&end, TIME_UTC);
+            double seconds = ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9) / BENCHMARK_RUNS;
+            printf("%10u  %-10s %10.3f %12.1f %8.2f  %s\n", n, names[kind], seconds * 1000.0, n / seconds / 1e6,
+                   size / seconds / 1e9, got == expected ? "ok" : "MISMATCH");
+        }
+
+        wgpuBufferRelease(b.values);
+        wgpuBufferRelease(b.work);
+        wgpuBufferRelease(b.flags);
+        wgpuBufferRelease(b.heads);
+        wgpuBufferRelease(b.output);
+        wgpuBufferRelease(b.small);
+    }
+    gpuPrimitivesFree(&prims);
+}
+#endif
@@ -0,0 +1,85 @@
+#ifndef GPU_PRIMITIVES_H
+#define GPU_PRIMITIVES_H
+
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+// Must match assets/primitives.wgsl
+#define GPU_PRIMITIVES_BLOCK 1024
+#define GPU_PRIMITIVES_MAX_BINS 1024
+// One workgroup per block in a single dispatch dimension
+#define GPU_PRIMITIVES_MAX_COUNT (65535u * GPU_PRIMITIVES_BLOCK)
+// Levels of block totals a scan of GPU_PRIMITIVES_MAX_COUNT recurses through
+#define GPU_PRIMITIVES_MAX_LEVELS 3
+// Dispatches recorded between two gpuPrimitivesReset calls
+#define GPU_PRIMITIVES_SLOTS 64
+// minUniformBufferOffsetAlignment
+#define GPU_PRIMITIVES_PARAMS_STRIDE 256
+
+// Scan, segmented scan, reduce, histogram and compaction of u32 buffers. Every call
+// records its own compute pass(es) onto the encoder. The buffers passed in need
+// Storage usage and are not owned by GpuPrimitives.
+typedef struct GpuPrimitives {
+    WGPUDevice device;
+    WGPUQueue queue;
+    // Largest count of any call
+    uint32_t capacity;
+
+    WGPUShaderModule module;
+    WGPUBindGroupLayout bindLayout;
+    WGPUPipelineLayout layout;
+    WGPUComputePipeline reducePipeline;
+    WGPUComputePipeline scanBlockPipeline;
+    WGPUComputePipeline scanAddPipeline;
+    WGPUComputePipeline segmentedBlockPipeline;
+    WGPUComputePipeline segmentedAddPipeline;
+    WGPUComputePipeline histogramPipeline;
+    WGPUComputePipeline compactFlagsPipeline;
+    WGPUComputePipeline compactScatterPipeline;
+
+    // One params slot per dispatch, picked with a dynamic offset
+    WGPUBuffer paramsBuffer;
+    // Block totals (and whether a block has a segment head) of every recursion level
+    WGPUBuffer levelSums[GPU_PRIMITIVES_MAX_LEVELS];
+    WGPUBuffer levelFlags[GPU_PRIMITIVES_MAX_LEVELS];
+    // Output index of every compacted value
+    WGPUBuffer indicesBuffer;
+    WGPUBuffer countBuffer;
+    // Bound where a kernel has nothing to bind, one per binding so no buffer is
+    // bound writable twice
+    WGPUBuffer emptyBuffers[7];
+
+    // Used since the last reset, the bind groups live until then
+    uint32_t slots;
+    WGPUBindGroup bindGroups[GPU_PRIMITIVES_SLOTS];
+} GpuPrimitives;
+
+void gpuPrimitivesInit(GpuPrimitives *prims, WGPUDevice device, WGPUQueue queue, uint32_t capacity);
+void gpuPrimitivesFree(GpuPrimitives *prims);
+// Hands the params slots out again, call once the recorded commands were submitted
+void gpuPrimitivesReset(GpuPrimitives *prims);
+
+// In place exclusive prefix sum of count u32s
+void gpuPrimitivesScan(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count);
+// Same, but the sum restarts (at 0) at every nonzero entry of heads
+void gpuPrimitivesSegmentedScan(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, WGPUBuffer heads,
+                                uint32_t count);
+// Sum of count u32s, written to result at resultOffset (result needs CopyDst)
+void gpuPrimitivesReduce(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count,
+                         WGPUBuffer result, uint64_t resultOffset);
+// Counts (value >> shift) % bins of every value into the first bins u32s of histogram,
+// which are cleared first (histogram needs CopyDst)
+void gpuPrimitivesHistogram(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer data, uint32_t count,
+                            uint32_t shift, uint32_t bins, WGPUBuffer histogram);
+// The values with a nonzero flag, in order, to output. Their number is written to
+// countBuffer at countOffset (countBuffer needs CopyDst).
+void gpuPrimitivesCompact(GpuPrimitives *prims, WGPUCommandEncoder encoder, WGPUBuffer values, WGPUBuffer flags,
+                          uint32_t count, WGPUBuffer output, WGPUBuffer countBuffer, uint64_t countOffset);
+
+#ifndef __EMSCRIPTEN__
+// Prints the throughput of every primitive for 1M to 50M elements, blocks until done
+void gpuPrimitivesBenchmark(WGPUDevice device, WGPUQueue queue);
+#endif
+
+#endif //GPU_PRIMITIVES_H
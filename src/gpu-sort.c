@@ -0,0 +1,436 @@
+#include "gpu-sort.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+#ifndef __EMSCRIPTEN__
+#include <webgpu/wgpu.h>
+#endif
+
+typedef struct RadixParams {
+    alignas(16) uint32_t shift;
+} RadixParams;
+_Static_assert(sizeof(RadixParams) == 16, "");
+
+static WGPUComputePipeline createPipeline(WGPUDevice device, const GpuRadixSort *sort, const char *entryPoint) {
+    return wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor) {
+        .layout = sort->layout,
+        .compute = {
+            .module = sort->module,
+            .entryPoint = entryPoint,
+        }
+    });
+}
+
+static WGPUBindGroup createBindGroup(WGPUDevice device, WGPUBindGroupLayout layout, const GpuRadixSort *sort,
+                                     WGPUBuffer keysIn, WGPUBuffer valuesIn, WGPUBuffer keysOut, WGPUBuffer valuesOut) {
+    uint64_t size = (uint64_t) sort->count * sizeof(uint32_t);
+    return wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = layout,
+        .entryCount = 7,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = {.binding = 0, .buffer = sort->paramsBuffer, .offset = 0, .size = sizeof(RadixParams)},
+            [1] = {.binding = 1, .buffer = keysIn, .offset = 0, .size = size},
+            [2] = {.binding = 2, .buffer = valuesIn, .offset = 0, .size = size},
+            [3] = {.binding = 3, .buffer = keysOut, .offset = 0, .size = size},
+            [4] = {.binding = 4, .buffer = valuesOut, .offset = 0, .size = size},
+            [5] = {.binding = 5, .buffer = sort->histogramBuffer, .offset = 0, .size = wgpuBufferGetSize(sort->histogramBuffer)},
+            [6] = {.binding = 6, .buffer = sort->countBuffer, .offset = 0, .size = sizeof(uint32_t)},
+        },
+        .label = "Radix Sort Bind Group",
+    });
+}
+
+void gpuRadixSortInit(GpuRadixSort *sort, WGPUDevice device, WGPUQueue queue,
+                      WGPUBuffer keys, WGPUBuffer sortedIndex, uint32_t count,
+                      WGPUBuffer countBuffer, WGPUBuffer indirectBuffer, uint64_t indirectOffset) {
+    gpuRadixSortFree(sort);
+    sort->count = count;
+    sort->countBuffer = countBuffer;
+    sort->indirectBuffer = indirectBuffer;
+    sort->indirectOffset = indirectOffset;
+    sort->blocks = (count + GPU_RADIX_BLOCK_SIZE - 1) / GPU_RADIX_BLOCK_SIZE;
+    if (sort->blocks == 0)
+        sort->blocks = 1;
+
+    char *shader = (char *) readFile("assets/radix.wgsl");
+    sort->module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = "Radix Sort Shader",
+    });
+    free(shader);
+
+    sort->paramsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Radix Params",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size = GPU_RADIX_MAX_PASSES * GPU_RADIX_PARAMS_STRIDE,
+    });
+    // One slot per digit, selected with a dynamic offset
+    uint8_t params[GPU_RADIX_MAX_PASSES * GPU_RADIX_PARAMS_STRIDE];
+    memset(params, 0, sizeof(params));
+    for (uint32_t pass = 0; pass < GPU_RADIX_MAX_PASSES; pass++) {
+        RadixParams p = {
+            .shift = pass * GPU_RADIX_DIGIT_BITS,
+        };
+        memcpy(params + pass * GPU_RADIX_PARAMS_STRIDE, &p, sizeof(p));
+    }
+    wgpuQueueWriteBuffer(queue, sort->paramsBuffer, 0, params, sizeof(params));
+
+    uint64_t size = (uint64_t) (count ? count : 1) * sizeof(uint32_t);
+    sort->keysBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Radix Keys",
+        .usage = WGPUBufferUsage_Storage,
+        .size = size,
+    });
+    sort->valuesBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Radix Values",
+        .usage = WGPUBufferUsage_Storage,
+        .size = size,
+    });
+    sort->histogramBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Radix Histograms",
+        .usage = WGPUBufferUsage_Storage,
+        .size = (uint64_t) (1 << GPU_RADIX_DIGIT_BITS) * sort->blocks * sizeof(uint32_t),
+    });
+
+    WGPUBindGroupLayout bindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 7,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            [0] = {
+                .binding = 0,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_Uniform,
+                .buffer.hasDynamicOffset = true,
+            },
+            [1] = {
+                .binding = 1,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
+            },
+            [2] = {
+                .binding = 2,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
+            },
+            [3] = {
+                .binding = 3,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_Storage,
+            },
+            [4] = {
+                .binding = 4,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_Storage,
+            },
+            [5] = {
+                .binding = 5,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_Storage,
+            },
+            [6] = {
+                .binding = 6,
+                .visibility = WGPUShaderStage_Compute,
+                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
+            },
+        }
+    });
+    sort->layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            bindLayout,
+        },
+        .label = "Radix Sort Layout",
+    });
+    sort->bindGroups[0] = createBindGroup(device, bindLayout, sort, keys, sortedIndex, sort->keysBuffer, sort->valuesBuffer);
+    sort->bindGroups[1] = createBindGroup(device, bindLayout, sort, sort->keysBuffer, sort->valuesBuffer, keys, sortedIndex);
+    wgpuBindGroupLayoutRelease(bindLayout);
+
+    sort->countPipeline = createPipeline(device, sort, "count_main");
+    sort->scanPipeline = createPipeline(device, sort, "scan_main");
+    sort->scatterPipeline = createPipeline(device, sort, "scatter_main");
+}
+
+void gpuRadixSortFree(GpuRadixSort *sort) {
+    if (sort->bindGroups[0]) wgpuBindGroupRelease(sort->bindGroups[0]);
+    if (sort->bindGroups[1]) wgpuBindGroupRelease(sort->bindGroups[1]);
+    if (sort->countPipeline) wgpuComputePipelineRelease(sort->countPipeline);
+    if (sort->scanPipeline) wgpuComputePipelineRelease(sort->scanPipeline);
+    if (sort->scatterPipeline) wgpuComputePipelineRelease(sort->scatterPipeline);
+    if (sort->layout) wgpuPipelineLayoutRelease(sort->layout);
+    if (sort->module) wgpuShaderModuleRelease(sort->module);
+    if (sort->paramsBuffer) wgpuBufferRelease(sort->paramsBuffer);
+    if (sort->keysBuffer) wgpuBufferRelease(sort->keysBuffer);
+    if (sort->valuesBuffer) wgpuBufferRelease(sort->valuesBuffer);
+    if (sort->histogramBuffer) wgpuBufferRelease(sort->histogramBuffer);
+    memset(sort, 0, sizeof(*sort));
+}
+
+void gpuRadixSortEncode(const GpuRadixSort *sort, WGPUComputePassEncoder pass, uint32_t keyBits) {
+    // An even number of passes leaves the result in sortedIndex
+    assert(keyBits % (2 * GPU_RADIX_DIGIT_BITS) == 0 && keyBits <= 32);
+    if (sort->count == 0)
+        return;
+
+    // Least significant digit of the top keyBits first
+    uint32_t first = GPU_RADIX_MAX_PASSES - gpuRadixSortPasses(keyBits);
+    for (uint32_t digit = first; digit < GPU_RADIX_MAX_PASSES; digit++) {
+        uint32_t offset = digit * GPU_RADIX_PARAMS_STRIDE;
+        wgpuComputePassEncoderSetBindGroup(pass, 0, sort->bindGroups[(digit - first) & 1], 1, &offset);
+
+        wgpuComputePassEncoderSetPipeline(pass, sort->countPipeline);
+        wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+        wgpuComputePassEncoderSetPipeline(pass, sort->scanPipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+        wgpuComputePassEncoderSetPipeline(pass, sort->scatterPipeline);
+        wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+    }
+}
+
+typedef struct BucketParams {
+    alignas(16) uint32_t refineFrom;
+} BucketParams;
+_Static_assert(sizeof(BucketParams) == 16, "");
+
+static WGPUComputePipeline createBucketPipeline(WGPUDevice device, const GpuBucketSort *sort, const char *entryPoint) {
+    return wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor) {
+        .layout = sort->layout,
+        .compute = {
+            .module = sort->module,
+            .entryPoint = entryPoint,
+        }
+    });
+}
+
+void gpuBucketSortInit(GpuBucketSort *sort, WGPUDevice device, WGPUQueue queue, WGPUBuffer keys, WGPUBuffer sortedIndex,
+                       uint32_t count, WGPUBuffer countBuffer, WGPUBuffer indirectBuffer, uint64_t indirectOffset) {
+    gpuBucketSortFree(sort);
+    sort->count = count;
+    sort->indirectBuffer = indirectBuffer;
+    sort->indirectOffset = indirectOffset;
+
+    char *shader = (char *) readFile("assets/bucket.wgsl");
+    sort->module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = "Bucket Sort Shader",
+    });
+    free(shader);
+
+    uint64_t size = (uint64_t) (count ? count : 1) * sizeof(uint32_t);
+    sort->paramsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Params",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size = sizeof(BucketParams),
+    });
+    sort->keysBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Keys",
+        .usage = WGPUBufferUsage_Storage,
+        .size = size,
+    });
+    sort->valuesBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Values",
+        .usage = WGPUBufferUsage_Storage,
+        .size = size,
+    });
+    sort->countsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Counts",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc | WGPUBufferUsage_Storage,
+        .size = GPU_BUCKET_COUNT * sizeof(uint32_t),
+    });
+    sort->startsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Starts",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc | WGPUBufferUsage_Storage,
+        .size = (GPU_BUCKET_COUNT + 1) * sizeof(uint32_t),
+    });
+    sort->cursorsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Cursors",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+        .size = GPU_BUCKET_COUNT * sizeof(uint32_t),
+    });
+    sort->statsBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = "Bucket Stats",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc | WGPUBufferUsage_Storage,
+        .size = GPU_BUCKET_STATS * sizeof(uint32_t),
+    });
+    gpuReadbackInit(&sort->stats, device, GPU_BUCKET_STATS, "Bucket Stats Readback");
+    gpuPrimitivesInit(&sort->prims, device, queue, GPU_BUCKET_COUNT + 1);
+
+    WGPUBindGroupLayoutEntry layoutEntries[10];
+    for (uint32_t i = 0; i < 10; i++) {
+        layoutEntries[i] = (WGPUBindGroupLayoutEntry) {
+            .binding = i,
+            .visibility = WGPUShaderStage_Compute,
+            .buffer.type = WGPUBufferBindingType_Storage,
+        };
+    }
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[1].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    WGPUBindGroupLayout bindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 10,
+        .entries = layoutEntries,
+    });
+    sort->layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            bindLayout,
+        },
+        .label = "Bucket Sort Layout",
+    });
+    sort->bindGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = bindLayout,
+        .entryCount = 10,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = {.binding = 0, .buffer = sort->paramsBuffer, .offset = 0, .size = sizeof(BucketParams)},
+            [1] = {.binding = 1, .buffer = countBuffer, .offset = 0, .size = sizeof(uint32_t)},
+            [2] = {.binding = 2, .buffer = keys, .offset = 0, .size = size},
+            [3] = {.binding = 3, .buffer = sortedIndex, .offset = 0, .size = size},
+            [4] = {.binding = 4, .buffer = sort->keysBuffer, .offset = 0, .size = size},
+            [5] = {.binding = 5, .buffer = sort->valuesBuffer, .offset = 0, .size = size},
+            [6] = {.binding = 6, .buffer = sort->countsBuffer, .offset = 0, .size = wgpuBufferGetSize(sort->countsBuffer)},
+            [7] = {.binding = 7, .buffer = sort->startsBuffer, .offset = 0, .size = wgpuBufferGetSize(sort->startsBuffer)},
+            [8] = {.binding = 8, .buffer = sort->cursorsBuffer, .offset = 0, .size = wgpuBufferGetSize(sort->cursorsBuffer)},
+            [9] = {.binding = 9, .buffer = sort->statsBuffer, .offset = 0, .size = wgpuBufferGetSize(sort->statsBuffer)},
+        },
+        .label = "Bucket Sort Bind Group",
+    });
+    wgpuBindGroupLayoutRelease(bindLayout);
+
+    sort->rangePipeline = createBucketPipeline(device, sort, "bucket_range_main");
+    sort->countPipeline = createBucketPipeline(device, sort, "bucket_count_main");
+    sort->scatterPipeline = createBucketPipeline(device, sort, "bucket_scatter_main");
+    sort->refinePipeline = createBucketPipeline(device, sort, "bucket_refine_main");
+    sort->errorPipeline = createBucketPipeline(device, sort, "bucket_error_main");
+}
+
+void gpuBucketSortFree(GpuBucketSort *sort) {
+    if (sort->bindGroup) wgpuBindGroupRelease(sort->bindGroup);
+    if (sort->rangePipeline) wgpuComputePipelineRelease(sort->rangePipeline);
+    if (sort->countPipeline) wgpuComputePipelineRelease(sort->countPipeline);
+    if (sort->scatterPipeline) wgpuComputePipelineRelease(sort->scatterPipeline);
+    if (sort->refinePipeline) wgpuComputePipelineRelease(sort->refinePipeline);
+    if (sort->errorPipeline) wgpuComputePipelineRelease(sort->errorPipeline);
+    if (sort->layout) wgpuPipelineLayoutRelease(sort->layout);
+    if (sort->module) wgpuShaderModuleRelease(sort->module);
+    if (sort->paramsBuffer) wgpuBufferRelease(sort->paramsBuffer);
+    if (sort->keysBuffer) wgpuBufferRelease(sort->keysBuffer);
+    if (sort->valuesBuffer) wgpuBufferRelease(sort->valuesBuffer);
+    if (sort->countsBuffer) wgpuBufferRelease(sort->countsBuffer);
+    if (sort->startsBuffer) wgpuBufferRelease(sort->startsBuffer);
+    if (sort->cursorsBuffer) wgpuBufferRelease(sort->cursorsBuffer);
+    if (sort->statsBuffer) wgpuBufferRelease(sort->statsBuffer);
+    gpuReadbackFree(&sort->stats);
+    gpuPrimitivesFree(&sort->prims);
+    memset(sort, 0, sizeof(*sort));
+}
+
+void gpuBucketSortClear(GpuBucketSort *sort, WGPUQueue queue, WGPUCommandEncoder encoder, uint32_t refinedBuckets) {
+    BucketParams params = {
+        .refineFrom = refinedBuckets < GPU_BUCKET_COUNT ? GPU_BUCKET_COUNT - refinedBuckets : 0,
+    };
+    wgpuQueueWriteBuffer(queue, sort->paramsBuffer, 0, &params, sizeof(params));
+    wgpuCommandEncoderClearBuffer(encoder, sort->countsBuffer, 0, wgpuBufferGetSize(sort->countsBuffer));
+    wgpuCommandEncoderClearBuffer(encoder, sort->statsBuffer, 0, wgpuBufferGetSize(sort->statsBuffer));
+}
+
+void gpuBucketSortEncode(GpuBucketSort *sort, WGPUCommandEncoder encoder) {
+    if (sort->count == 0)
+        return;
+    // Last frame's scan was submitted since
+    gpuPrimitivesReset(&sort->prims);
+
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, sort->bindGroup, 0, NULL);
+    wgpuComputePassEncoderSetPipeline(pass, sort->rangePipeline);
+    wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+    wgpuComputePassEncoderSetPipeline(pass, sort->countPipeline);
+    wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+
+    // Exclusive scan of the sizes plus a trailing 0, which leaves the total in
+    // starts[GPU_BUCKET_COUNT]. The scatter hands out slots from a copy of the starts.
+    uint64_t bucketsSize = GPU_BUCKET_COUNT * sizeof(uint32_t);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, sort->countsBuffer, 0, sort->startsBuffer, 0, bucketsSize);
+    wgpuCommandEncoderClearBuffer(encoder, sort->startsBuffer, bucketsSize, sizeof(uint32_t));
+    gpuPrimitivesScan(&sort->prims, encoder, sort->startsBuffer, GPU_BUCKET_COUNT + 1);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, sort->startsBuffer, 0, sort->cursorsBuffer, 0, bucketsSize);
+
+    pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, sort->bindGroup, 0, NULL);
+    wgpuComputePassEncoderSetPipeline(pass, sort->scatterPipeline);
+    wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+    wgpuComputePassEncoderSetPipeline(pass, sort->refinePipeline);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, GPU_BUCKET_COUNT, 1, 1);
+    wgpuComputePassEncoderSetPipeline(pass, sort->errorPipeline);
+    wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, sort->indirectBuffer, sort->indirectOffset);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+}
+
+static void onReadbackMapped(WGPUBufferMapAsyncStatus status, void *userdata) {
+    GpuReadback *readback = userdata;
+    readback->state = status == WGPUBufferMapAsyncStatus_Success ? GPU_READBACK_MAPPED : GPU_READBACK_IDLE;
+}
+
+void gpuReadbackInit(GpuReadback *readback, WGPUDevice device, uint32_t count, const char *label) {
+    gpuReadbackFree(readback);
+    assert(count <= GPU_READBACK_MAX);
+    readback->device = device;
+    readback->count = count;
+    readback->buffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = label,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+        .size = count * sizeof(uint32_t),
+    });
+}
+
+void gpuReadbackFree(GpuReadback *readback) {
+    // A pending map still points its callback at readback: cancel it, and natively wait
+    // for the callback, so it cannot land on the cleared (or reused) struct
+    if (readback->state == GPU_READBACK_MAPPING) {
+        wgpuBufferUnmap(readback->buffer);
+#ifndef __EMSCRIPTEN__
+        while (readback->state == GPU_READBACK_MAPPING)
+            wgpuDevicePoll(readback->device, true, NULL);
+#endif
+    } else if (readback->state == GPU_READBACK_MAPPED) {
+        wgpuBufferUnmap(readback->buffer);
+    }
+    if (readback->buffer) wgpuBufferRelease(readback->buffer);
+    memset(readback, 0, sizeof(*readback));
+}
+
+void gpuReadbackCopy(GpuReadback *readback, WGPUCommandEncoder encoder, WGPUBuffer source, uint64_t offset) {
+    if (readback->state == GPU_READBACK_MAPPED) {
+        const uint32_t *data = wgpuBufferGetConstMappedRange(readback->buffer, 0, readback->count * sizeof(uint32_t));
+        memcpy(readback->data, data, readback->count * sizeof(uint32_t));
+        readback->hasData = true;
+        wgpuBufferUnmap(readback->buffer);
+        readback->state = GPU_READBACK_IDLE;
+    }
+    if (readback->state == GPU_READBACK_IDLE) {
+        wgpuCommandEncoderCopyBufferToBuffer(encoder, source, offset, readback->buffer, 0,
+                                             readback->count * sizeof(uint32_t));
+        readback->state = GPU_READBACK_COPIED;
+    }
+}
+
+void gpuReadbackMap(GpuReadback *readback) {
+    if (readback->state != GPU_READBACK_COPIED)
+        return;
+    readback->state = GPU_READBACK_MAPPING;
+    wgpuBufferMapAsync(readback->buffer, WGPUMapMode_Read, 0, readback->count * sizeof(uint32_t),
+                       onReadbackMapped, readback);
+}
@@ -0,0 +1,147 @@
+#ifndef GPU_SORT_H
+#define GPU_SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#include "gpu-primitives.h"
+
+// Must match assets/radix.wgsl
+#define GPU_RADIX_DIGIT_BITS 4
+#define GPU_RADIX_BLOCK_SIZE 1024
+#define GPU_RADIX_MAX_PASSES (32 / GPU_RADIX_DIGIT_BITS)
+// minUniformBufferOffsetAlignment
+#define GPU_RADIX_PARAMS_STRIDE 256
+
+// Must match assets/bucket.wgsl
+#define GPU_BUCKET_COUNT 4096
+// Largest bucket that is sorted exactly
+#define GPU_BUCKET_REFINE_SIZE 2048
+#define GPU_BUCKET_STAT_MIN_KEY_INV 0
+#define GPU_BUCKET_STAT_MAX_KEY 1
+#define GPU_BUCKET_STAT_INVERSIONS 2
+#define GPU_BUCKET_STAT_OVERSIZED 3
+#define GPU_BUCKET_STAT_COUNT 4
+#define GPU_BUCKET_STATS 8
+
+typedef enum GpuSortAlgorithm {
+    GPU_SORT_BITONIC,
+    GPU_SORT_RADIX,
+    GPU_SORT_BUCKET,
+    // Repairs last frame's order, escalates to GPU_SORT_RADIX when it is too far off
+    GPU_SORT_INCREMENTAL,
+} GpuSortAlgorithm;
+
+typedef struct GpuRadixSort {
+    // Capacity, the sorted count is read from countBuffer on the GPU
+    uint32_t count;
+    uint32_t blocks;
+    WGPUBuffer countBuffer;
+    // Holds the count and scatter workgroup counts at indirectOffset
+    WGPUBuffer indirectBuffer;
+    uint64_t indirectOffset;
+
+    WGPUShaderModule module;
+    WGPUPipelineLayout layout;
+    WGPUComputePipeline countPipeline;
+    WGPUComputePipeline scanPipeline;
+    WGPUComputePipeline scatterPipeline;
+
+    WGPUBuffer paramsBuffer;
+    // Scratch halves of the ping-pong, the other halves are the key and sorted index buffers
+    WGPUBuffer keysBuffer;
+    WGPUBuffer valuesBuffer;
+    WGPUBuffer histogramBuffer;
+    // [0] reads the key and sorted index buffers and writes the scratch, [1] the other way around
+    WGPUBindGroup bindGroups[2];
+} GpuRadixSort;
+
+// keys, sortedIndex, the u32 in countBuffer and the dispatch arguments in indirectBuffer
+// are written by the GPU before every sort. The buffers are not owned by the sorter.
+void gpuRadixSortInit(GpuRadixSort *sort, WGPUDevice device, WGPUQueue queue,
+                      WGPUBuffer keys, WGPUBuffer sortedIndex, uint32_t count,
+                      WGPUBuffer countBuffer, WGPUBuffer indirectBuffer, uint64_t indirectOffset);
+void gpuRadixSortFree(GpuRadixSort *sort);
+
+// Records one LSD pass per digit of the top keyBits (a multiple of 8) bits.
+// The order ends up in sortedIndex.
+void gpuRadixSortEncode(const GpuRadixSort *sort, WGPUComputePassEncoder pass, uint32_t keyBits);
+
+static inline uint32_t gpuRadixSortPasses(uint32_t keyBits) {
+    return keyBits / GPU_RADIX_DIGIT_BITS;
+}
+
+// Largest GpuReadback, in u32s
+#define GPU_READBACK_MAX 8
+
+typedef enum GpuReadbackState {
+    GPU_READBACK_IDLE,
+    GPU_READBACK_COPIED,
+    GPU_READBACK_MAPPING,
+    GPU_READBACK_MAPPED,
+} GpuReadbackState;
+
+// A few u32s copied back to the CPU without stalling, they arrive a couple of frames late
+typedef struct GpuReadback {
+    WGPUDevice device;
+    WGPUBuffer buffer;
+    uint32_t count;
+    GpuReadbackState state;
+    bool hasData;
+    uint32_t data[GPU_READBACK_MAX];
+} GpuReadback;
+
+void gpuReadbackInit(GpuReadback *readback, WGPUDevice device, uint32_t count, const char *label);
+void gpuReadbackFree(GpuReadback *readback);
+// Picks up mapped data, then records a copy of count u32s at offset in source unless
+// one is still in flight. Goes after the pass that writes them.
+void gpuReadbackCopy(GpuReadback *readback, WGPUCommandEncoder encoder, WGPUBuffer source, uint64_t offset);
+// Starts mapping the recorded copy, goes after the submit
+void gpuReadbackMap(GpuReadback *readback);
+
+// Approximate sort: GPU_BUCKET_COUNT depth buckets over the key range of the view,
+// exact order only inside the refined buckets
+typedef struct GpuBucketSort {
+    uint32_t count;
+
+    WGPUShaderModule module;
+    WGPUPipelineLayout layout;
+    WGPUComputePipeline rangePipeline;
+    WGPUComputePipeline countPipeline;
+    WGPUComputePipeline scatterPipeline;
+    WGPUComputePipeline refinePipeline;
+    WGPUComputePipeline errorPipeline;
+
+    WGPUBuffer paramsBuffer;
+    WGPUBuffer keysBuffer;
+    WGPUBuffer valuesBuffer;
+    WGPUBuffer countsBuffer;
+    WGPUBuffer startsBuffer;
+    WGPUBuffer cursorsBuffer;
+    WGPUBuffer statsBuffer;
+    WGPUBindGroup bindGroup;
+    // Scans the bucket sizes into their starts
+    GpuPrimitives prims;
+    // Holds the thread groups of one thread per element at indirectOffset
+    WGPUBuffer indirectBuffer;
+    uint64_t indirectOffset;
+
+    // GPU_BUCKET_STAT_* of an earlier sort
+    GpuReadback stats;
+} GpuBucketSort;
+
+// Same buffer contract as gpuRadixSortInit, indirectBuffer holds ceil(count / 256) groups
+void gpuBucketSortInit(GpuBucketSort *sort, WGPUDevice device, WGPUQueue queue, WGPUBuffer keys, WGPUBuffer sortedIndex,
+                       uint32_t count, WGPUBuffer countBuffer, WGPUBuffer indirectBuffer, uint64_t indirectOffset);
+void gpuBucketSortFree(GpuBucketSort *sort);
+
+// Resets the buckets before the compute pass, only the nearest refinedBuckets buckets
+// will be sorted exactly
+void gpuBucketSortClear(GpuBucketSort *sort, WGPUQueue queue, WGPUCommandEncoder encoder, uint32_t refinedBuckets);
+// Records its own compute passes, around the scan of the bucket sizes. The order ends up
+// in sortedIndex, statsBuffer holds GPU_BUCKET_STAT_*
+void gpuBucketSortEncode(GpuBucketSort *sort, WGPUCommandEncoder encoder);
+
+#endif //GPU_SORT_H
@@ -0,0 +1,586 @@
+// Renders a scene from a list of camera poses without a window or surface, for render
+// farm nodes and CI containers. Same transform, radix sort and quad draw as the viewer's
+// default path, into an offscreen texture that is read back asynchronously while the
+// next images render.
+//
+//   GaussianSplattingHeadless <scene.splat|.ply> <images.txt|cameras.json> [options]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <webgpu/webgpu.h>
+#include <webgpu/wgpu.h>
+
+#include "gpu-sort.h"
+#include "poses.h"
+#include "shader-types.h"
+#include "splat.h"
+#include "splat-pipeline.h"
+#include "threads.h"
+#include "utils.h"
+#include "webgpu-utils.h"
+
+#define HEADLESS_COLOR_FORMAT WGPUTextureFormat_RGBA8Unorm
+// Images between their render and their write. One is written while the others render.
+#define READBACK_SLOTS 3
+// copyTextureToBuffer rows are aligned to this
+#define COPY_ROW_ALIGNMENT 256
+
+typedef struct HeadlessConfig {
+    const char *scenePath;
+    const char *posesPath;
+    // NULL reads the images back without writing them
+    const char *outDir;
+    // Software / fallback adapter, also used when there is no other
+    bool fallback;
+    // Of the camera resolution
+    float scale;
+    // Renders the poses this many times (benchmarking)
+    uint32_t repeat;
+    float near;
+    float far;
+} HeadlessConfig;
+
+static const HeadlessConfig HEADLESS_CONFIG_DEFAULT = {
+    .outDir = "renders",
+    .fallback = false,
+    .scale = 1.0f,
+    .repeat = 1,
+    .near = 0.01f,
+    .far = 1000.0f,
+};
+
+typedef enum ReadbackSlotState {
+    READBACK_SLOT_IDLE,
+    READBACK_SLOT_MAPPING,
+    READBACK_SLOT_MAPPED,
+    READBACK_SLOT_FAILED,
+} ReadbackSlotState;
+
+typedef struct ReadbackSlot {
+    WGPUBuffer buffer;
+    ReadbackSlotState state;
+    // Pose of the image in the buffer
+    uint32_t pose;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerRow;
+} ReadbackSlot;
+
+typedef struct Headless {
+    WGPUInstance instance;
+    WGPUAdapter adapter;
+    WGPUDevice device;
+    WGPUQueue queue;
+
+    uint32_t count;
+    uint32_t shDegree;
+    WGPUBuffer uniformBuffer;
+    WGPUBuffer sortUniformBuffer;
+    WGPUBuffer splatsBuffer;
+    WGPUBuffer shBuffer;
+    WGPUBuffer recordBuffer;
+    WGPUBuffer sortedBuffer;
+    WGPUBuffer keysBuffer;
+    WGPUBuffer countersBuffer;
+    WGPUBuffer indirectBuffer;
+
+    WGPUShaderModule computeModule;
+    WGPUShaderModule renderModule;
+    SplatLayouts layouts;
+    WGPUComputePipeline transformPipeline;
+    WGPUComputePipeline cullFinalizePipeline;
+    WGPURenderPipeline renderPipeline;
+    WGPUBindGroup computeBindGroup;
+    WGPUBindGroup cullBindGroup;
+    WGPUBindGroup renderBindGroup;
+    GpuRadixSort radixSort;
+
+    // Depend on the image size
+    uint32_t width;
+    uint32_t height;
+    WGPUTexture color;
+    WGPUTextureView colorView;
+
+    ReadbackSlot slots[READBACK_SLOTS];
+} Headless;
+
+static void onDeviceError(WGPUErrorType type, const char *message, void *userdata) {
+    (void) userdata;
+    fprintf(stderr, "WGPU [%d]: %s\n", (int) type, message);
+    exit(1);
+}
+
+static double nowSec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static WGPUBuffer createBuffer(WGPUDevice device, const char *label, WGPUBufferUsageFlags usage, uint64_t size) {
+    return wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = label,
+        .usage = usage,
+        .size = size,
+    });
+}
+
+static WGPUShaderModule createShaderModule(WGPUDevice device, const char *path, const char *label) {
+    char *shader = (char *) readShader((const char *[]) {"assets/precision-f32.wgsl", "assets/projection.wgsl"}, 2,
+                                       path);
+    if (!shader) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        exit(1);
+    }
+    WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = label,
+    });
+    free(shader);
+    return module;
+}
+
+// No surface to be compatible with, so any adapter does. Without a GPU (or when asked
+// for it) the fallback adapter renders on the CPU.
+static bool headlessInitDevice(Headless *headless, bool fallback) {
+    headless->instance = wgpuCreateInstance(NULL);
+    if (!headless->instance) {
+        fprintf(stderr, "Failed to create WebGPU instance\n");
+        return false;
+    }
+    WGPURequestAdapterOptions options = {
+        .backendType = WGPUBackendType_Undefined,
+        .powerPreference = WGPUPowerPreference_HighPerformance,
+        .compatibleSurface = NULL,
+        .forceFallbackAdapter = fallback,
+    };
+    headless->adapter = requestAdapterSync(headless->instance, &options);
+    if (!headless->adapter && !fallback) {
+        options.forceFallbackAdapter = true;
+        headless->adapter = requestAdapterSync(headless->instance, &options);
+    }
+    if (!headless->adapter) {
+        fprintf(stderr, "Failed to create WebGPU adapter\n");
+        return false;
+    }
+    WGPUAdapterProperties properties = {0};
+    wgpuAdapterGetProperties(headless->adapter, &properties);
+    printf("Adapter: %s (%s)\n", properties.name ? properties.name : "unknown",
+           properties.adapterType == WGPUAdapterType_CPU ? "CPU" : "GPU");
+
+    // Same limits as the viewer: storage buffers may hold tens of millions of u32s
+    WGPUSupportedLimits supported = {0};
+    wgpuAdapterGetLimits(headless->adapter, &supported);
+    WGPURequiredLimits required = {0};
+    memset(&required.limits, 0xff, sizeof(required.limits));
+    required.limits.maxStorageBufferBindingSize = supported.limits.maxStorageBufferBindingSize;
+    required.limits.maxBufferSize = supported.limits.maxBufferSize;
+    headless->device = requestDeviceSync(headless->adapter, &(WGPUDeviceDescriptor) {
+        .requiredLimits = &required,
+    });
+    if (!headless->device) {
+        fprintf(stderr, "Failed to create WebGPU device\n");
+        return false;
+    }
+    wgpuDeviceSetUncapturedErrorCallback(headless->device, onDeviceError, NULL);
+    headless->queue = wgpuDeviceGetQueue(headless->device);
+    return true;
+}
+
+static void headlessInitScene(Headless *headless, const SplatScene *scene) {
+    WGPUDevice device = headless->device;
+    uint32_t count = scene->count;
+    headless->count = count;
+
+    headless->uniformBuffer = createBuffer(device, "Uniform Buffer", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                                           sizeof(Uniform));
+    // Only the global bitonic steps read it, the transform takes slot 0
+    headless->sortUniformBuffer = createBuffer(device, "Sort Schedule",
+                                               WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform, SORT_UNIFORM_STRIDE);
+    headless->splatsBuffer = createBuffer(device, "Splats Buffer", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                                          count * sizeof(Splat));
+    wgpuQueueWriteBuffer(headless->queue, headless->splatsBuffer, 0, scene->splats, count * sizeof(Splat));
+
+    // Offline there is no bandwidth budget, the full degree is evaluated
+    headless->shDegree = scene->sh ? scene->shDegree : 0;
+    uint64_t shSize = (uint64_t) count * splatShStride(headless->shDegree) * sizeof(uint32_t);
+    headless->shBuffer = createBuffer(device, "Spherical Harmonics", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                                      shSize ? shSize : sizeof(uint32_t));
+    if (shSize) {
+        uint32_t *packed = malloc(shSize);
+        splatScenePackSh(scene, headless->shDegree, packed);
+        wgpuQueueWriteBuffer(headless->queue, headless->shBuffer, 0, packed, shSize);
+        free(packed);
+    }
+
+    headless->recordBuffer = createBuffer(device, "Render Records", WGPUBufferUsage_Storage,
+                                          count * sizeof(RenderRecord));
+    headless->sortedBuffer = createBuffer(device, "Sorted Indices", WGPUBufferUsage_Storage, count * sizeof(uint32_t));
+    headless->keysBuffer = createBuffer(device, "Sort Keys", WGPUBufferUsage_Storage, count * sizeof(uint32_t));
+    headless->countersBuffer = createBuffer(device, "Sort Counters", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                                            SORT_COUNTER_COUNT * sizeof(uint32_t));
+    // Everything is drawn in one batch, slot 0 of its DrawBatch slots always starts at 0
+    headless->indirectBuffer = createBuffer(device, "Indirect Arguments",
+                                            WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_Uniform,
+                                            INDIRECT_COUNT * sizeof(uint32_t));
+    gpuRadixSortInit(&headless->radixSort, device, headless->queue, headless->keysBuffer, headless->sortedBuffer,
+                     count, headless->countersBuffer, headless->indirectBuffer,
+                     INDIRECT_RADIX_BLOCKS * sizeof(uint32_t));
+
+    headless->computeModule = createShaderModule(device, "assets/compute.wgsl", "Compute Shader");
+    headless->renderModule = createShaderModule(device, "assets/render.wgsl", "Render Shader");
+
+    // Same layouts and pipelines as the viewer (main.c)
+    splatLayoutsInit(&headless->layouts, device);
+    headless->transformPipeline = splatComputePipeline(device, headless->layouts.computeLayout,
+                                                       headless->computeModule, "transform_main");
+    headless->cullFinalizePipeline = splatComputePipeline(device, headless->layouts.cullLayout,
+                                                          headless->computeModule, "cull_finalize_main");
+    headless->renderPipeline = splatRenderPipeline(device, &headless->layouts, headless->renderModule, "vs_main",
+                                                   HEADLESS_COLOR_FORMAT, false, NULL);
+
+    SplatBuffers buffers = {
+        .uniform = headless->uniformBuffer,
+        .sortUniform = headless->sortUniformBuffer,
+        .splats = headless->splatsBuffer,
+        .records = headless->recordBuffer,
+        .sorted = headless->sortedBuffer,
+        .keys = headless->keysBuffer,
+        .counters = headless->countersBuffer,
+        .sh = headless->shBuffer,
+    };
+    headless->computeBindGroup = splatComputeBindGroup(device, &headless->layouts, &buffers);
+    headless->cullBindGroup = splatCullBindGroup(device, &headless->layouts, headless->indirectBuffer);
+    headless->renderBindGroup = splatRenderBindGroup(device, &headless->layouts, headless->recordBuffer,
+                                                     headless->sortedBuffer, headless->indirectBuffer,
+                                                     "Render Bind Group");
+}
+
+static void headlessResize(Headless *headless, uint32_t width, uint32_t height) {
+    if (headless->color && headless->width == width && headless->height == height)
+        return;
+    if (headless->colorView) wgpuTextureViewRelease(headless->colorView);
+    if (headless->color) wgpuTextureRelease(headless->color);
+    headless->width = width;
+    headless->height = height;
+    headless->color = wgpuDeviceCreateTexture(headless->device, &(WGPUTextureDescriptor) {
+        .label = "Headless Color",
+        .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {width, height, 1},
+        .format = HEADLESS_COLOR_FORMAT,
+        .mipLevelCount = 1,
+        .sampleCount = 1,
+    });
+    headless->colorView = wgpuTextureCreateView(headless->color, NULL);
+}
+
+static void onSlotMapped(WGPUBufferMapAsyncStatus status, void *userdata) {
+    ReadbackSlot *slot = userdata;
+    slot->state = status == WGPUBufferMapAsyncStatus_Success ? READBACK_SLOT_MAPPED : READBACK_SLOT_FAILED;
+}
+
+// Transform, cull, sort and draw the pose, then copy the image into slot and start
+// mapping it. Nothing waits on the GPU here.
+static void headlessRender(Headless *headless, const CameraPose *pose, const HeadlessConfig *config,
+                           ReadbackSlot *slot, uint32_t poseIndex) {
+    uint32_t width = (uint32_t) (pose->width * config->scale + 0.5f);
+    uint32_t height = (uint32_t) (pose->height * config->scale + 0.5f);
+    width = width ? width : 1;
+    height = height ? height : 1;
+    headlessResize(headless, width, height);
+
+    // Scaling the image scales the intrinsics with it
+    CameraPose scaled = *pose;
+    scaled.width = width;
+    scaled.height = height;
+    scaled.fx *= (float) width / pose->width;
+    scaled.cx *= (float) width / pose->width;
+    scaled.fy *= (float) height / pose->height;
+    scaled.cy *= (float) height / pose->height;
+    mat4 proj;
+    Uniform uniform = {
+        .scale = 1.0f,
+        .cull = 1,
+        .viewport = {(float) width, (float) height},
+        .shDegree = headless->shDegree,
+        .shStride = splatShStride(headless->shDegree),
+    };
+    cameraPoseMatrices(&scaled, config->near, config->far, uniform.view, proj, uniform.cameraPos);
+    glm_mat4_mul(proj, uniform.view, uniform.viewProj);
+    uniform.focal[0] = proj[0][0] * uniform.viewport[0] * 0.5f;
+    uniform.focal[1] = proj[1][1] * uniform.viewport[1] * 0.5f;
+    wgpuQueueWriteBuffer(headless->queue, headless->uniformBuffer, 0, &uniform, sizeof(uniform));
+
+    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(headless->device, &(WGPUCommandEncoderDescriptor) {
+        .label = "Headless Encoder",
+    });
+    wgpuCommandEncoderClearBuffer(encoder, headless->countersBuffer, 0, SORT_COUNTER_COUNT * sizeof(uint32_t));
+    WGPUComputePassEncoder sortPass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    wgpuComputePassEncoderSetPipeline(sortPass, headless->transformPipeline);
+    wgpuComputePassEncoderSetBindGroup(sortPass, 0, headless->computeBindGroup, 1, &(uint32_t) {0});
+    wgpuComputePassEncoderDispatchWorkgroups(sortPass, (headless->count + 255) / 256, 1, 1);
+    wgpuComputePassEncoderSetPipeline(sortPass, headless->cullFinalizePipeline);
+    wgpuComputePassEncoderSetBindGroup(sortPass, 1, headless->cullBindGroup, 0, NULL);
+    wgpuComputePassEncoderDispatchWorkgroups(sortPass, 1, 1, 1);
+    gpuRadixSortEncode(&headless->radixSort, sortPass, 32);
+    wgpuComputePassEncoderEnd(sortPass);
+    wgpuComputePassEncoderRelease(sortPass);
+
+    WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor) {
+        .colorAttachmentCount = 1,
+        .colorAttachments = &(WGPURenderPassColorAttachment) {
+            .view = headless->colorView,
+            .loadOp = WGPULoadOp_Clear,
+            .storeOp = WGPUStoreOp_Store,
+            .clearValue = {0.0, 0.0, 0.0, 1.0},
+        },
+    });
+    wgpuRenderPassEncoderSetPipeline(pass, headless->renderPipeline);
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, headless->renderBindGroup, 1, &(uint32_t) {0});
+    wgpuRenderPassEncoderDrawIndirect(pass, headless->indirectBuffer, INDIRECT_DRAW * sizeof(uint32_t));
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+
+    uint32_t bytesPerRow = (width * 4 + COPY_ROW_ALIGNMENT - 1) / COPY_ROW_ALIGNMENT * COPY_ROW_ALIGNMENT;
+    uint64_t size = (uint64_t) bytesPerRow * height;
+    if (!slot->buffer || wgpuBufferGetSize(slot->buffer) < size) {
+        if (slot->buffer) wgpuBufferRelease(slot->buffer);
+        slot->buffer = createBuffer(headless->device, "Image Readback", WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+                                    size);
+    }
+    slot->pose = poseIndex;
+    slot->width = width;
+    slot->height = height;
+    slot->bytesPerRow = bytesPerRow;
+    wgpuCommandEncoderCopyTextureToBuffer(encoder, &(WGPUImageCopyTexture) {
+        .texture = headless->color,
+        .mipLevel = 0,
+        .origin = {0, 0, 0},
+        .aspect = WGPUTextureAspect_All,
+    }, &(WGPUImageCopyBuffer) {
+        .layout = {
+            .offset = 0,
+            .bytesPerRow = bytesPerRow,
+            .rowsPerImage = height,
+        },
+        .buffer = slot->buffer,
+    }, &(WGPUExtent3D) {width, height, 1});
+
+    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+    wgpuQueueSubmit(headless->queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    wgpuCommandEncoderRelease(encoder);
+
+    slot->state = READBACK_SLOT_MAPPING;
+    wgpuBufferMapAsync(slot->buffer, WGPUMapMode_Read, 0, size, onSlotMapped, slot);
+}
+
+// Binary PPM, the name of the image with its directories flattened and .ppm in place
+// of its extension
+static bool writeImage(const char *outDir, const char *name, const uint8_t *rgba, uint32_t width, uint32_t height,
+                       uint32_t bytesPerRow) {
+    char file[256];
+    snprintf(file, sizeof(file), "%s", name);
+    for (char *c = file; *c; c++) {
+        if (*c == '/' || *c == '\\')
+            *c = '_';
+    }
+    char *dot = strrchr(file, '.');
+    if (dot)
+        *dot = '\0';
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.ppm", outDir, file);
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        return false;
+    }
+    fprintf(out, "P6\n%u %u\n255\n", width, height);
+    uint8_t *row = malloc(width * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *src = rgba + (size_t) y * bytesPerRow;
+        for (uint32_t x = 0; x < width; x++)
+            memcpy(row + 3 * x, src + 4 * x, 3);
+        fwrite(row, 3, width, out);
+    }
+    free(row);
+    fclose(out);
+    return true;
+}
+
+// Waits for the image in slot, writes it and frees the slot
+static bool headlessFinish(Headless *headless, ReadbackSlot *slot, const CameraPoses *poses,
+                           const HeadlessConfig *config) {
+    if (slot->state == READBACK_SLOT_IDLE)
+        return true;
+    while (slot->state == READBACK_SLOT_MAPPING)
+        wgpuDevicePoll(headless->device, true, NULL);
+    bool ok = slot->state == READBACK_SLOT_MAPPED;
+    if (ok) {
+        if (config->outDir) {
+            const uint8_t *rgba = wgpuBufferGetConstMappedRange(slot->buffer, 0, (size_t) slot->bytesPerRow * slot->height);
+            ok = writeImage(config->outDir, poses->poses[slot->pose].name, rgba, slot->width, slot->height,
+                            slot->bytesPerRow);
+        }
+        wgpuBufferUnmap(slot->buffer);
+    } else {
+        fprintf(stderr, "Failed to read back %s\n", poses->poses[slot->pose].name);
+    }
+    slot->state = READBACK_SLOT_IDLE;
+    return ok;
+}
+
+static void headlessFree(Headless *headless) {
+    for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+        if (headless->slots[i].buffer) wgpuBufferRelease(headless->slots[i].buffer);
+    }
+    if (headless->colorView) wgpuTextureViewRelease(headless->colorView);
+    if (headless->color) wgpuTextureRelease(headless->color);
+    gpuRadixSortFree(&headless->radixSort);
+    if (headless->renderBindGroup) wgpuBindGroupRelease(headless->renderBindGroup);
+    if (headless->cullBindGroup) wgpuBindGroupRelease(headless->cullBindGroup);
+    if (headless->computeBindGroup) wgpuBindGroupRelease(headless->computeBindGroup);
+    if (headless->renderPipeline) wgpuRenderPipelineRelease(headless->renderPipeline);
+    if (headless->cullFinalizePipeline) wgpuComputePipelineRelease(headless->cullFinalizePipeline);
+    if (headless->transformPipeline) wgpuComputePipelineRelease(headless->transformPipeline);
+    splatLayoutsFree(&headless->layouts);
+    if (headless->renderModule) wgpuShaderModuleRelease(headless->renderModule);
+    if (headless->computeModule) wgpuShaderModuleRelease(headless->computeModule);
+    WGPUBuffer buffers[] = {
+        headless->uniformBuffer, headless->sortUniformBuffer, headless->splatsBuffer, headless->shBuffer,
+        headless->recordBuffer, headless->sortedBuffer, headless->keysBuffer, headless->countersBuffer,
+        headless->indirectBuffer,
+    };
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i]) wgpuBufferRelease(buffers[i]);
+    }
+    if (headless->queue) wgpuQueueRelease(headless->queue);
+    if (headless->device) wgpuDeviceRelease(headless->device);
+    if (headless->adapter) wgpuAdapterRelease(headless->adapter);
+    if (headless->instance) wgpuInstanceRelease(headless->instance);
+    memset(headless, 0, sizeof(*headless));
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s <scene.splat|scene.ply> <images.txt|cameras.json> [options]\n"
+            "  --out <dir>     Where the images are written (default renders)\n"
+            "  --no-write      Read the images back without writing them\n"
+            "  --fallback      Use the fallback (software) adapter\n"
+            "  --scale <s>     Of the camera resolution (default 1)\n"
+            "  --repeat <n>    Render the poses n times\n"
+            "  --near <z>      Near plane (default 0.01)\n"
+            "  --far <z>       Far plane (default 1000)\n",
+            program);
+}
+
+static bool parseArgs(HeadlessConfig *config, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--out") && hasValue)
+            config->outDir = argv[++i];
+        else if (!strcmp(arg, "--no-write"))
+            config->outDir = NULL;
+        else if (!strcmp(arg, "--fallback"))
+            config->fallback = true;
+        else if (!strcmp(arg, "--scale") && hasValue)
+            config->scale = strtof(argv[++i], NULL);
+        else if (!strcmp(arg, "--repeat") && hasValue)
+            config->repeat = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--near") && hasValue)
+            config->near = strtof(argv[++i], NULL);
+        else if (!strcmp(arg, "--far") && hasValue)
+            config->far = strtof(argv[++i], NULL);
+        else if (arg[0] != '-' && !config->scenePath)
+            config->scenePath = arg;
+        else if (arg[0] != '-' && !config->posesPath)
+            config->posesPath = arg;
+        else
+            return false;
+    }
+    return config->scenePath && config->posesPath && config->scale > 0.0f && config->repeat > 0 &&
+           config->near > 0.0f && config->far > config->near;
+}
+
+int main(int argc, char **argv) {
+    HeadlessConfig config = HEADLESS_CONFIG_DEFAULT;
+    if (!parseArgs(&config, argc, argv)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CameraPoses poses = {0};
+    if (!cameraPosesLoad(&poses, config.posesPath) || poses.count == 0) {
+        fprintf(stderr, "No camera poses in %s\n", config.posesPath);
+        cameraPosesFree(&poses);
+        return 1;
+    }
+    SplatScene scene = {0};
+    if (!splatSceneLoad(&scene, config.scenePath)) {
+        cameraPosesFree(&poses);
+        return 1;
+    }
+    printf("Loaded %s (%u points, SH degree %u) and %u poses\n", config.scenePath, scene.count, scene.shDegree,
+           poses.count);
+    if (config.outDir) {
+#ifdef _WIN32
+        _mkdir(config.outDir);
+#else
+        mkdir(config.outDir, 0755);
+#endif
+    }
+
+    Headless headless = {0};
+    if (!headlessInitDevice(&headless, config.fallback)) {
+        splatSceneFree(&scene);
+        cameraPosesFree(&poses);
+        return 1;
+    }
+    headlessInitScene(&headless, &scene);
+    splatSceneFree(&scene);
+
+    // The image in slot i % READBACK_SLOTS is written before the slot renders again,
+    // the GPU meanwhile works on the ones after it
+    uint32_t total = poses.count * config.repeat;
+    uint32_t failed = 0;
+    uint64_t pixels = 0;
+    double start = nowSec();
+    for (uint32_t i = 0; i < total + READBACK_SLOTS; i++) {
+        ReadbackSlot *slot = &headless.slots[i % READBACK_SLOTS];
+        if (!headlessFinish(&headless, slot, &poses, &config))
+            failed++;
+        if (i < total) {
+            uint32_t pose = i % poses.count;
+            headlessRender(&headless, &poses.poses[pose], &config, slot, pose);
+            pixels += (uint64_t) slot->width * slot->height;
+            wgpuDevicePoll(headless.device, false, NULL);
+        }
+    }
+    double seconds = nowSec() - start;
+
+    printf("Rendered %u images (%.1f MP) in %.2f s: %.2f images/s, %.2f ms/image%s\n", total, pixels / 1e6, seconds,
+           seconds > 0.0 ? total / seconds : 0.0, total ? seconds * 1000.0 / total : 0.0,
+           config.outDir ? "" : " (not written)");
+    if (failed)
+        fprintf(stderr, "%u images failed\n", failed);
+
+    headlessFree(&headless);
+    cameraPosesFree(&poses);
+    threadsShutdown();
+    return failed ? 1 : 0;
+}
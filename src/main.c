@@ -5,444 +5,690 @@
 
 #include "app.h"
 #include "camera.h"
+#include "depth.h"
+#include "gpu-primitives.h"
+#include "gpu-sort.h"
+#include "offscreen.h"
+#include "shader-types.h"
+#include "sort.h"
+#include "sort-schedule.h"
+#include "sort-worker.h"
+#include "splat.h"
+#include "splat-pipeline.h"
+#include "threads.h"
+#include "tile-render.h"
 #include "utils.h"
 
-typedef struct SplatRaw {
-    float pos[3];
-    float scale[3];
-    uint32_t color;
-    uint32_t rotation;
-} SplatRaw;
-_Static_assert(sizeof(SplatRaw) == 12 + 12 + 4 + 4, "");
-
-typedef struct Splat {
-    alignas(16) float pos[3];
-    alignas(16) float scale[3];
-    alignas(4) uint32_t color;
-    alignas(4) uint32_t rotation;
-} Splat;
-_Static_assert(sizeof(Splat) == 48, "");
-
-
-typedef struct Uniform {
-    mat4 viewProj;
-    float scale;
-} Uniform;
-
-typedef struct SortUniform {
-    alignas(16) uint32_t comparePattern;
-} SortUniform;
-// NOTE: WGPU requires uniforms to be 16 bytes
-_Static_assert(sizeof(SortUniform) == 16, "");
-_Static_assert(offsetof(SortUniform, comparePattern) == 0, "");
+
+// Where the quads are drawn and how they blend
+typedef enum QuadBlend {
+    // Back to front, over the surface
+    QUAD_BLEND_SURFACE,
+    // Back to front, over the offscreen target (dynamic resolution)
+    QUAD_BLEND_OFFSCREEN,
+    // Front to back, under the offscreen target, skipping saturated pixels
+    QUAD_BLEND_UNDER,
+    QUAD_BLEND_COUNT,
+} QuadBlend;
+
+// Render records above this size are gathered into draw order (GATHER_AUTO). WebGPU
+// cannot query the last level cache, this is about the L2 of current desktop GPUs.
+#define GATHER_CACHE_BYTES (16u << 20)
+
+typedef enum GatherMode {
+    GATHER_AUTO,
+    GATHER_ON,
+    GATHER_OFF,
+} GatherMode;
+
 
 ArcballCamera camera = CAMERA_ARCBALL_DEFAULT;
 
 const char *splatFiles[] = {"nike.splat", "plush.splat", "train.splat"};
+// Scene from the command line (.splat or .ply), shown until one of splatFiles is picked
+const char *scenePath;
 
 uint32_t numSplats;
+// Global bitonic steps in sortScheduleBuffer
+uint32_t sortScheduleCount;
+// Slot of sortScheduleBuffer that shifts sort_local_main by half a block
+uint32_t sortShiftedSlot;
+
+// Everything a sort writes and the quad draw reads. With pipelined sorting the next
+// sort fills one target while the frame draws the other.
+typedef struct SortTarget {
+    WGPUBuffer sortedIndexBuffer;
+    WGPUBuffer indirectBuffer;
+    WGPUBindGroup computeBindGroup;
+    WGPUBindGroup cullBindGroup;
+    WGPUBindGroup pipelineBindGroup;
+    GpuRadixSort radixSort;
+    GpuBucketSort bucketSort;
+    // sortedIndexBuffer holds every splat in the order of a previous view, the
+    // incremental GPU sort can start from it
+    bool seeded;
+    // Frame of the last sort into this target
+    uint64_t sortFrame;
+    // sortedIndexBuffer is nearest first, the draw has to blend under
+    bool frontToBack;
+} SortTarget;
+
+// The second target only exists once pipelined sorting was enabled
+SortTarget sortTargets[2];
+uint32_t drawTarget;
+bool pipelinedSort;
 
 WGPUQueue queue;
 
-WGPUBindGroup computeBindGroup;
-WGPUBindGroup pipelineBindGroup;
-WGPUPipelineLayout computeLayout;
-WGPUPipelineLayout pipelineLayout;
+SplatLayouts layouts;
 
 WGPUComputePipeline transformPipeline;
+WGPUComputePipeline preprocessPipeline;
 WGPUComputePipeline sortPipeline;
+WGPUComputePipeline sortLocalPipeline;
+WGPUComputePipeline sortMergePipeline;
+WGPUComputePipeline cullFinalizePipeline;
+WGPUComputePipeline rekeyPipeline;
+WGPUComputePipeline incrementalDecidePipeline;
 
 WGPUShaderModule computeShaderModule;
 WGPUShaderModule renderShaderModule;
+// Started with --bench-primitives, which exits after the benchmark
+bool benchmarkOnly;
+// Splats, render records and the fragment math in half precision. Only when the
+// device has shader-f16 and its compiler takes the f16 shaders.
+bool halfSupported;
+bool halfPrecision;
+bool halfRejected;
 WGPUBuffer uniformBuffer;
-WGPUBuffer sortUniformBuffer;
-WGPUBuffer stagingSortUniformBuffer;
+WGPUBuffer sortScheduleBuffer;
 WGPUBuffer splatsBuffer;
-WGPUBuffer transformedPosBuffer;
-WGPUBuffer sortedIndexBuffer;
-WGPURenderPipeline renderPipeline;
+// SH coefficients of every splat at the degree of shDegree, sized for scene.shDegree
+WGPUBuffer shBuffer;
+uint32_t shDegree;
+// One RenderRecord per splat for the current view, shared by both sort targets
+WGPUBuffer renderRecordBuffer;
+// Shared by both sort targets, only used while sorting
+WGPUBuffer sortKeysBuffer;
+WGPUBuffer sortCountersBuffer;
+WGPURenderPipeline renderPipelines[QUAD_BLEND_COUNT];
+// Created the first time front to back or dynamic resolution drawing is used
+OffscreenTarget offscreen;
+
+// Gathered draw order: the render records copied into the order of the draw target,
+// so the vertex shader reads them linearly instead of through sortedIndexBuffer
+WGPUBindGroupLayout gatherBindLayout;
+WGPUPipelineLayout gatherLayout;
+WGPUComputePipeline gatherPipeline;
+WGPURenderPipeline renderGatheredPipelines[QUAD_BLEND_COUNT];
+// Created the first time the gather is used
+WGPUBuffer drawRecordBuffer;
+WGPUBindGroup gatherBindGroup;
+// One per sort target, for its batches
+WGPUBindGroup gatheredPipelineBindGroups[2];
+// drawRecordBuffer holds the current records in the order of sortTargets[gatheredTarget]
+bool gatherValid;
+uint32_t gatheredTarget;
+
+// GPU time of the passes that draw the splats, ImGui is not included (needs timestamp
+// queries, browser only)
+WGPUQuerySet drawTimestamps;
+WGPUBuffer drawTimestampBuffer;
+GpuReadback drawTimer;
+
+SplatScene scene;
+// INDIRECT_STATS of the last incremental sort
+GpuReadback incrementalStats;
+SortWorker sortWorker;
+// What the draw target's sortedIndexBuffer holds of the CPU order: the sort thread's
+// result with this seq (0 = none of them), or the synchronous sort's dirty tracking is
+// relative to it. Both are invalidated by GPU sorts.
+uint64_t uploadedSortSeq;
+bool uploadedSyncSort;
+SortSchedule sortSchedule;
+// Created the first time the tile renderer is selected
+TileRenderer tileRenderer;
+
+// Declares Splat and RenderRecord for every shader that reads them
+static const char *precisionPrelude(void) {
+    return halfPrecision ? "assets/precision-f16.wgsl" : "assets/precision-f32.wgsl";
+}
 
-Splat *splats;
-vec4 *transformedPos;
-uint32_t *sortedIndex;
+static uint64_t recordSize(void) {
+    return halfPrecision ? sizeof(RenderRecordHalf) : sizeof(RenderRecord);
+}
 
-int cmpTransformedPosZ(const void *a, const void *b) {
-    uint32_t idxA = *(const uint32_t *)a;
-    uint32_t idxB = *(const uint32_t *)b;
+static WGPUShaderModule createShaderModule(const AppState *app, const char *path, const char *label) {
+    char *shader = (char *) readShader((const char *[]) {precisionPrelude(), "assets/projection.wgsl"}, 2, path);
+    WGPUShaderModule module = wgpuDeviceCreateShaderModule(app->device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = label,
+    });
+    free(shader);
+    return module;
+}
 
-    float zA = transformedPos[idxA][2];
-    float zB = transformedPos[idxB][2];
+#ifdef __EMSCRIPTEN__
+static void onHalfShaderError(WGPUErrorType type, const char *message, void *userdata) {
+    (void) userdata;
+    if (type == WGPUErrorType_NoError)
+        return;
+    fprintf(stderr, "shader-f16 shaders rejected, using fp32: %s\n", message);
+    halfRejected = true;
+}
+#endif
 
-    if (zA < zB) return 1;
-    if (zA > zB) return -1;
-    return 0;
+static void sortTargetFree(SortTarget *target) {
+    if (target->computeBindGroup) wgpuBindGroupRelease(target->computeBindGroup);
+    if (target->cullBindGroup) wgpuBindGroupRelease(target->cullBindGroup);
+    if (target->pipelineBindGroup) wgpuBindGroupRelease(target->pipelineBindGroup);
+    if (target->sortedIndexBuffer) wgpuBufferRelease(target->sortedIndexBuffer);
+    if (target->indirectBuffer) wgpuBufferRelease(target->indirectBuffer);
+    gpuRadixSortFree(&target->radixSort);
+    gpuBucketSortFree(&target->bucketSort);
+    memset(target, 0, sizeof(*target));
 }
 
-int init(const AppState *app, int argc, const char **argv) {
-    queue = wgpuDeviceGetQueue(app->device);
+// Needs the scene buffers and the bind group layouts of loadSplat
+static void sortTargetInit(SortTarget *target, const AppState *app) {
+    sortTargetFree(target);
+    target->sortedIndexBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Sorted Indices",
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+        .size = numSplats * sizeof(uint32_t),
+    });
+    target->indirectBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Indirect Arguments",
+        .size = INDIRECT_COUNT * sizeof(uint32_t),
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_Uniform | WGPUBufferUsage_CopySrc,
+    });
+    gpuRadixSortInit(&target->radixSort, app->device, queue, sortKeysBuffer, target->sortedIndexBuffer, numSplats,
+                     sortCountersBuffer, target->indirectBuffer, INDIRECT_RADIX_BLOCKS * sizeof(uint32_t));
+    gpuBucketSortInit(&target->bucketSort, app->device, queue, sortKeysBuffer, target->sortedIndexBuffer, numSplats,
+                      sortCountersBuffer, target->indirectBuffer, INDIRECT_SORT_GROUPS * sizeof(uint32_t));
+
+    SplatBuffers buffers = {
+        .uniform = uniformBuffer,
+        .sortUniform = sortScheduleBuffer,
+        .splats = splatsBuffer,
+        .records = renderRecordBuffer,
+        .sorted = target->sortedIndexBuffer,
+        .keys = sortKeysBuffer,
+        .counters = sortCountersBuffer,
+        .sh = shBuffer,
+    };
+    target->computeBindGroup = splatComputeBindGroup(app->device, &layouts, &buffers);
+    target->cullBindGroup = splatCullBindGroup(app->device, &layouts, target->indirectBuffer);
+    target->pipelineBindGroup = splatRenderBindGroup(app->device, &layouts, renderRecordBuffer,
+                                                     target->sortedIndexBuffer, target->indirectBuffer, "Bind Group 1");
+}
 
-    const char *computeShader = readFile("assets/compute.wgsl");
-    computeShaderModule = wgpuDeviceCreateShaderModule(app->device, &(WGPUShaderModuleDescriptor) {
-        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
-            .chain = (WGPUChainedStruct) {
-                .next = NULL,
-                .sType = WGPUSType_ShaderModuleWGSLDescriptor,
-            },
-            .code = computeShader,
-        },
+static void gatherFree(void) {
+    for (uint32_t i = 0; i < 2; i++) {
+        if (gatheredPipelineBindGroups[i]) wgpuBindGroupRelease(gatheredPipelineBindGroups[i]);
+        gatheredPipelineBindGroups[i] = NULL;
+    }
+    if (gatherBindGroup) wgpuBindGroupRelease(gatherBindGroup);
+    if (drawRecordBuffer) wgpuBufferRelease(drawRecordBuffer);
+    gatherBindGroup = NULL;
+    drawRecordBuffer = NULL;
+    gatherValid = false;
+}
+
+static void gatherInit(const AppState *app) {
+    gatherFree();
+    drawRecordBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Draw Order Records",
+        .usage = WGPUBufferUsage_Storage,
+        .size = numSplats * recordSize(),
     });
-    free(computeShader);
-    const char *renderShader = readFile("assets/render.wgsl");
-    renderShaderModule = wgpuDeviceCreateShaderModule(app->device, &(WGPUShaderModuleDescriptor) {
-        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
-            .chain.next = NULL,
-            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
-            .code = renderShader,
+    gatherBindGroup = wgpuDeviceCreateBindGroup(app->device, &(WGPUBindGroupDescriptor) {
+        .layout = gatherBindLayout,
+        .entryCount = 1,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = {
+                .binding = 1,
+                .buffer = drawRecordBuffer,
+                .offset = 0,
+                .size = wgpuBufferGetSize(drawRecordBuffer),
+            }
         },
+        .label = "Gather Bind Group",
     });
-    free(renderShader);
+    // vs_gathered_main does not read the order, only the batches of the target
+    for (uint32_t i = 0; i < 2; i++) {
+        const SortTarget *target = &sortTargets[i];
+        if (!target->indirectBuffer)
+            continue;
+        gatheredPipelineBindGroups[i] = splatRenderBindGroup(app->device, &layouts, drawRecordBuffer,
+                                                             target->sortedIndexBuffer, target->indirectBuffer,
+                                                             "Gathered Bind Group");
+    }
+}
+
+int init(const AppState *app, int argc, const char **argv) {
+    queue = wgpuDeviceGetQueue(app->device);
+#ifndef __EMSCRIPTEN__
+    if (argc > 1 && strcmp(argv[1], "--bench-primitives") == 0) {
+        gpuPrimitivesBenchmark(app->device, queue);
+        // Nothing else is created, deinit only releases the queue
+        benchmarkOnly = true;
+        glfwSetWindowShouldClose(app->window, GLFW_TRUE);
+        return 0;
+    }
+#endif
+    if (argc > 1 && argv[1][0] != '-')
+        scenePath = argv[1];
+
+    // Having shader-f16 does not mean the WGSL compiler takes `enable f16`. wgpu-native
+    // v0.19 only passes it through for SPIR-V, so natively it is never used. Browsers
+    // compile it, the half shaders are still compiled once inside an error scope, whose
+    // result arrives asynchronously (render falls back when they were rejected). The
+    // shader modules themselves are created by loadSplat.
+    if (app->shaderF16) {
+#ifdef __EMSCRIPTEN__
+        halfPrecision = true;
+        wgpuDevicePushErrorScope(app->device, WGPUErrorFilter_Validation);
+        WGPUShaderModule compute = createShaderModule(app, "assets/compute.wgsl", "Compute Shader (f16)");
+        WGPUShaderModule render = createShaderModule(app, "assets/render.wgsl", "Render Shader (f16)");
+        wgpuDevicePopErrorScope(app->device, onHalfShaderError, NULL);
+        wgpuShaderModuleRelease(compute);
+        wgpuShaderModuleRelease(render);
+        halfSupported = true;
+#else
+        printf("shader-f16 is available, but wgpu-native does not compile f16 WGSL: using fp32\n");
+#endif
+    }
+    halfPrecision = halfSupported;
+
+    sortScheduleInit(&sortSchedule, SORT_SCHEDULE_CONFIG_DEFAULT);
 
     uniformBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
         .label = "Uniform Buffer",
         .size = sizeof(Uniform),
         .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
     });
-    sortUniformBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
-        .label = "Sort Uniform Buffer",
-        .size = sizeof(SortUniform),
-        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-    });
-    stagingSortUniformBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
-        .label = "Staging Uniform Buffer",
-        .size = 10000 * sizeof(SortUniform),
-        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc,
+    // Written by transform_main / rekey_main, cleared before every sort
+    sortCountersBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Sort Counters",
+        .size = SORT_COUNTER_COUNT * sizeof(uint32_t),
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
     });
+    gpuReadbackInit(&incrementalStats, app->device, 2, "Incremental Sort Readback");
+
+    // Only browsers hand out timestamps in nanoseconds. wgpu-native v0.19 writes raw
+    // ticks and does not expose their period, natively the frame time is used instead.
+#ifdef __EMSCRIPTEN__
+    if (app->timestampQuery) {
+        drawTimestamps = wgpuDeviceCreateQuerySet(app->device, &(WGPUQuerySetDescriptor) {
+            .label = "Draw Timestamps",
+            .type = WGPUQueryType_Timestamp,
+            .count = 2,
+        });
+        drawTimestampBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+            .label = "Draw Timestamps",
+            .size = 2 * sizeof(uint64_t),
+            .usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
+        });
+        gpuReadbackInit(&drawTimer, app->device, 4, "Draw Timer Readback");
+    }
+#endif
 
     return 0;
 }
 void deinit(const AppState *app) {
-    wgpuBindGroupRelease(computeBindGroup);
-    wgpuBindGroupRelease(pipelineBindGroup);
-    wgpuPipelineLayoutRelease(pipelineLayout);
-    wgpuPipelineLayoutRelease(computeLayout);
+    if (benchmarkOnly) {
+        wgpuQueueRelease(queue);
+        return;
+    }
+    sortTargetFree(&sortTargets[0]);
+    sortTargetFree(&sortTargets[1]);
+    gatherFree();
+    wgpuBindGroupLayoutRelease(gatherBindLayout);
+    wgpuPipelineLayoutRelease(gatherLayout);
+    wgpuComputePipelineRelease(gatherPipeline);
+    for (uint32_t i = 0; i < QUAD_BLEND_COUNT; i++) {
+        wgpuRenderPipelineRelease(renderPipelines[i]);
+        wgpuRenderPipelineRelease(renderGatheredPipelines[i]);
+    }
+    offscreenTargetFree(&offscreen);
+    if (drawTimestamps) {
+        wgpuQuerySetRelease(drawTimestamps);
+        wgpuBufferRelease(drawTimestampBuffer);
+        gpuReadbackFree(&drawTimer);
+    }
+    splatLayoutsFree(&layouts);
 
-    free(splats);
-    free(transformedPos);
-    free(sortedIndex);
+    splatSceneFree(&scene);
+    sortWorkerFree(&sortWorker);
+    threadsShutdown();
+    gpuReadbackFree(&incrementalStats);
+    tileRendererFree(&tileRenderer);
 
-    wgpuBufferRelease(stagingSortUniformBuffer);
-    wgpuBufferRelease(sortUniformBuffer);
+    wgpuBufferRelease(sortScheduleBuffer);
     wgpuBufferRelease(uniformBuffer);
-    wgpuBufferRelease(sortedIndexBuffer);
-    wgpuBufferRelease(transformedPosBuffer);
+    wgpuBufferRelease(sortKeysBuffer);
+    wgpuBufferRelease(renderRecordBuffer);
+    wgpuBufferRelease(sortCountersBuffer);
     wgpuBufferRelease(splatsBuffer);
+    wgpuBufferRelease(shBuffer);
 
     wgpuShaderModuleRelease(computeShaderModule);
     wgpuShaderModuleRelease(renderShaderModule);
 
     wgpuComputePipelineRelease(transformPipeline);
+    wgpuComputePipelineRelease(preprocessPipeline);
     wgpuComputePipelineRelease(sortPipeline);
-    wgpuRenderPipelineRelease(renderPipeline);
+    wgpuComputePipelineRelease(sortLocalPipeline);
+    wgpuComputePipelineRelease(sortMergePipeline);
+    wgpuComputePipelineRelease(cullFinalizePipeline);
+    wgpuComputePipelineRelease(rekeyPipeline);
+    wgpuComputePipelineRelease(incrementalDecidePipeline);
     wgpuQueueRelease(queue);
 }
 
+// Pattern of the step-th global bitonic step for block size k (0 once the stride fits
+// in BITONIC_BLOCK): the flip k - 1, then the strides k / 4, k / 8, ...
+static uint32_t bitonicPattern(uint32_t k, uint32_t step) {
+    if (step == 0)
+        return k - 1;
+    uint32_t j = k >> (step + 1);
+    return j >= BITONIC_BLOCK ? j : 0;
+}
+
+// Global steps for block size k go two per dispatch
+static uint32_t bitonicGlobalDispatches(uint32_t k) {
+    uint32_t steps = 1;
+    while (bitonicPattern(k, steps) != 0) {
+        steps++;
+    }
+    return (steps + 1) / 2;
+}
+
+static uint32_t bitonicPadded(uint32_t count) {
+    uint32_t padded = BITONIC_BLOCK;
+    while (padded < count) {
+        padded <<= 1;
+    }
+    return padded;
+}
+
+// Quad pipeline with the given vertex shader (vs_main or vs_gathered_main). The
+// offscreen variants test the target's stencil, which only front to back marks.
+static WGPURenderPipeline createRenderPipeline(const AppState *app, const char *vertexEntryPoint, QuadBlend blend) {
+    bool offscreen = blend != QUAD_BLEND_SURFACE;
+    WGPUStencilFaceState unsaturated = {
+        .compare = WGPUCompareFunction_Equal,
+        .failOp = WGPUStencilOperation_Keep,
+        .depthFailOp = WGPUStencilOperation_Keep,
+        .passOp = WGPUStencilOperation_Keep,
+    };
+    // The stencil reference stays 0
+    WGPUDepthStencilState stencil = {
+        .format = OFFSCREEN_STENCIL_FORMAT,
+        .depthWriteEnabled = false,
+        .depthCompare = WGPUCompareFunction_Always,
+        .stencilFront = unsaturated,
+        .stencilBack = unsaturated,
+        .stencilReadMask = 0xff,
+        .stencilWriteMask = 0,
+    };
+    // The offscreen target has the surface's format
+    return splatRenderPipeline(app->device, &layouts, renderShaderModule, vertexEntryPoint, app->format,
+                               blend == QUAD_BLEND_UNDER, offscreen ? &stencil : NULL);
+}
+
+// The SH degree whose coefficients fit into budget bytes, read by every preprocess
+static uint32_t shDegreeForBudget(double budget) {
+    uint32_t degree = scene.shDegree;
+    while (degree > 0 && (double) numSplats * splatShStride(degree) * sizeof(uint32_t) > budget)
+        degree--;
+    return degree;
+}
+
+// Packs the coefficients at degree into shBuffer (the start of it at lower degrees)
+static void updateSh(uint32_t degree) {
+    if (degree == shDegree)
+        return;
+    shDegree = degree;
+    if (degree == 0)
+        return;
+    size_t size = (size_t) numSplats * splatShStride(degree) * sizeof(uint32_t);
+    uint32_t *packed = malloc(size);
+    splatScenePackSh(&scene, degree, packed);
+    wgpuQueueWriteBuffer(queue, shBuffer, 0, packed, size);
+    free(packed);
+}
+
 void loadSplat(const AppState *app, const char *splatFile) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "assets/%s", splatFile);
-    splatFile = buf;
-    FILE *f = fopen(splatFile, "rb");
-    if (!f) {
-        fprintf(stderr, "Failed to open file %s\n", splatFile);
+    // The sort thread reads the old positions
+    sortWorkerFree(&sortWorker);
+    if (!splatSceneLoad(&scene, splatFile)) {
         exit(1);
     }
-    fseek(f, 0, SEEK_END);
-    size_t fileSize = ftell(f);
-    numSplats = fileSize / sizeof(SplatRaw);
-    assert(fileSize % sizeof(SplatRaw) == 0 && "Invalid file length");
-    if (splats)
-        free(splats);
-    splats = malloc(numSplats * sizeof(*splats));
-    fseek(f, 0, SEEK_SET);
-
-    vec3 center = {0, 0, 0};
-    for (size_t i = 0, idx = 0; i < fileSize; i += sizeof(SplatRaw), idx++) {
-        SplatRaw splatRaw;
-        fread(&splatRaw, sizeof(splatRaw), 1, f);
-        glm_vec3_add(center, splatRaw.pos, center);
-        glm_vec3_copy(splatRaw.pos, splats[idx].pos);
-        glm_vec3_copy(splatRaw.scale, splats[idx].scale);
-        splats[idx].color = splatRaw.color;
-        splats[idx].rotation = splatRaw.rotation;
-    }
-    glm_vec3_div(center, (vec3){numSplats, numSplats, numSplats}, camera.center);
-
-    fclose(f);
-    printf("Loaded %s (%ld points)\n", splatFile, numSplats);
+    numSplats = scene.count;
+    glm_vec3_copy(scene.center, camera.center);
+
+    printf("Loaded %s (%u points, %.1f MB in %.1f ms, %.1f MB/s)\n", splatFile, numSplats,
+           scene.fileSize / (1024.0 * 1024.0), scene.loadTime * 1000.0, splatSceneLoadThroughput(&scene));
 
     if (splatsBuffer) {
         wgpuBufferRelease(splatsBuffer);
     }
-    if (transformedPosBuffer) {
-        wgpuBufferRelease(transformedPosBuffer);
+    if (sortKeysBuffer) {
+        wgpuBufferRelease(sortKeysBuffer);
     }
-    if (sortedIndexBuffer) {
-        wgpuBufferRelease(sortedIndexBuffer);
+    if (renderRecordBuffer) {
+        wgpuBufferRelease(renderRecordBuffer);
     }
 
-    if (transformedPos)
-        free(transformedPos);
-    if (sortedIndex)
-        free(sortedIndex);
-
 
+    size_t splatSize = halfPrecision ? sizeof(SplatHalf) : sizeof(Splat);
     splatsBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
         .label = "Splats Buffer",
         .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex | WGPUBufferUsage_Storage,
-        .size = numSplats * sizeof(Splat),
+        .size = numSplats * splatSize,
         .mappedAtCreation = false
     });
-    wgpuQueueWriteBuffer(queue, splatsBuffer, 0, splats, numSplats * sizeof(Splat));
+    if (halfPrecision) {
+        SplatHalf *half = malloc((numSplats ? numSplats : 1) * sizeof(*half));
+        splatScenePackHalf(&scene, half);
+        wgpuQueueWriteBuffer(queue, splatsBuffer, 0, half, numSplats * splatSize);
+        free(half);
+    } else {
+        wgpuQueueWriteBuffer(queue, splatsBuffer, 0, scene.splats, numSplats * splatSize);
+    }
 
-    transformedPosBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
-        .label = "Transformed Positions",
-        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
-        .size = numSplats * sizeof(vec4),
+    // Filled by updateSh, never bound empty
+    if (shBuffer) {
+        wgpuBufferRelease(shBuffer);
+    }
+    uint64_t shSize = (uint64_t) numSplats * splatShStride(scene.shDegree) * sizeof(uint32_t);
+    shBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Spherical Harmonics",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+        .size = shSize ? shSize : sizeof(uint32_t),
     });
-    transformedPos = malloc(numSplats * sizeof(vec4));
-    sortedIndexBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
-        .label = "Sorted Indices",
-        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
-        .size = numSplats * sizeof(uint32_t),
+    shDegree = 0;
+
+    renderRecordBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Render Records",
+        .usage = WGPUBufferUsage_Storage,
+        .size = numSplats * recordSize(),
     });
-    sortedIndex = malloc(numSplats * sizeof(uint32_t));
 
-    WGPUBindGroupLayout computeBindLayout = wgpuDeviceCreateBindGroupLayout(app->device, &(WGPUBindGroupLayoutDescriptor) {
-        .entryCount = 5,
+    // The layouts above depend on the precision
+    if (computeShaderModule) {
+        wgpuShaderModuleRelease(computeShaderModule);
+    }
+    computeShaderModule = createShaderModule(app, "assets/compute.wgsl", "Compute Shader");
+    if (renderShaderModule) {
+        wgpuShaderModuleRelease(renderShaderModule);
+    }
+    renderShaderModule = createShaderModule(app, "assets/render.wgsl", "Render Shader");
+
+    // Depth key of every entry of sortedIndexBuffer, the sorts only move these two
+    sortKeysBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Sort Keys",
+        .usage = WGPUBufferUsage_Storage,
+        .size = numSplats * sizeof(uint32_t),
+    });
+    sortWorkerInit(&sortWorker, scene.posX, scene.posY, scene.posZ, numSplats);
+    uploadedSortSeq = 0;
+    uploadedSyncSort = false;
+    tileRendererFree(&tileRenderer);
+
+    // The bitonic schedule only depends on numSplats. Every global step gets its own
+    // slot, picked with a dynamic offset while encoding. One more slot after them
+    // offsets the blocks of the incremental repair.
+    if (sortScheduleBuffer) {
+        wgpuBufferRelease(sortScheduleBuffer);
+    }
+    uint32_t padded = bitonicPadded(numSplats);
+    sortScheduleCount = 0;
+    for (uint32_t k = 2 * BITONIC_BLOCK; k <= padded; k <<= 1) {
+        sortScheduleCount += bitonicGlobalDispatches(k);
+    }
+    sortShiftedSlot = sortScheduleCount > 0 ? sortScheduleCount : 1;
+    size_t scheduleSize = (sortShiftedSlot + 1) * SORT_UNIFORM_STRIDE;
+    sortScheduleBuffer = wgpuDeviceCreateBuffer(app->device, &(WGPUBufferDescriptor) {
+        .label = "Sort Schedule",
+        .size = scheduleSize,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+    });
+    uint8_t *schedule = calloc(1, scheduleSize);
+    uint32_t step = 0;
+    for (uint32_t k = 2 * BITONIC_BLOCK; k <= padded; k <<= 1) {
+        for (uint32_t d = 0; d < bitonicGlobalDispatches(k); d++, step++) {
+            SortUniform uniform = {bitonicPattern(k, 2 * d), bitonicPattern(k, 2 * d + 1), 0};
+            memcpy(schedule + step * SORT_UNIFORM_STRIDE, &uniform, sizeof(uniform));
+        }
+    }
+    SortUniform shifted = {.blockOffset = BITONIC_BLOCK / 2};
+    memcpy(schedule + sortShiftedSlot * SORT_UNIFORM_STRIDE, &shifted, sizeof(shifted));
+    wgpuQueueWriteBuffer(queue, sortScheduleBuffer, 0, schedule, scheduleSize);
+    free(schedule);
+
+    splatLayoutsInit(&layouts, app->device);
+    // Group 1 of gather_main, next to the compute bind group of the draw target
+    if (gatherBindLayout) {
+        wgpuBindGroupLayoutRelease(gatherBindLayout);
+    }
+    gatherBindLayout = wgpuDeviceCreateBindGroupLayout(app->device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 1,
         .entries = (WGPUBindGroupLayoutEntry[]) {
             [0] = {
-                .binding = 0,
-                .visibility = WGPUShaderStage_Compute,
-                .buffer.type = WGPUBufferBindingType_Uniform,
-            },
-            [1] = {
                 .binding = 1,
                 .visibility = WGPUShaderStage_Compute,
-                .buffer.type = WGPUBufferBindingType_Uniform,
-            },
-            [2] = {
-                .binding = 2,
-                .visibility = WGPUShaderStage_Compute,
-                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
-            },
-            [3] = {
-                .binding = 3,
-                .visibility = WGPUShaderStage_Compute,
-                .buffer.type = WGPUBufferBindingType_Storage,
-            },
-            [4] = {
-                .binding = 4,
-                .visibility = WGPUShaderStage_Compute,
                 .buffer.type = WGPUBufferBindingType_Storage,
             },
         }
     });
-    WGPUBindGroupLayout pipelineBindLayout = wgpuDeviceCreateBindGroupLayout(app->device, &(WGPUBindGroupLayoutDescriptor) {
-        .entryCount = 4,
-        .entries = (WGPUBindGroupLayoutEntry[]) {
-            [0] = {
-                .binding = 0,
-                .visibility = WGPUShaderStage_Vertex,
-                .buffer.type = WGPUBufferBindingType_Uniform,
-            },
-            [1] = {
-                .binding = 1,
-                .visibility = WGPUShaderStage_Vertex,
-                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
-            },
-            [2] = {
-                .binding = 2,
-                .visibility = WGPUShaderStage_Vertex,
-                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
-            },
-            [3] = {
-                .binding = 3,
-                .visibility = WGPUShaderStage_Vertex,
-                .buffer.type = WGPUBufferBindingType_ReadOnlyStorage,
-            }
-        }
+    if (gatherLayout) {
+        wgpuPipelineLayoutRelease(gatherLayout);
+    }
+    gatherLayout = wgpuDeviceCreatePipelineLayout(app->device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 2,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            layouts.computeBindLayout,
+            gatherBindLayout,
+        },
+        .label = "Gather Pipeline",
     });
-    if (computeBindGroup) {
-        wgpuBindGroupRelease(computeBindGroup);
+
+    // Depend on the layouts and the scene
+    gatherFree();
+    sortTargetInit(&sortTargets[0], app);
+    if (pipelinedSort)
+        sortTargetInit(&sortTargets[1], app);
+    else
+        sortTargetFree(&sortTargets[1]);
+    drawTarget = 0;
+
+    if (transformPipeline) {
+        wgpuComputePipelineRelease(transformPipeline);
     }
-    if (pipelineBindGroup) {
-        wgpuBindGroupRelease(pipelineBindGroup);
+    transformPipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "transform_main");
+
+    if (preprocessPipeline) {
+        wgpuComputePipelineRelease(preprocessPipeline);
     }
-    computeBindGroup = wgpuDeviceCreateBindGroup(app->device, &(WGPUBindGroupDescriptor) {
-        .layout = computeBindLayout,
-        .entryCount = 5,
-        .entries = (WGPUBindGroupEntry[]) {
-            [0] = {
-                .binding = 0,
-                .buffer = uniformBuffer,
-                .offset = 0,
-                .size = sizeof(Uniform),
-            },
-            [1] = {
-                .binding = 1,
-                .buffer = sortUniformBuffer,
-                .offset = 0,
-                .size = sizeof(SortUniform),
-            },
-            [2] = {
-                .binding = 2,
-                .buffer = splatsBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(splatsBuffer),
-            },
-            [3] = {
-                .binding = 3,
-                .buffer = transformedPosBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(transformedPosBuffer),
-            },
-            [4] = {
-                .binding = 4,
-                .buffer = sortedIndexBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(sortedIndexBuffer),
-            }
+    preprocessPipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "preprocess_main");
 
-        },
-        .label = "Bind Group 0",
-    });
-    pipelineBindGroup = wgpuDeviceCreateBindGroup(app->device, &(WGPUBindGroupDescriptor) {
-        .layout = pipelineBindLayout,
-        .entryCount = 4,
-        .entries = (WGPUBindGroupEntry[]) {
-            [0] = {
-                .binding = 0,
-                .buffer = uniformBuffer,
-                .offset = 0,
-                .size = sizeof(Uniform),
-            },
-            [1] = {
-                .binding = 1,
-                .buffer = splatsBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(splatsBuffer),
-            },
-            [2] = {
-                .binding = 2,
-                .buffer = transformedPosBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(transformedPosBuffer),
-            },
-            [3] = {
-                .binding = 3,
-                .buffer = sortedIndexBuffer,
-                .offset = 0,
-                .size = wgpuBufferGetSize(sortedIndexBuffer),
-            }
+    if (sortPipeline) {
+        wgpuComputePipelineRelease(sortPipeline);
+    }
+    sortPipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "sort_main");
 
-        },
-        .label = "Bind Group 1",
-    });
+    if (sortLocalPipeline) {
+        wgpuComputePipelineRelease(sortLocalPipeline);
+    }
+    sortLocalPipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "sort_local_main");
 
-    if (computeLayout) {
-        wgpuPipelineLayoutRelease(computeLayout);
+    if (sortMergePipeline) {
+        wgpuComputePipelineRelease(sortMergePipeline);
     }
-    computeLayout = wgpuDeviceCreatePipelineLayout(app->device, &(WGPUPipelineLayoutDescriptor) {
-        .bindGroupLayoutCount = 1,
-        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
-            computeBindLayout,
-        },
-        .label = "Compute Pipeline",
+    sortMergePipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "sort_merge_main");
 
-    });
+    if (cullFinalizePipeline) {
+        wgpuComputePipelineRelease(cullFinalizePipeline);
+    }
+    cullFinalizePipeline = splatComputePipeline(app->device, layouts.cullLayout, computeShaderModule, "cull_finalize_main");
 
-    if (pipelineLayout) {
-        wgpuPipelineLayoutRelease(pipelineLayout);
+    if (rekeyPipeline) {
+        wgpuComputePipelineRelease(rekeyPipeline);
     }
-    pipelineLayout = wgpuDeviceCreatePipelineLayout(app->device, &(WGPUPipelineLayoutDescriptor) {
-        .bindGroupLayoutCount = 1,
-        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
-            pipelineBindLayout,
-        },
-        .label = "Pipeline Layout",
-    });
-    wgpuBindGroupLayoutRelease(computeBindLayout);
-    wgpuBindGroupLayoutRelease(pipelineBindLayout);
+    rekeyPipeline = splatComputePipeline(app->device, layouts.computeLayout, computeShaderModule, "rekey_main");
 
-    if (transformPipeline) {
-        wgpuComputePipelineRelease(transformPipeline);
+    if (incrementalDecidePipeline) {
+        wgpuComputePipelineRelease(incrementalDecidePipeline);
     }
-    transformPipeline = wgpuDeviceCreateComputePipeline(app->device, &(WGPUComputePipelineDescriptor) {
-        .layout = computeLayout,
-        .compute = {
-            .module = computeShaderModule,
-            .entryPoint = "transform_main",
+    incrementalDecidePipeline = splatComputePipeline(app->device, layouts.cullLayout, computeShaderModule, "incremental_decide_main");
+
+    for (uint32_t i = 0; i < QUAD_BLEND_COUNT; i++) {
+        if (renderPipelines[i]) {
+            wgpuRenderPipelineRelease(renderPipelines[i]);
         }
-    });
+        renderPipelines[i] = createRenderPipeline(app, "vs_main", i);
+    }
 
-    if (sortPipeline) {
-        wgpuComputePipelineRelease(sortPipeline);
+    if (gatherPipeline) {
+        wgpuComputePipelineRelease(gatherPipeline);
     }
-    sortPipeline = wgpuDeviceCreateComputePipeline(app->device, &(WGPUComputePipelineDescriptor) {
-        .layout = computeLayout,
-        .compute = {
-            .module = computeShaderModule,
-            .entryPoint = "sort_main",
-        }
-    });
+    gatherPipeline = splatComputePipeline(app->device, gatherLayout, computeShaderModule, "gather_main");
 
-    if (renderPipeline) {
-        wgpuRenderPipelineRelease(renderPipeline);
-    }
-    renderPipeline = wgpuDeviceCreateRenderPipeline(app->device, &(WGPURenderPipelineDescriptor) {
-        .layout = pipelineLayout,
-        .primitive.topology = WGPUPrimitiveTopology_TriangleStrip,
-        .primitive.stripIndexFormat = WGPUIndexFormat_Undefined,
-        .primitive.frontFace = WGPUFrontFace_CCW,
-        .primitive.cullMode = WGPUCullMode_None,
-        .vertex.module = renderShaderModule,
-        .vertex.bufferCount = 0,
-        .vertex.entryPoint = "vs_main",
-        .fragment = &(WGPUFragmentState) {
-            .module = renderShaderModule,
-            .entryPoint = "fs_main",
-            .targetCount = 1,
-            .targets = (WGPUColorTargetState[]) {
-                [0].format = app->format,
-                [0].writeMask = WGPUColorWriteMask_All,
-                [0].blend = &(WGPUBlendState) {
-                    .color = {
-                        .operation = WGPUBlendOperation_Add,
-                        .srcFactor = WGPUBlendFactor_SrcAlpha,
-                        .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
-                    },
-                    .alpha = {
-                        .operation = WGPUBlendOperation_Add,
-                        .srcFactor = WGPUBlendFactor_One,
-                        .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
-                    },
-                }
-            }
-        },
-        .depthStencil = NULL,
-        .multisample.count = 1,
-        .multisample.mask = ~0u,
-        .multisample.alphaToCoverageEnabled = false,
-    });
+    for (uint32_t i = 0; i < QUAD_BLEND_COUNT; i++) {
+        if (renderGatheredPipelines[i]) {
+            wgpuRenderPipelineRelease(renderGatheredPipelines[i]);
+        }
+        renderGatheredPipelines[i] = createRenderPipeline(app, "vs_gathered_main", i);
+    }
 }
 
 static double timeDiffSec(struct timespec start, struct timespec end) {
     return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
 }
 
+// Submits a recorded sort and starts reading back its stats
+static void submitSort(SortTarget *target, WGPUCommandBuffer command) {
+    wgpuQueueSubmit(queue, 1, &command);
+    wgpuCommandBufferRelease(command);
+    gpuReadbackMap(&target->bucketSort.stats);
+    gpuReadbackMap(&incrementalStats);
+}
+
 void render(const AppState *app, float dt) {
     struct timespec sortStart, sortEnd;
 
     static bool cameraUpdated = true;
+    static uint64_t frame = 0;
+    static double time = 0.0;
+    frame++;
+    time += dt;
 #ifndef __EMSCRIPTEN__
     // Cant exit on html
     if (inputIsKeyPressed(GLFW_KEY_ESCAPE)) {
@@ -471,100 +717,360 @@ void render(const AppState *app, float dt) {
     static bool changeSplat = true;
     static int splatIdx = 0;
 
+    // The browser rejected the half shaders after all, see init
+    if (halfRejected && halfSupported) {
+        halfSupported = false;
+        changeSplat |= halfPrecision;
+        halfPrecision = false;
+    }
     if (changeSplat) {
-        loadSplat(app, splatFiles[splatIdx]);
+        // The command line path is passed as is, it may be longer than the bundled names
+        char path[256];
+        snprintf(path, sizeof(path), "assets/%s", splatFiles[splatIdx]);
+        loadSplat(app, scenePath ? scenePath : path);
         changeSplat = false;
         cameraUpdated = true;
+        sortScheduleInvalidate(&sortSchedule);
     }
     arcballCameraUpdate(&camera);
 
     static bool gpuSort = true;
+    static int gpuSortAlgorithm = GPU_SORT_RADIX;
+    static int gpuRadixKeyBits = 32;
+    static int bucketRefined = GPU_BUCKET_COUNT;
+    // Fraction of the neighbours that may be out of order before the incremental sort
+    // gives up on repairing
+    static float resortFraction = 0.02f;
+    static int gatherMode = GATHER_AUTO;
+    static uint32_t bitonicDispatches = 0;
     static bool alwaysSort = false;
-
-
+    static bool asyncSort = true;
+    static int cpuSortKeyBits = 32;
+    static CpuSortConfig cpuSortConfig = CPU_SORT_CONFIG_DEFAULT;
+    static SortResult sortStats = {.reason = "not sorted yet"};
+    static uint64_t lastSortRequest = 0;
+    static uint32_t uploadedBytes = 0;
+
+
+    static bool frustumCulling = true;
+    static bool frontToBack = false;
+    static int renderMode = RENDER_QUADS;
+    // What the preprocess may read of SH coefficients per camera update
+    static float shBudgetMB = 64.0f;
     static Uniform uniform = {
         .scale = 0.125f,
     };
+    static DynamicResolution dynamicRes = DYNAMIC_RESOLUTION_DEFAULT;
+    // The GPU time of the splat passes is what the scale changes, the frame time may be
+    // held by vsync. Natively (unbounded present mode) and without timestamp queries the
+    // frame time is all there is, see init.
+    double drawGpuMs = -1.0;
+    if (drawTimestamps && drawTimer.hasData) {
+        // Nanoseconds, see init
+        uint64_t begin = drawTimer.data[0] | (uint64_t) drawTimer.data[1] << 32;
+        uint64_t end = drawTimer.data[2] | (uint64_t) drawTimer.data[3] << 32;
+        drawGpuMs = end > begin ? (end - begin) / 1e6 : 0.0;
+    }
+    dynamicResolutionUpdate(&dynamicRes, drawGpuMs >= 0.0 ? (float) drawGpuMs : dt * 1000.0f);
+    // Quads are drawn at the scaled size and upscaled into the surface, the tile
+    // renderer always covers the full surface
+    uint32_t renderWidth = app->config.width, renderHeight = app->config.height;
+    if (renderMode == RENDER_QUADS)
+        dynamicResolutionSize(&dynamicRes, app->config.width, app->config.height, &renderWidth, &renderHeight);
+    // The render records are in render target pixels
+    static uint32_t recordsWidth = 0, recordsHeight = 0;
+    if (renderWidth != recordsWidth || renderHeight != recordsHeight) {
+        recordsWidth = renderWidth;
+        recordsHeight = renderHeight;
+        cameraUpdated = true;
+    }
     glm_mat4_copy(camera.viewProj, uniform.viewProj);
+    glm_mat4_copy(camera.view, uniform.view);
+    uniform.viewport[0] = (float) renderWidth;
+    uniform.viewport[1] = (float) renderHeight;
+    // Pixels per unit of view space x / z and y / z
+    uniform.focal[0] = camera.proj[0][0] * uniform.viewport[0] * 0.5f;
+    uniform.focal[1] = camera.proj[1][1] * uniform.viewport[1] * 0.5f;
 
     WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(app->device, &(WGPUCommandEncoderDescriptor) {
         .nextInChain = NULL,
         .label = "My Command Encoder",
     });
 
-    wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniform, sizeof(uniform));
-
     timespec_get(&sortStart, TIME_UTC);
 
-    if (gpuSort && (alwaysSort || cameraUpdated)) {
-        // Transform pass
-        WGPUComputePassEncoder transformPass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
-        wgpuComputePassEncoderSetPipeline(transformPass, transformPipeline);
-        wgpuComputePassEncoderSetBindGroup(transformPass, 0, computeBindGroup, 0, NULL);
-        wgpuComputePassEncoderDispatchWorkgroups(transformPass, (numSplats + 255) / 256, 1, 1);
-        wgpuComputePassEncoderEnd(transformPass);
-        wgpuComputePassEncoderRelease(transformPass);
-        // Sort pass
-        uint32_t uniformCount = 0;
-        for (uint32_t k = 2; (k >> 1) < numSplats; k <<= 1) {
-            uniformCount++;
-            for (uint32_t j = k >> 1; 0 < j; j >>= 1) {
-                uniformCount++;
-            }
-        }
-        SortUniform sortUniforms[uniformCount];
-        uint32_t uniformIndex = 0;
-        for (uint32_t k = 2; (k >> 1) < numSplats; k <<= 1) {
-            sortUniforms[uniformIndex++] = (SortUniform) {k - 1};
-            for (uint32_t j = k >> 1; 0 < j; j >>= 1) {
-                sortUniforms[uniformIndex++] = (SortUniform) {j};
+    SortDecision sortDecision = sortScheduleUpdate(&sortSchedule, &camera, cameraUpdated, time);
+    // The tile renderer sorts on its own every frame
+    bool sortNow = renderMode == RENDER_QUADS && (alwaysSort || sortDecision != SORT_SKIP);
+    // At rest the order is exact, reduced key precision is only used while moving
+    bool exactSort = sortDecision == SORT_EXACT;
+    // Repair last frame's order instead of sorting from scratch. That order has to
+    // cover every splat, so nothing is culled in this mode.
+    // Pipelined: the sort fills the other target and is submitted after this frame's
+    // draw, which uses the order of the previous sort (one frame of order lag). Only
+    // the order lags, the records are re-projected like for a skipped sort.
+    bool pipelined = pipelinedSort && gpuSort && renderMode == RENDER_QUADS;
+    if (pipelined && !sortTargets[1].sortedIndexBuffer) {
+        sortTargetInit(&sortTargets[1], app);
+        // Recreated with the bind group of the new target
+        gatherFree();
+    }
+    SortTarget *draw = &sortTargets[drawTarget];
+    SortTarget *target = pipelined ? &sortTargets[drawTarget ^ 1] : draw;
+    bool incremental = gpuSortAlgorithm == GPU_SORT_INCREMENTAL;
+    bool repair = incremental && target->seeded;
+
+    uniform.cull = gpuSort && frustumCulling && !incremental;
+    // Only the GPU sorts order nearest first
+    uniform.frontToBack = gpuSort && frontToBack;
+    uint32_t degree = shDegreeForBudget(shBudgetMB * 1024.0 * 1024.0);
+    if (degree != shDegree) {
+        updateSh(degree);
+        cameraUpdated = true;
+    }
+    uniform.shDegree = shDegree;
+    uniform.shStride = splatShStride(shDegree);
+    glm_vec3_copy(camera.pos, uniform.cameraPos);
+    // Any inversion at rest escalates, so the order settles on the exact one
+    uniform.resortThreshold = exactSort ? 0 : (uint32_t) (resortFraction * numSplats);
+    wgpuQueueWriteBuffer(queue, uniformBuffer, 0, &uniform, sizeof(uniform));
+
+    WGPUCommandBuffer sortCommand = NULL;
+    if (gpuSort && sortNow) {
+        // Transform, cull and sort in a single pass. Everything after the transform only
+        // covers the visible splats, their count never leaves the GPU.
+        wgpuCommandEncoderClearBuffer(encoder, sortCountersBuffer, 0, SORT_COUNTER_COUNT * sizeof(uint32_t));
+        if (gpuSortAlgorithm == GPU_SORT_BUCKET)
+            // Front to back the nearest buckets come first, all of them are refined
+            gpuBucketSortClear(&target->bucketSort, queue, encoder,
+                               exactSort || uniform.frontToBack ? GPU_BUCKET_COUNT : bucketRefined);
+        WGPUComputePassEncoder sortPass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+        wgpuComputePassEncoderSetPipeline(sortPass, repair ? rekeyPipeline : transformPipeline);
+        wgpuComputePassEncoderSetBindGroup(sortPass, 0, target->computeBindGroup, 1, &(uint32_t) {0});
+        wgpuComputePassEncoderDispatchWorkgroups(sortPass, (numSplats + 255) / 256, 1, 1);
+        wgpuComputePassEncoderSetPipeline(sortPass, cullFinalizePipeline);
+        wgpuComputePassEncoderSetBindGroup(sortPass, 1, target->cullBindGroup, 0, NULL);
+        wgpuComputePassEncoderDispatchWorkgroups(sortPass, 1, 1, 1);
+        if (repair) {
+            // Whether the radix sort or the repair runs is decided on the GPU, the one
+            // that does not gets zero sized dispatches
+            wgpuComputePassEncoderSetPipeline(sortPass, incrementalDecidePipeline);
+            wgpuComputePassEncoderDispatchWorkgroups(sortPass, 1, 1, 1);
+            gpuRadixSortEncode(&target->radixSort, sortPass, 32);
+            // Splats only drift a little between sorts: sorting every block, then every
+            // block shifted by half a block, moves them across block borders
+            wgpuComputePassEncoderSetPipeline(sortPass, sortLocalPipeline);
+            wgpuComputePassEncoderSetBindGroup(sortPass, 0, target->computeBindGroup, 1, &(uint32_t) {0});
+            wgpuComputePassEncoderDispatchWorkgroupsIndirect(sortPass, target->indirectBuffer, INDIRECT_REPAIR_BLOCKS * sizeof(uint32_t));
+            uint32_t shiftedOffset = sortShiftedSlot * SORT_UNIFORM_STRIDE;
+            wgpuComputePassEncoderSetBindGroup(sortPass, 0, target->computeBindGroup, 1, &shiftedOffset);
+            wgpuComputePassEncoderDispatchWorkgroupsIndirect(sortPass, target->indirectBuffer, INDIRECT_REPAIR_SHIFTED_BLOCKS * sizeof(uint32_t));
+        } else if (gpuSortAlgorithm == GPU_SORT_RADIX || incremental) {
+            gpuRadixSortEncode(&target->radixSort, sortPass, exactSort || incremental ? 32 : gpuRadixKeyBits);
+        } else if (gpuSortAlgorithm == GPU_SORT_BUCKET) {
+            // Records its own passes, the scan of the bucket sizes goes between them
+            wgpuComputePassEncoderEnd(sortPass);
+            wgpuComputePassEncoderRelease(sortPass);
+            sortPass = NULL;
+            gpuBucketSortEncode(&target->bucketSort, encoder);
+        } else {
+            // Blocks are sorted in workgroup memory. For every larger k only the steps
+            // with strides of a block or more run globally (two per dispatch), the rest
+            // of the merge is local again.
+            // The schedule covers numSplats, steps past the visible count do nothing.
+            uint32_t padded = bitonicPadded(numSplats);
+            wgpuComputePassEncoderSetPipeline(sortPass, sortLocalPipeline);
+            wgpuComputePassEncoderDispatchWorkgroupsIndirect(sortPass, target->indirectBuffer, INDIRECT_SORT_BLOCKS * sizeof(uint32_t));
+            bitonicDispatches = 1;
+
+            uint32_t step = 0;
+            for (uint32_t k = 2 * BITONIC_BLOCK; k <= padded; k <<= 1) {
+                wgpuComputePassEncoderSetPipeline(sortPass, sortPipeline);
+                for (uint32_t d = 0; d < bitonicGlobalDispatches(k); d++, step++) {
+                    uint32_t offset = step * SORT_UNIFORM_STRIDE;
+                    wgpuComputePassEncoderSetBindGroup(sortPass, 0, target->computeBindGroup, 1, &offset);
+                    wgpuComputePassEncoderDispatchWorkgroupsIndirect(sortPass, target->indirectBuffer, INDIRECT_SORT_GROUPS * sizeof(uint32_t));
+                    bitonicDispatches++;
+                }
+                wgpuComputePassEncoderSetPipeline(sortPass, sortMergePipeline);
+                wgpuComputePassEncoderDispatchWorkgroupsIndirect(sortPass, target->indirectBuffer, INDIRECT_SORT_BLOCKS * sizeof(uint32_t));
+                bitonicDispatches++;
             }
+            assert(step == sortScheduleCount);
         }
-        assert(uniformIndex == uniformCount);
-        assert(uniformCount * sizeof(SortUniform) <= wgpuBufferGetSize(stagingSortUniformBuffer));
-        wgpuQueueWriteBuffer(queue, stagingSortUniformBuffer, 0, sortUniforms, uniformCount * sizeof(SortUniform));
-
-        for (uint32_t i = 0; i < uniformCount; i++) {
-            uint32_t offset = i * sizeof(SortUniform);
-            wgpuCommandEncoderCopyBufferToBuffer(encoder, stagingSortUniformBuffer, offset, sortUniformBuffer, 0, sizeof(SortUniform));
-            WGPUComputePassEncoder computePass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
-            wgpuComputePassEncoderSetPipeline(computePass, sortPipeline);
-            wgpuComputePassEncoderSetBindGroup(computePass, 0, computeBindGroup, 0, NULL);
-            uint32_t workgroups = (numSplats + 255) / 256;
-            wgpuComputePassEncoderDispatchWorkgroups(computePass, workgroups, 1, 1);
-            wgpuComputePassEncoderEnd(computePass);
-            wgpuComputePassEncoderRelease(computePass);
+        if (sortPass) {
+            wgpuComputePassEncoderEnd(sortPass);
+            wgpuComputePassEncoderRelease(sortPass);
         }
+        if (gpuSortAlgorithm == GPU_SORT_BUCKET)
+            gpuReadbackCopy(&target->bucketSort.stats, encoder, target->bucketSort.statsBuffer, 0);
+        if (repair)
+            gpuReadbackCopy(&incrementalStats, encoder, target->indirectBuffer, INDIRECT_STATS * sizeof(uint32_t));
 
-
-        // Encode and submit
-        WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor) {
+        sortCommand = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor) {
             .nextInChain = NULL,
-            .label = "My Command Buffer",
+            .label = "Sort Command Buffer",
         });
-
-        wgpuQueueSubmit(queue, 1, &command);
-        wgpuCommandBufferRelease(command);
         wgpuCommandEncoderRelease(encoder);
         encoder = wgpuDeviceCreateCommandEncoder(app->device, &(WGPUCommandEncoderDescriptor) {});
+        if (!pipelined) {
+            submitSort(target, sortCommand);
+            sortCommand = NULL;
+        }
+        // sortedIndexBuffer no longer holds the CPU order. The CPU sort itself may still
+        // be running on the sort thread, the next CPU upload sends everything instead.
+        uploadedSortSeq = 0;
+        uploadedSyncSort = false;
+        target->seeded = !uniform.cull;
+        target->sortFrame = frame;
+        target->frontToBack = uniform.frontToBack;
+        gatherValid = false;
     }
-    if (!gpuSort && (alwaysSort || cameraUpdated)) {
-        for (int32_t i = 0; i < numSplats; i++) {
-            Splat *splat = splats + i;
-            vec4 pos = {splat->pos[0], splat->pos[1], splat->pos[2], 1.0f};
-            glm_mat4_mulv(camera.viewProj, pos, transformedPos[i]);
+    // The CPU order replaces it (asynchronously, once the result is acquired)
+    if (!gpuSort && sortNow)
+        draw->seeded = false;
+    // The scheduler only gates the sorts, never the projection: whenever the view
+    // changed the render records are re-projected, so a skipped sort only leaves the
+    // order stale. transform_main already wrote them if a GPU sort into the draw target
+    // ran this frame (a pipelined sort is submitted after the draw, too late for it).
+    // The records are shared by both targets, so at rest a pipelined sort needs none.
+    bool projected = gpuSort && sortNow && target == draw;
+    bool reproject = renderMode == RENDER_QUADS && !projected && (cameraUpdated || (!gpuSort && sortNow));
+    if (reproject) {
+        WGPUComputePassEncoder preprocessPass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+        wgpuComputePassEncoderSetPipeline(preprocessPass, preprocessPipeline);
+        wgpuComputePassEncoderSetBindGroup(preprocessPass, 0, draw->computeBindGroup, 1, &(uint32_t) {0});
+        wgpuComputePassEncoderDispatchWorkgroups(preprocessPass, (numSplats + 255) / 256, 1, 1);
+        wgpuComputePassEncoderEnd(preprocessPass);
+        wgpuComputePassEncoderRelease(preprocessPass);
+        gatherValid = false;
+    }
+    if (!gpuSort && sortNow) {
+
+        CpuSortConfig config = cpuSortConfig;
+        config.keyBits = exactSort ? 32 : cpuSortKeyBits;
+        lastSortRequest = frame;
+        if (asyncSort) {
+            // Drawn with the last finished order until the sort thread catches up
+            sortWorkerRequest(&sortWorker, camera.viewProj, frame, config);
+        } else {
+            sortWorkerWaitIdle(&sortWorker);
+            CpuSort *cpuSort = &sortWorker.sort;
+            if (!uploadedSyncSort)
+                cpuSortMarkAllDirty(cpuSort);
+            cpuSort->config = config;
+            cpuSortRun(cpuSort, scene.posX, scene.posY, scene.posZ, camera.viewProj);
+            sortStats = (SortResult) {
+                .frame = frame,
+                .kind = cpuSort->kind,
+                .reason = cpuSort->reason,
+                .moves = cpuSort->moves,
+            };
+
+            // Upload only the parts of the order that changed
+            const uint32_t *order = cpuSortOrder(cpuSort);
+            uint32_t cursor = 0, begin, end;
+            uploadedBytes = 0;
+            while (cpuSortNextDirtyRange(cpuSort, &cursor, &begin, &end)) {
+                wgpuQueueWriteBuffer(queue, draw->sortedIndexBuffer, begin * sizeof(*order), order + begin, (end - begin) * sizeof(*order));
+                uploadedBytes += (end - begin) * sizeof(*order);
+            }
+            uploadedSyncSort = true;
+            uploadedSortSeq = 0;
+            draw->sortFrame = frame;
+            draw->frontToBack = false;
+            gatherValid = false;
         }
-        for (int i = 0; i < numSplats; i++) {
-            sortedIndex[i] = i;
+    }
+    if (renderMode == RENDER_TILES) {
+        if (!tileRenderer.module)
+            tileRendererInit(&tileRenderer, app->device, queue, splatsBuffer, numSplats, app->format, precisionPrelude());
+        tileRendererEncode(&tileRenderer, app->device, queue, encoder, camera.view, camera.proj, app->config.width,
+                           app->config.height);
+    }
+    if (!gpuSort && asyncSort) {
+        const SortResult *result = sortWorkerAcquire(&sortWorker);
+        if (result) {
+            const uint32_t *order = result->order;
+            if (uploadedSortSeq != 0 && result->seq == uploadedSortSeq + 1) {
+                // Only the blocks that changed since the uploaded result
+                uint32_t cursor = 0, begin, end;
+                uploadedBytes = 0;
+                while (sortWorkerNextDirtyRange(&sortWorker, result, &cursor, &begin, &end)) {
+                    wgpuQueueWriteBuffer(queue, draw->sortedIndexBuffer, begin * sizeof(*order), order + begin,
+                                         (end - begin) * sizeof(*order));
+                    uploadedBytes += (end - begin) * sizeof(*order);
+                }
+            } else {
+                wgpuQueueWriteBuffer(queue, draw->sortedIndexBuffer, 0, order, numSplats * sizeof(*order));
+                uploadedBytes = numSplats * sizeof(*order);
+            }
+            uploadedSortSeq = result->seq;
+            uploadedSyncSort = false;
+            sortStats = *result;
+            draw->sortFrame = result->frame;
+            draw->frontToBack = false;
+            gatherValid = false;
         }
-        qsort(sortedIndex, numSplats, sizeof(*sortedIndex), cmpTransformedPosZ);
-
-        wgpuQueueWriteBuffer(queue, transformedPosBuffer, 0, transformedPos, numSplats * sizeof(*transformedPos));
-        wgpuQueueWriteBuffer(queue, sortedIndexBuffer, 0, sortedIndex, numSplats * sizeof(*sortedIndex));
+    }
+    // Copy the records into draw order once per sort or view change, the draw then
+    // reads them linearly. Only worth it once they no longer fit in the GPU caches.
+    bool gather = renderMode == RENDER_QUADS &&
+                  (gatherMode == GATHER_ON || (gatherMode == GATHER_AUTO && numSplats * recordSize() > GATHER_CACHE_BYTES));
+    if (gather && !(gatherValid && gatheredTarget == drawTarget)) {
+        if (!drawRecordBuffer)
+            gatherInit(app);
+        WGPUComputePassEncoder gatherPass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+        wgpuComputePassEncoderSetPipeline(gatherPass, gatherPipeline);
+        wgpuComputePassEncoderSetBindGroup(gatherPass, 0, draw->computeBindGroup, 1, &(uint32_t) {0});
+        wgpuComputePassEncoderSetBindGroup(gatherPass, 1, gatherBindGroup, 0, NULL);
+        // A GPU sort only ordered the visible splats
+        if (gpuSort)
+            wgpuComputePassEncoderDispatchWorkgroupsIndirect(gatherPass, draw->indirectBuffer, INDIRECT_SORT_GROUPS * sizeof(uint32_t));
+        else
+            wgpuComputePassEncoderDispatchWorkgroups(gatherPass, (numSplats + 255) / 256, 1, 1);
+        wgpuComputePassEncoderEnd(gatherPass);
+        wgpuComputePassEncoderRelease(gatherPass);
+        gatherValid = true;
+        gatheredTarget = drawTarget;
     }
     cameraUpdated = false;
 
     timespec_get(&sortEnd, TIME_UTC);
+    // Front to back: the batches blend under into the offscreen target, before every
+    // batch after the first the saturated pixels are masked, so the splats behind them
+    // are rejected by the stencil test before shading. With dynamic resolution the
+    // quads go there as well. The render pass composites it onto the surface.
+    bool frontToBackDraw = renderMode == RENDER_QUADS && gpuSort && draw->frontToBack;
+    bool offscreenDraw = renderMode == RENDER_QUADS && (frontToBackDraw || dynamicRes.enabled);
+    if (offscreenDraw) {
+        if (!offscreen.module)
+            offscreenTargetInit(&offscreen, app->device, app->format);
+        offscreenTargetResize(&offscreen, app->device, renderWidth, renderHeight);
+        QuadBlend blend = frontToBackDraw ? QUAD_BLEND_UNDER : QUAD_BLEND_OFFSCREEN;
+        uint32_t batches = frontToBackDraw ? DRAW_BATCHES : 1;
+        for (uint32_t b = 0; b < batches; b++) {
+            if (b > 0)
+                offscreenTargetMarkSaturated(&offscreen, encoder);
+            WGPURenderPassEncoder batchPass = offscreenTargetBeginPass(&offscreen, encoder, b == 0,
+                drawTimestamps && (b == 0 || b == batches - 1) ? &(WGPURenderPassTimestampWrites) {
+                    .querySet = drawTimestamps,
+                    .beginningOfPassWriteIndex = b == 0 ? 0 : WGPU_QUERY_SET_INDEX_UNDEFINED,
+                    .endOfPassWriteIndex = b == batches - 1 ? 1 : WGPU_QUERY_SET_INDEX_UNDEFINED,
+                } : NULL);
+            wgpuRenderPassEncoderSetPipeline(batchPass, gather ? renderGatheredPipelines[blend] : renderPipelines[blend]);
+            wgpuRenderPassEncoderSetBindGroup(batchPass, 0, gather ? gatheredPipelineBindGroups[drawTarget] : draw->pipelineBindGroup,
+                                              1, &(uint32_t) {b * DRAW_BATCH_STRIDE});
+            if (frontToBackDraw)
+                wgpuRenderPassEncoderDrawIndirect(batchPass, draw->indirectBuffer, (INDIRECT_BATCHES + 4 * b) * sizeof(uint32_t));
+            else if (gpuSort)
+                wgpuRenderPassEncoderDrawIndirect(batchPass, draw->indirectBuffer, INDIRECT_DRAW * sizeof(uint32_t));
+            else
+                wgpuRenderPassEncoderDraw(batchPass, 4, numSplats, 0, 0);
+            wgpuRenderPassEncoderEnd(batchPass);
+            wgpuRenderPassEncoderRelease(batchPass);
+        }
+    }
     // Render pass
     {
         WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor) {
@@ -585,21 +1091,39 @@ void render(const AppState *app, float dt) {
 #endif
             },
             .depthStencilAttachment = NULL,
-            .timestampWrites = NULL,
+            // The offscreen passes are timed themselves
+            .timestampWrites = drawTimestamps && !offscreenDraw ? &(WGPURenderPassTimestampWrites) {
+                .querySet = drawTimestamps,
+                .beginningOfPassWriteIndex = 0,
+                .endOfPassWriteIndex = 1,
+            } : NULL,
         });
         //wgpuRenderPassEncoderSetViewport(renderPass, 0, 0, (float) app->config.width, (float) app->config.height, 0.0f, 1.0f);
 
-        wgpuRenderPassEncoderSetPipeline(renderPass, renderPipeline);
-        wgpuRenderPassEncoderSetBindGroup(renderPass, 0, pipelineBindGroup, 0, NULL);
-        //wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexInBuffer, 0, wgpuBufferGetSize(vertexInBuffer));
-        wgpuRenderPassEncoderDraw(renderPass, 4, numSplats, 0, 0);
+        if (renderMode == RENDER_TILES) {
+            tileRendererBlit(&tileRenderer, renderPass);
+        } else if (offscreenDraw) {
+            offscreenTargetComposite(&offscreen, renderPass);
+        } else {
+            wgpuRenderPassEncoderSetPipeline(renderPass, gather ? renderGatheredPipelines[QUAD_BLEND_SURFACE]
+                                                                : renderPipelines[QUAD_BLEND_SURFACE]);
+            wgpuRenderPassEncoderSetBindGroup(renderPass, 0, gather ? gatheredPipelineBindGroups[drawTarget] : draw->pipelineBindGroup,
+                                              1, &(uint32_t) {0});
+            //wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexInBuffer, 0, wgpuBufferGetSize(vertexInBuffer));
+            if (gpuSort)
+                wgpuRenderPassEncoderDrawIndirect(renderPass, draw->indirectBuffer, INDIRECT_DRAW * sizeof(uint32_t));
+            else
+                wgpuRenderPassEncoderDraw(renderPass, 4, numSplats, 0, 0);
+        }
+        // ImGui gets a pass of its own, outside of the timestamps
+        wgpuRenderPassEncoderEnd(renderPass);
+        wgpuRenderPassEncoderRelease(renderPass);
 
         double sortTime = timeDiffSec(sortStart, sortEnd) * 1000;
 
         igBegin("GaussianSplatting", NULL, 0);
         igSeparator();
         igText("==========Config==========");
-        igSliderFloat("Splat size", &uniform.scale, 0.01f, 1.0f, "%.2f", 0);
         igSliderFloat3("Camera center", camera.center, -10.0f, 10.0f, "%.2f", 0);
         char comboBuf[256];
         // Emscripten why cant you be normal :/
@@ -610,20 +1134,177 @@ void render(const AppState *app, float dt) {
         snprintf(comboBuf + len, sizeof(comboBuf) - len, "%s", splatFiles[2]);
         len += strlen(comboBuf + len) + 1;
         comboBuf[len] = '\0';
+        if (scenePath)
+            igText("Scene: %s", scenePath);
         changeSplat = igCombo_Str("Splat file", &splatIdx, comboBuf, 0);
-        igCheckbox("GPU Sort", &gpuSort);
+        if (changeSplat)
+            scenePath = NULL;
+        // Reloading rebuilds the buffers and shaders in the other layout
+        if (halfSupported && igCheckbox("Half precision (shader-f16)", &halfPrecision))
+            changeSplat = true;
+        if (scene.shDegree > 0)
+            igSliderFloat("SH budget (MB per update)", &shBudgetMB, 0.0f, 512.0f, "%.0f MB", 0);
+        igText("Renderer:");
+        igSameLine(0, -1);
+        if (igRadioButton_IntPtr("Sorted quads", &renderMode, RENDER_QUADS))
+            sortScheduleInvalidate(&sortSchedule);
+        igSameLine(0, -1);
+        igRadioButton_IntPtr("Tiles (compute)", &renderMode, RENDER_TILES);
+        // The indirect draw arguments are only written together with a GPU sort
+        if (igCheckbox("GPU Sort", &gpuSort))
+            sortScheduleInvalidate(&sortSchedule);
         igCheckbox("Always Sort", &alwaysSort);
+        if (gpuSort && igCheckbox("Pipelined sort (1 frame order lag)", &pipelinedSort))
+            sortScheduleInvalidate(&sortSchedule);
+        if (renderMode == RENDER_QUADS) {
+            igCheckbox("Dynamic resolution", &dynamicRes.enabled);
+            if (dynamicRes.enabled)
+                igSliderFloat(drawTimestamps ? "Target draw time" : "Target frame time", &dynamicRes.targetMs,
+                              2.0f, 50.0f, "%.1f ms", 0);
+            igText("Gather draw order:");
+            igSameLine(0, -1);
+            igRadioButton_IntPtr("Auto##gather", &gatherMode, GATHER_AUTO);
+            igSameLine(0, -1);
+            igRadioButton_IntPtr("On##gather", &gatherMode, GATHER_ON);
+            igSameLine(0, -1);
+            igRadioButton_IntPtr("Off##gather", &gatherMode, GATHER_OFF);
+        }
+        SortScheduleConfig *scheduleConfig = &sortSchedule.config;
+        igCheckbox("Sort scheduler", &scheduleConfig->enabled);
+        if (scheduleConfig->enabled) {
+            igSliderFloat("Re-sort angle", &scheduleConfig->maxAngle, 0.0f, 30.0f, "%.1f deg", 0);
+            igSliderFloat("Re-sort move", &scheduleConfig->maxMove, 0.0f, 0.5f, "%.3f", 0);
+            igSliderFloat("Max sorts/s", &scheduleConfig->maxRate, 1.0f, 120.0f, "%.0f", 0);
+        }
+        if (gpuSort) {
+            if (igCheckbox("Frustum culling", &frustumCulling))
+                sortScheduleInvalidate(&sortSchedule);
+            if (renderMode == RENDER_QUADS && igCheckbox("Front to back (early out)", &frontToBack))
+                sortScheduleInvalidate(&sortSchedule);
+            igText("GPU sort:");
+            igSameLine(0, -1);
+            if (igRadioButton_IntPtr("Bitonic", &gpuSortAlgorithm, GPU_SORT_BITONIC))
+                sortScheduleInvalidate(&sortSchedule);
+            igSameLine(0, -1);
+            if (igRadioButton_IntPtr("Radix", &gpuSortAlgorithm, GPU_SORT_RADIX))
+                sortScheduleInvalidate(&sortSchedule);
+            igSameLine(0, -1);
+            if (igRadioButton_IntPtr("Bucket", &gpuSortAlgorithm, GPU_SORT_BUCKET))
+                sortScheduleInvalidate(&sortSchedule);
+            igSameLine(0, -1);
+            if (igRadioButton_IntPtr("Incremental", &gpuSortAlgorithm, GPU_SORT_INCREMENTAL))
+                sortScheduleInvalidate(&sortSchedule);
+            if (gpuSortAlgorithm == GPU_SORT_INCREMENTAL)
+                igSliderFloat("Full sort above inversions", &resortFraction, 0.0f, 0.2f, "%.3f", 0);
+            if (gpuSortAlgorithm == GPU_SORT_BUCKET)
+                if (igSliderInt("Refined buckets (nearest)", &bucketRefined, 0, GPU_BUCKET_COUNT, "%d", 0))
+                    sortScheduleInvalidate(&sortSchedule);
+            if (gpuSortAlgorithm == GPU_SORT_RADIX) {
+                igText("GPU sort key:");
+                igSameLine(0, -1);
+                igRadioButton_IntPtr("16 bit##gpu", &gpuRadixKeyBits, 16);
+                igSameLine(0, -1);
+                igRadioButton_IntPtr("24 bit##gpu", &gpuRadixKeyBits, 24);
+                igSameLine(0, -1);
+                igRadioButton_IntPtr("32 bit##gpu", &gpuRadixKeyBits, 32);
+            }
+        }
+        if (!gpuSort) {
+            igText("CPU sort key:");
+            igSameLine(0, -1);
+            igRadioButton_IntPtr("16 bit", &cpuSortKeyBits, 16);
+            igSameLine(0, -1);
+            igRadioButton_IntPtr("32 bit", &cpuSortKeyBits, 32);
+            igCheckbox("Incremental CPU sort", &cpuSortConfig.incremental);
+            igCheckbox("Async CPU sort", &asyncSort);
+        }
         igSeparator();
         igText("==========Performance==========");
         igText("Frame time: %.2f ms", dt * 1000);
         igText(" > Sort time: %.2f ms", sortTime);
+        if (drawGpuMs >= 0.0)
+            igText(" > Splat passes (GPU): %.3f ms", drawGpuMs);
+        if (renderMode == RENDER_QUADS && dynamicRes.enabled)
+            igText(" > Resolution scale: %.2f (target %.2f), %ux%u for %.1f ms %s", dynamicRes.scale,
+                   dynamicRes.targetScale, renderWidth, renderHeight, dynamicRes.targetMs,
+                   drawGpuMs >= 0.0 ? "draw time" : "frame time");
+        if (renderMode == RENDER_QUADS) {
+            igText(" > Drawn order: sorted %llu frames ago", (unsigned long long) (frame - draw->sortFrame));
+            igText(" > Records: %.1f MB (%s), %s", numSplats * recordSize() / (1024.0 * 1024.0), halfPrecision ? "f16" : "f32",
+                   gather ? "gathered into draw order" : "read through the sorted indices");
+            if (scene.shDegree > 0)
+                igText(" > SH: degree %u of %u, %.1f MB", shDegree, scene.shDegree,
+                       numSplats * splatShStride(shDegree) * sizeof(uint32_t) / (1024.0 * 1024.0));
+            if (frontToBackDraw)
+                igText(" > Front to back: %u batches, saturated pixels masked between them", DRAW_BATCHES);
+        }
+        if (renderMode == RENDER_TILES) {
+            igText(" > Tiles: %ux%u, %u instances max", tileRenderer.tilesX, tileRenderer.tilesY, tileRenderer.capacity);
+            // Same footprints as the quads, but the tiles only read the DC color
+            if (shDegree > 0)
+                igText(" > Tiles: no spherical harmonics, colors differ from the quads");
+        }
+        static const char *decisionNames[] = {"skip", "moving", "exact"};
+        igText(" > Schedule: %s (%s)", alwaysSort ? "always" : decisionNames[sortSchedule.decision], sortSchedule.reason);
+        igText(" > View change: %.2f deg, %.3f move", sortSchedule.angle, sortSchedule.move);
+        igText(" > Sorts: %.1f/s (%llu sorted, %llu skipped)", sortSchedule.rate,
+               (unsigned long long) sortSchedule.sorts, (unsigned long long) sortSchedule.skips);
+        if (gpuSort && gpuSortAlgorithm == GPU_SORT_BITONIC)
+            igText(" > GPU bitonic dispatches: %u", bitonicDispatches);
+        if (gpuSort && gpuSortAlgorithm == GPU_SORT_RADIX)
+            igText(" > GPU radix passes: %u (%u dispatches)", gpuRadixSortPasses(gpuRadixKeyBits),
+                   3 * gpuRadixSortPasses(gpuRadixKeyBits));
+        if (gpuSort && gpuSortAlgorithm == GPU_SORT_BUCKET && draw->bucketSort.stats.hasData) {
+            // Out of order neighbours in the sorted indices, a couple of sorts old
+            const uint32_t *stats = draw->bucketSort.stats.data;
+            uint32_t sorted = stats[GPU_BUCKET_STAT_COUNT];
+            uint32_t inversions = stats[GPU_BUCKET_STAT_INVERSIONS];
+            igText(" > Bucket sort error: %u of %u neighbours (%.3f%%)", inversions, sorted,
+                   sorted > 1 ? 100.0 * inversions / (sorted - 1) : 0.0);
+            igText(" > Buckets over %u splats: %u", GPU_BUCKET_REFINE_SIZE, stats[GPU_BUCKET_STAT_OVERSIZED]);
+        }
+        if (gpuSort && gpuSortAlgorithm == GPU_SORT_INCREMENTAL && incrementalStats.hasData) {
+            // The inversions were counted before the repair, in last frame's order
+            const uint32_t *stats = incrementalStats.data;
+            igText(" > Incremental sort: %s, %u inversions (%.3f%%)", stats[1] ? "full sort" : "repaired",
+                   stats[0], numSplats > 1 ? 100.0 * stats[0] / (numSplats - 1) : 0.0);
+        }
+        if (!gpuSort) {
+            if (asyncSort)
+                igText(" > Sort thread: %.2f ms (%u threads, %s)", sortStats.time * 1000, threadsCount(), depthKernelName());
+            else
+                igText(" > CPU radix passes: %u (%u threads, %s)", sortWorker.sort.radix.passes, threadsCount(), depthKernelName());
+            igText(" > Sort age: %llu frames", (unsigned long long) (lastSortRequest - sortStats.frame));
+            if (sortStats.kind != CPU_SORT_NONE)
+                igText(" > CPU sort: %s (%s)", sortStats.kind == CPU_SORT_FULL ? "full" : "incremental", sortStats.reason);
+            else
+                igText(" > CPU sort: skipped (%s)", sortStats.reason);
+            igText(" > Moved: %llu, uploaded: %.1f KB", (unsigned long long) sortStats.moves, uploadedBytes / 1024.0);
+        }
+        igText("Load: %.1f ms (%.1f MB/s)", scene.loadTime * 1000.0, splatSceneLoadThroughput(&scene));
         igEnd();
 
         igRender();
-        ImGui_ImplWGPU_RenderDrawData(igGetDrawData(), renderPass);
-
-        wgpuRenderPassEncoderEnd(renderPass);
-        wgpuRenderPassEncoderRelease(renderPass);
+        WGPURenderPassEncoder uiPass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor) {
+            .nextInChain = NULL,
+            .colorAttachmentCount = 1,
+            .colorAttachments = &(WGPURenderPassColorAttachment) {
+                .view = app->view,
+                .loadOp = WGPULoadOp_Load,
+                .storeOp = WGPUStoreOp_Store,
+#ifdef __EMSCRIPTEN__
+                    .depthSlice = WGPU_DEPTH_SLICE_UNDEFINED,
+#endif
+            },
+            .depthStencilAttachment = NULL,
+        });
+        ImGui_ImplWGPU_RenderDrawData(igGetDrawData(), uiPass);
+        wgpuRenderPassEncoderEnd(uiPass);
+        wgpuRenderPassEncoderRelease(uiPass);
+        if (drawTimestamps) {
+            wgpuCommandEncoderResolveQuerySet(encoder, drawTimestamps, 0, 2, drawTimestampBuffer, 0);
+            gpuReadbackCopy(&drawTimer, encoder, drawTimestampBuffer, 0);
+        }
 
 
         // Encode and submit
@@ -634,9 +1315,16 @@ void render(const AppState *app, float dt) {
 
         wgpuQueueSubmit(queue, 1, &command);
         wgpuCommandBufferRelease(command);
+        if (drawTimestamps)
+            gpuReadbackMap(&drawTimer);
 
         wgpuCommandEncoderRelease(encoder);
     }
+    if (sortCommand) {
+        // Queued behind the frame, the next frame draws it
+        submitSort(target, sortCommand);
+        drawTarget ^= 1;
+    }
 
 
 }
@@ -0,0 +1,288 @@
+#include "offscreen.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cglm/cglm.h>
+
+#include "utils.h"
+
+static WGPURenderPipeline createPipeline(WGPUDevice device, const OffscreenTarget *target, const char *fragmentEntryPoint,
+                                         const WGPUColorTargetState *colorTarget,
+                                         const WGPUDepthStencilState *depthStencil) {
+    return wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor) {
+        .layout = target->layout,
+        .primitive.topology = WGPUPrimitiveTopology_TriangleList,
+        .primitive.stripIndexFormat = WGPUIndexFormat_Undefined,
+        .primitive.frontFace = WGPUFrontFace_CCW,
+        .primitive.cullMode = WGPUCullMode_None,
+        .vertex.module = target->module,
+        .vertex.bufferCount = 0,
+        .vertex.entryPoint = "vs_fullscreen",
+        .fragment = &(WGPUFragmentState) {
+            .module = target->module,
+            .entryPoint = fragmentEntryPoint,
+            .targetCount = colorTarget ? 1 : 0,
+            .targets = colorTarget,
+        },
+        .depthStencil = depthStencil,
+        .multisample.count = 1,
+        .multisample.mask = ~0u,
+        .multisample.alphaToCoverageEnabled = false,
+    });
+}
+
+void offscreenTargetInit(OffscreenTarget *target, WGPUDevice device, WGPUTextureFormat surfaceFormat) {
+    offscreenTargetFree(target);
+    target->colorFormat = surfaceFormat;
+
+    char *shader = (char *) readFile("assets/offscreen.wgsl");
+    target->module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = "Offscreen Shader",
+    });
+    free(shader);
+
+    target->bindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 2,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            [0] = {
+                .binding = 0,
+                .visibility = WGPUShaderStage_Fragment,
+                .texture = {
+                    .sampleType = WGPUTextureSampleType_Float,
+                    .viewDimension = WGPUTextureViewDimension_2D,
+                },
+            },
+            [1] = {
+                .binding = 1,
+                .visibility = WGPUShaderStage_Fragment,
+                .sampler.type = WGPUSamplerBindingType_Filtering,
+            },
+        }
+    });
+    // Upscales the scaled down target
+    target->sampler = wgpuDeviceCreateSampler(device, &(WGPUSamplerDescriptor) {
+        .label = "Offscreen Sampler",
+        .addressModeU = WGPUAddressMode_ClampToEdge,
+        .addressModeV = WGPUAddressMode_ClampToEdge,
+        .addressModeW = WGPUAddressMode_ClampToEdge,
+        .magFilter = WGPUFilterMode_Linear,
+        .minFilter = WGPUFilterMode_Linear,
+        .mipmapFilter = WGPUMipmapFilterMode_Nearest,
+        .lodMinClamp = 0.0f,
+        .lodMaxClamp = 1.0f,
+        .maxAnisotropy = 1,
+    });
+    target->layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            target->bindLayout,
+        },
+        .label = "Offscreen Layout",
+    });
+
+    // Stencil only, the reference (OFFSCREEN_SATURATED) replaces it where fs_saturation passes
+    WGPUStencilFaceState mark = {
+        .compare = WGPUCompareFunction_Always,
+        .failOp = WGPUStencilOperation_Keep,
+        .depthFailOp = WGPUStencilOperation_Keep,
+        .passOp = WGPUStencilOperation_Replace,
+    };
+    target->saturationPipeline = createPipeline(device, target, "fs_saturation", NULL, &(WGPUDepthStencilState) {
+        .format = OFFSCREEN_STENCIL_FORMAT,
+        .depthWriteEnabled = false,
+        .depthCompare = WGPUCompareFunction_Always,
+        .stencilFront = mark,
+        .stencilBack = mark,
+        .stencilReadMask = 0xff,
+        .stencilWriteMask = 0xff,
+    });
+    target->compositePipeline = createPipeline(device, target, "fs_composite", &(WGPUColorTargetState) {
+        .format = surfaceFormat,
+        .writeMask = WGPUColorWriteMask_All,
+        .blend = &(WGPUBlendState) {
+            .color = {
+                .operation = WGPUBlendOperation_Add,
+                .srcFactor = WGPUBlendFactor_One,
+                .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+            },
+            .alpha = {
+                .operation = WGPUBlendOperation_Add,
+                .srcFactor = WGPUBlendFactor_One,
+                .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+            },
+        },
+    }, NULL);
+}
+
+static void releaseSizeDependent(OffscreenTarget *target) {
+    if (target->bindGroup) wgpuBindGroupRelease(target->bindGroup);
+    if (target->colorView) wgpuTextureViewRelease(target->colorView);
+    if (target->color) wgpuTextureRelease(target->color);
+    if (target->stencilView) wgpuTextureViewRelease(target->stencilView);
+    if (target->stencil) wgpuTextureRelease(target->stencil);
+    target->bindGroup = NULL;
+    target->colorView = NULL;
+    target->color = NULL;
+    target->stencilView = NULL;
+    target->stencil = NULL;
+    target->width = 0;
+    target->height = 0;
+}
+
+void offscreenTargetFree(OffscreenTarget *target) {
+    releaseSizeDependent(target);
+    if (target->saturationPipeline) wgpuRenderPipelineRelease(target->saturationPipeline);
+    if (target->compositePipeline) wgpuRenderPipelineRelease(target->compositePipeline);
+    if (target->sampler) wgpuSamplerRelease(target->sampler);
+    if (target->layout) wgpuPipelineLayoutRelease(target->layout);
+    if (target->bindLayout) wgpuBindGroupLayoutRelease(target->bindLayout);
+    if (target->module) wgpuShaderModuleRelease(target->module);
+    memset(target, 0, sizeof(*target));
+}
+
+static WGPUTexture createTexture(WGPUDevice device, const char *label, WGPUTextureUsageFlags usage,
+                                 WGPUTextureFormat format, uint32_t width, uint32_t height) {
+    return wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor) {
+        .label = label,
+        .usage = usage,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {width, height, 1},
+        .format = format,
+        .mipLevelCount = 1,
+        .sampleCount = 1,
+    });
+}
+
+static WGPUTextureView createView(WGPUTexture texture, const char *label, WGPUTextureFormat format) {
+    return wgpuTextureCreateView(texture, &(WGPUTextureViewDescriptor) {
+        .label = label,
+        .format = format,
+        .dimension = WGPUTextureViewDimension_2D,
+        .baseMipLevel = 0,
+        .mipLevelCount = 1,
+        .baseArrayLayer = 0,
+        .arrayLayerCount = 1,
+        .aspect = WGPUTextureAspect_All,
+    });
+}
+
+void offscreenTargetResize(OffscreenTarget *target, WGPUDevice device, uint32_t width, uint32_t height) {
+    if (width == target->width && height == target->height)
+        return;
+    releaseSizeDependent(target);
+    if (width == 0 || height == 0)
+        return;
+    target->width = width;
+    target->height = height;
+
+    target->color = createTexture(device, "Offscreen Color",
+                                  WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
+                                  target->colorFormat, width, height);
+    target->colorView = createView(target->color, "Offscreen Color View", target->colorFormat);
+    target->stencil = createTexture(device, "Offscreen Stencil", WGPUTextureUsage_RenderAttachment,
+                                    OFFSCREEN_STENCIL_FORMAT, width, height);
+    target->stencilView = createView(target->stencil, "Offscreen Stencil View", OFFSCREEN_STENCIL_FORMAT);
+
+    target->bindGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = target->bindLayout,
+        .entryCount = 2,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = {.binding = 0, .textureView = target->colorView},
+            [1] = {.binding = 1, .sampler = target->sampler},
+        },
+        .label = "Offscreen Bind Group",
+    });
+}
+
+WGPURenderPassEncoder offscreenTargetBeginPass(const OffscreenTarget *target, WGPUCommandEncoder encoder, bool clear,
+                                               const WGPURenderPassTimestampWrites *timestampWrites) {
+    return wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor) {
+        .label = "Offscreen Pass",
+        .colorAttachmentCount = 1,
+        .colorAttachments = &(WGPURenderPassColorAttachment) {
+            .view = target->colorView,
+            .loadOp = clear ? WGPULoadOp_Clear : WGPULoadOp_Load,
+            .storeOp = WGPUStoreOp_Store,
+            .clearValue = {0.0f, 0.0f, 0.0f, 0.0f},
+#ifdef __EMSCRIPTEN__
+            .depthSlice = WGPU_DEPTH_SLICE_UNDEFINED,
+#endif
+        },
+        .depthStencilAttachment = &(WGPURenderPassDepthStencilAttachment) {
+            .view = target->stencilView,
+            .depthLoadOp = WGPULoadOp_Undefined,
+            .depthStoreOp = WGPUStoreOp_Undefined,
+            .stencilLoadOp = clear ? WGPULoadOp_Clear : WGPULoadOp_Load,
+            .stencilStoreOp = WGPUStoreOp_Store,
+            .stencilClearValue = 0,
+        },
+        .timestampWrites = timestampWrites,
+    });
+}
+
+void offscreenTargetMarkSaturated(const OffscreenTarget *target, WGPUCommandEncoder encoder) {
+    // Reads the color it does not render to, the stencil is the only attachment
+    WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor) {
+        .label = "Offscreen Saturation Pass",
+        .colorAttachmentCount = 0,
+        .depthStencilAttachment = &(WGPURenderPassDepthStencilAttachment) {
+            .view = target->stencilView,
+            .depthLoadOp = WGPULoadOp_Undefined,
+            .depthStoreOp = WGPUStoreOp_Undefined,
+            .stencilLoadOp = WGPULoadOp_Load,
+            .stencilStoreOp = WGPUStoreOp_Store,
+        },
+    });
+    wgpuRenderPassEncoderSetPipeline(pass, target->saturationPipeline);
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, target->bindGroup, 0, NULL);
+    wgpuRenderPassEncoderSetStencilReference(pass, OFFSCREEN_SATURATED);
+    wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+    wgpuRenderPassEncoderEnd(pass);
+    wgpuRenderPassEncoderRelease(pass);
+}
+
+void offscreenTargetComposite(const OffscreenTarget *target, WGPURenderPassEncoder pass) {
+    if (!target->bindGroup)
+        return;
+    wgpuRenderPassEncoderSetPipeline(pass, target->compositePipeline);
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, target->bindGroup, 0, NULL);
+    wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+}
+
+void dynamicResolutionUpdate(DynamicResolution *res, float frameMs) {
+    if (!res->enabled) {
+        res->frameMs = frameMs;
+        res->targetScale = res->scale = 1.0f;
+        return;
+    }
+    if (frameMs <= 0.0f)
+        return;
+    // Smoothed, single slow frames should not resize the target
+    res->frameMs = res->frameMs > 0.0f ? res->frameMs + 0.1f * (frameMs - res->frameMs) : frameMs;
+
+    // Cost ~ scale^2, at most 2% per frame against oscillation. The target keeps moving
+    // between steps, the frame time only reacts once the rendered scale follows.
+    float ratio = sqrtf(res->targetMs / res->frameMs);
+    ratio = glm_clamp(ratio, 0.98f, 1.02f);
+    res->targetScale = glm_clamp(res->targetScale * ratio, res->minScale, 1.0f);
+
+    // Only moves once the target is a whole step away
+    if (fabsf(res->targetScale - res->scale) >= res->step) {
+        float steps = roundf(res->targetScale / res->step);
+        res->scale = glm_clamp(steps * res->step, res->minScale, 1.0f);
+    }
+}
+
+void dynamicResolutionSize(const DynamicResolution *res, uint32_t width, uint32_t height, uint32_t *scaledWidth,
+                           uint32_t *scaledHeight) {
+    float scale = res->enabled ? res->scale : 1.0f;
+    *scaledWidth = (uint32_t) fmaxf(roundf((float) width * scale), 1.0f);
+    *scaledHeight = (uint32_t) fmaxf(roundf((float) height * scale), 1.0f);
+}
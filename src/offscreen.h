@@ -0,0 +1,85 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <webgpu/webgpu.h>
+
+#define OFFSCREEN_STENCIL_FORMAT WGPUTextureFormat_Stencil8
+// Stencil value of the pixels offscreenTargetMarkSaturated found saturated
+#define OFFSCREEN_SATURATED 1
+
+// Color + stencil target the splats are drawn into, at the dynamic resolution scale of
+// the surface. Front to back, between draw batches the pixels whose accumulated alpha
+// saturated get marked in the stencil. The splat pipelines only pass where it is
+// still 0, so later batches skip them.
+typedef struct OffscreenTarget {
+    uint32_t width;
+    uint32_t height;
+    // The surface's, so the splats blend in the same (sRGB or not) space as when they
+    // are drawn onto the surface directly
+    WGPUTextureFormat colorFormat;
+
+    WGPUShaderModule module;
+    WGPUBindGroupLayout bindLayout;
+    WGPUPipelineLayout layout;
+    WGPURenderPipeline saturationPipeline;
+    WGPURenderPipeline compositePipeline;
+    WGPUSampler sampler;
+
+    // Depend on the size
+    WGPUTexture color;
+    WGPUTextureView colorView;
+    WGPUTexture stencil;
+    WGPUTextureView stencilView;
+    WGPUBindGroup bindGroup;
+} OffscreenTarget;
+
+void offscreenTargetInit(OffscreenTarget *target, WGPUDevice device, WGPUTextureFormat surfaceFormat);
+void offscreenTargetFree(OffscreenTarget *target);
+
+// Recreates the textures when the size changed
+void offscreenTargetResize(OffscreenTarget *target, WGPUDevice device, uint32_t width, uint32_t height);
+
+// Render pass into the target, clear starts a frame (transparent, nothing saturated)
+WGPURenderPassEncoder offscreenTargetBeginPass(const OffscreenTarget *target, WGPUCommandEncoder encoder, bool clear,
+                                               const WGPURenderPassTimestampWrites *timestampWrites);
+// Records its own pass that marks the saturated pixels in the stencil
+void offscreenTargetMarkSaturated(const OffscreenTarget *target, WGPUCommandEncoder encoder);
+// Blends the (premultiplied) target over what the pass' target holds, stretched to
+// cover all of it
+void offscreenTargetComposite(const OffscreenTarget *target, WGPURenderPassEncoder pass);
+
+// Picks the offscreen scale (per axis) that holds a draw or frame time target. The splat
+// pass is fill rate bound, so its cost goes with the square of the scale.
+typedef struct DynamicResolution {
+    bool enabled;
+    float targetMs;
+    float minScale;
+    // The scale only moves in these steps, so the target is not resized every frame
+    float step;
+
+    // Smoothed frame time the last update saw
+    float frameMs;
+    // Scale that would hold targetMs, and the quantized one that is rendered
+    float targetScale;
+    float scale;
+} DynamicResolution;
+
+static const DynamicResolution DYNAMIC_RESOLUTION_DEFAULT = {
+    .enabled = false,
+    .targetMs = 1000.0f / 60.0f,
+    .minScale = 0.25f,
+    .step = 0.05f,
+    .targetScale = 1.0f,
+    .scale = 1.0f,
+};
+
+// frameMs is the last measured time of what the scale affects
+void dynamicResolutionUpdate(DynamicResolution *res, float frameMs);
+// The size of the offscreen target for a surface
+void dynamicResolutionSize(const DynamicResolution *res, uint32_t width, uint32_t height, uint32_t *scaledWidth,
+                           uint32_t *scaledHeight);
+
+#endif //OFFSCREEN_H
@@ -0,0 +1,431 @@
+#include "poses.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+static CameraPose *appendPose(CameraPoses *poses) {
+    if (poses->count == poses->capacity) {
+        uint32_t capacity = poses->capacity ? 2 * poses->capacity : 64;
+        CameraPose *grown = realloc(poses->poses, capacity * sizeof(*grown));
+        if (!grown)
+            return NULL;
+        poses->poses = grown;
+        poses->capacity = capacity;
+    }
+    CameraPose *pose = poses->poses + poses->count++;
+    memset(pose, 0, sizeof(*pose));
+    return pose;
+}
+
+// Copies the line at cursor (without the line break) into buf, NULL past the end
+static const char *nextLine(const char *cursor, char *buf, size_t size) {
+    if (!*cursor)
+        return NULL;
+    size_t len = strcspn(cursor, "\r\n");
+    size_t copied = len < size - 1 ? len : size - 1;
+    memcpy(buf, cursor, copied);
+    buf[copied] = '\0';
+    cursor += len;
+    if (*cursor == '\r')
+        cursor++;
+    if (*cursor == '\n')
+        cursor++;
+    return cursor;
+}
+
+static bool isBlankOrComment(const char *line) {
+    while (isspace((unsigned char) *line))
+        line++;
+    return *line == '\0' || *line == '#';
+}
+
+typedef struct ColmapCamera {
+    uint32_t id;
+    uint32_t width;
+    uint32_t height;
+    float fx, fy;
+    float cx, cy;
+} ColmapCamera;
+
+static bool parseColmapCamera(const char *line, ColmapCamera *camera) {
+    char model[64];
+    int consumed = 0;
+    if (sscanf(line, "%u %63s %u %u %n", &camera->id, model, &camera->width, &camera->height, &consumed) != 4)
+        return false;
+    // The single focal length models: f, cx, cy, distortion... (SIMPLE_PINHOLE has none)
+    bool singleFocal = !strcmp(model, "SIMPLE_PINHOLE") || !strcmp(model, "SIMPLE_RADIAL") ||
+                       !strcmp(model, "RADIAL") || !strcmp(model, "SIMPLE_RADIAL_FISHEYE") ||
+                       !strcmp(model, "RADIAL_FISHEYE");
+    int paramCount = singleFocal ? 3 : 4;
+    double params[4];
+    const char *cursor = line + consumed;
+    for (int i = 0; i < paramCount; i++) {
+        char *end;
+        params[i] = strtod(cursor, &end);
+        if (end == cursor)
+            return false;
+        cursor = end;
+    }
+    if (singleFocal) {
+        camera->fx = camera->fy = (float) params[0];
+        camera->cx = (float) params[1];
+        camera->cy = (float) params[2];
+    } else {
+        // fx, fy, cx, cy, distortion...
+        camera->fx = (float) params[0];
+        camera->fy = (float) params[1];
+        camera->cx = (float) params[2];
+        camera->cy = (float) params[3];
+    }
+    return true;
+}
+
+static void quaternionToRotation(const double q[4], float rotation[3][3]) {
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    double length = sqrt(w * w + x * x + y * y + z * z);
+    if (length > 0.0) {
+        w /= length;
+        x /= length;
+        y /= length;
+        z /= length;
+    }
+    rotation[0][0] = (float) (1.0 - 2.0 * (y * y + z * z));
+    rotation[0][1] = (float) (2.0 * (x * y - w * z));
+    rotation[0][2] = (float) (2.0 * (x * z + w * y));
+    rotation[1][0] = (float) (2.0 * (x * y + w * z));
+    rotation[1][1] = (float) (1.0 - 2.0 * (x * x + z * z));
+    rotation[1][2] = (float) (2.0 * (y * z - w * x));
+    rotation[2][0] = (float) (2.0 * (x * z - w * y));
+    rotation[2][1] = (float) (2.0 * (y * z + w * x));
+    rotation[2][2] = (float) (1.0 - 2.0 * (x * x + y * y));
+}
+
+bool cameraPosesLoadColmap(CameraPoses *poses, const char *imagesPath, const char *camerasPath) {
+    char *cameraText = (char *) readFile(camerasPath);
+    if (!cameraText) {
+        fprintf(stderr, "Failed to open file %s\n", camerasPath);
+        return false;
+    }
+    ColmapCamera *cameras = NULL;
+    uint32_t cameraCount = 0;
+    char line[1024];
+    for (const char *cursor = cameraText; (cursor = nextLine(cursor, line, sizeof(line)));) {
+        if (isBlankOrComment(line))
+            continue;
+        ColmapCamera camera;
+        if (!parseColmapCamera(line, &camera)) {
+            fprintf(stderr, "Invalid camera in %s: %s\n", camerasPath, line);
+            continue;
+        }
+        ColmapCamera *grown = realloc(cameras, (cameraCount + 1) * sizeof(*cameras));
+        if (!grown)
+            break;
+        cameras = grown;
+        cameras[cameraCount++] = camera;
+    }
+    free(cameraText);
+
+    char *imageText = (char *) readFile(imagesPath);
+    if (!imageText) {
+        fprintf(stderr, "Failed to open file %s\n", imagesPath);
+        free(cameras);
+        return false;
+    }
+    // Every image takes two lines, the second one (its 2D points) may be empty
+    bool ok = true;
+    for (const char *cursor = imageText; (cursor = nextLine(cursor, line, sizeof(line)));) {
+        if (isBlankOrComment(line))
+            continue;
+        uint32_t imageId, cameraId;
+        double q[4], t[3];
+        char name[256];
+        if (sscanf(line, "%u %lf %lf %lf %lf %lf %lf %lf %u %255[^\n]", &imageId, &q[0], &q[1], &q[2], &q[3],
+                   &t[0], &t[1], &t[2], &cameraId, name) != 10) {
+            fprintf(stderr, "Invalid image in %s: %s\n", imagesPath, line);
+            ok = false;
+            break;
+        }
+        cursor = nextLine(cursor, line, sizeof(line));
+
+        const ColmapCamera *camera = NULL;
+        for (uint32_t i = 0; i < cameraCount; i++) {
+            if (cameras[i].id == cameraId)
+                camera = cameras + i;
+        }
+        if (!camera) {
+            fprintf(stderr, "Image %s has no camera %u in %s\n", name, cameraId, camerasPath);
+            ok = false;
+            break;
+        }
+        CameraPose *pose = appendPose(poses);
+        if (!pose) {
+            ok = false;
+            break;
+        }
+        snprintf(pose->name, sizeof(pose->name), "%s", name);
+        pose->width = camera->width;
+        pose->height = camera->height;
+        pose->fx = camera->fx;
+        pose->fy = camera->fy;
+        pose->cx = camera->cx;
+        pose->cy = camera->cy;
+        quaternionToRotation(q, pose->rotation);
+        for (int i = 0; i < 3; i++)
+            pose->translation[i] = (float) t[i];
+        if (!cursor)
+            break;
+    }
+    free(imageText);
+    free(cameras);
+    return ok;
+}
+
+// Just enough JSON for cameras.json: values that are not needed are skipped
+
+static const char *jsonSkipSpace(const char *p) {
+    while (isspace((unsigned char) *p))
+        p++;
+    return p;
+}
+
+static const char *jsonString(const char *p, char *out, size_t size) {
+    p = jsonSkipSpace(p);
+    if (*p != '"')
+        return NULL;
+    p++;
+    size_t len = 0;
+    while (*p && *p != '"') {
+        char c = *p++;
+        if (c == '\\' && *p) {
+            c = *p++;
+            // Escaped code points are not needed for file names, they are dropped
+            if (c == 'u') {
+                for (int i = 0; i < 4 && isxdigit((unsigned char) *p); i++)
+                    p++;
+                continue;
+            }
+            c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+        }
+        if (out && len + 1 < size)
+            out[len++] = c;
+    }
+    if (*p != '"')
+        return NULL;
+    if (out)
+        out[len] = '\0';
+    return p + 1;
+}
+
+static const char *jsonNumber(const char *p, double *out) {
+    p = jsonSkipSpace(p);
+    char *end;
+    *out = strtod(p, &end);
+    return end == p ? NULL : end;
+}
+
+// Reads the numbers of a (nested) array in order, at most count of them
+static const char *jsonNumbers(const char *p, double *out, uint32_t count, uint32_t *read) {
+    p = jsonSkipSpace(p);
+    if (*p != '[')
+        return NULL;
+    p = jsonSkipSpace(p + 1);
+    if (*p == ']')
+        return p + 1;
+    for (;;) {
+        p = jsonSkipSpace(p);
+        if (*p == '[') {
+            p = jsonNumbers(p, out, count, read);
+        } else {
+            double value;
+            p = jsonNumber(p, &value);
+            if (p && *read < count)
+                out[(*read)++] = value;
+        }
+        if (!p)
+            return NULL;
+        p = jsonSkipSpace(p);
+        if (*p == ']')
+            return p + 1;
+        if (*p != ',')
+            return NULL;
+        p++;
+    }
+}
+
+static const char *jsonSkipValue(const char *p) {
+    p = jsonSkipSpace(p);
+    if (*p == '"')
+        return jsonString(p, NULL, 0);
+    if (*p == '[' || *p == '{') {
+        char close = *p == '[' ? ']' : '}';
+        p = jsonSkipSpace(p + 1);
+        if (*p == close)
+            return p + 1;
+        for (;;) {
+            if (close == '}') {
+                p = jsonString(p, NULL, 0);
+                if (!p)
+                    return NULL;
+                p = jsonSkipSpace(p);
+                if (*p != ':')
+                    return NULL;
+                p++;
+            }
+            p = jsonSkipValue(p);
+            if (!p)
+                return NULL;
+            p = jsonSkipSpace(p);
+            if (*p == close)
+                return p + 1;
+            if (*p != ',')
+                return NULL;
+            p = jsonSkipSpace(p + 1);
+        }
+    }
+    // Number, true, false or null
+    const char *start = p;
+    while (*p && !strchr(",]} \t\r\n", *p))
+        p++;
+    return p == start ? NULL : p;
+}
+
+static const char *jsonCamera(const char *p, CameraPose *pose) {
+    p = jsonSkipSpace(p);
+    if (*p != '{')
+        return NULL;
+    p = jsonSkipSpace(p + 1);
+    double position[3] = {0.0, 0.0, 0.0};
+    double rotation[9] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+    double width = 0.0, height = 0.0, fx = 0.0, fy = 0.0;
+    while (*p != '}') {
+        char key[64];
+        p = jsonString(p, key, sizeof(key));
+        if (!p)
+            return NULL;
+        p = jsonSkipSpace(p);
+        if (*p != ':')
+            return NULL;
+        p++;
+        uint32_t read = 0;
+        if (!strcmp(key, "img_name"))
+            p = jsonString(p, pose->name, sizeof(pose->name));
+        else if (!strcmp(key, "width"))
+            p = jsonNumber(p, &width);
+        else if (!strcmp(key, "height"))
+            p = jsonNumber(p, &height);
+        else if (!strcmp(key, "fx"))
+            p = jsonNumber(p, &fx);
+        else if (!strcmp(key, "fy"))
+            p = jsonNumber(p, &fy);
+        else if (!strcmp(key, "position"))
+            p = jsonNumbers(p, position, 3, &read);
+        else if (!strcmp(key, "rotation"))
+            p = jsonNumbers(p, rotation, 9, &read);
+        else
+            p = jsonSkipValue(p);
+        if (!p)
+            return NULL;
+        p = jsonSkipSpace(p);
+        if (*p == ',')
+            p = jsonSkipSpace(p + 1);
+        else if (*p != '}')
+            return NULL;
+    }
+    if (width < 1.0 || height < 1.0 || fx <= 0.0 || fy <= 0.0)
+        return NULL;
+
+    pose->width = (uint32_t) width;
+    pose->height = (uint32_t) height;
+    pose->fx = (float) fx;
+    pose->fy = (float) fy;
+    pose->cx = (float) (width * 0.5);
+    pose->cy = (float) (height * 0.5);
+    // rotation is camera to world (rows), position the camera center:
+    // R = rotation^T, t = -R * position
+    for (int r = 0; r < 3; r++) {
+        double t = 0.0;
+        for (int c = 0; c < 3; c++) {
+            pose->rotation[r][c] = (float) rotation[c * 3 + r];
+            t -= rotation[c * 3 + r] * position[c];
+        }
+        pose->translation[r] = (float) t;
+    }
+    return p + 1;
+}
+
+bool cameraPosesLoadJson(CameraPoses *poses, const char *path) {
+    char *text = (char *) readFile(path);
+    if (!text) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        return false;
+    }
+    const char *p = jsonSkipSpace(text);
+    bool ok = *p == '[';
+    if (ok) {
+        p = jsonSkipSpace(p + 1);
+        while (ok && *p != ']') {
+            CameraPose *pose = appendPose(poses);
+            p = pose ? jsonCamera(p, pose) : NULL;
+            if (!p) {
+                ok = false;
+                break;
+            }
+            if (!pose->name[0])
+                snprintf(pose->name, sizeof(pose->name), "%05u", poses->count - 1);
+            p = jsonSkipSpace(p);
+            if (*p == ',')
+                p = jsonSkipSpace(p + 1);
+            else if (*p != ']')
+                ok = false;
+        }
+    }
+    if (!ok)
+        fprintf(stderr, "Invalid camera %u in %s\n", poses->count, path);
+    free(text);
+    return ok;
+}
+
+bool cameraPosesLoad(CameraPoses *poses, const char *path) {
+    size_t len = strlen(path);
+    if (len >= 5 && !strcmp(path + len - 5, ".json"))
+        return cameraPosesLoadJson(poses, path);
+
+    char camerasPath[1024];
+    const char *slash = strrchr(path, '/');
+    int dirLen = slash ? (int) (slash - path + 1) : 0;
+    snprintf(camerasPath, sizeof(camerasPath), "%.*scameras.txt", dirLen, path);
+    return cameraPosesLoadColmap(poses, path, camerasPath);
+}
+
+void cameraPosesFree(CameraPoses *poses) {
+    free(poses->poses);
+    memset(poses, 0, sizeof(*poses));
+}
+
+void cameraPoseMatrices(const CameraPose *pose, float near, float far, mat4 view, mat4 proj, vec3 position) {
+    // Flipping y and z turns the COLMAP camera into one looking down -z with y up
+    glm_mat4_identity(view);
+    for (int r = 0; r < 3; r++) {
+        float sign = r == 0 ? 1.0f : -1.0f;
+        for (int c = 0; c < 3; c++)
+            view[c][r] = sign * pose->rotation[r][c];
+        view[3][r] = sign * pose->translation[r];
+    }
+    // Center = -R^T t
+    for (int c = 0; c < 3; c++) {
+        position[c] = 0.0f;
+        for (int r = 0; r < 3; r++)
+            position[c] -= pose->rotation[r][c] * pose->translation[r];
+    }
+    // The principal point may be off center, the image is the near plane window it
+    // maps to. Row 0 is the top of the image.
+    float left = -pose->cx / pose->fx * near;
+    float right = ((float) pose->width - pose->cx) / pose->fx * near;
+    float top = pose->cy / pose->fy * near;
+    float bottom = -((float) pose->height - pose->cy) / pose->fy * near;
+    glm_frustum(left, right, bottom, top, near, far, proj);
+}
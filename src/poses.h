@@ -0,0 +1,42 @@
+#ifndef POSES_H
+#define POSES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// Camera to render a view from, in the COLMAP convention: pinhole intrinsics in pixels
+// and the world to camera transform of a camera looking down +z with y down
+typedef struct CameraPose {
+    char name[256];
+    uint32_t width;
+    uint32_t height;
+    float fx, fy;
+    float cx, cy;
+    // rotation[row][col]
+    float rotation[3][3];
+    float translation[3];
+} CameraPose;
+
+typedef struct CameraPoses {
+    CameraPose *poses;
+    uint32_t count;
+    uint32_t capacity;
+} CameraPoses;
+
+// COLMAP text model: images.txt, with the intrinsics of its cameras from cameras.txt.
+// Distortion parameters are ignored.
+bool cameraPosesLoadColmap(CameraPoses *poses, const char *imagesPath, const char *camerasPath);
+// cameras.json as written by 3DGS training, an array of
+// {"img_name", "width", "height", "position", "rotation" (camera to world), "fx", "fy"}
+bool cameraPosesLoadJson(CameraPoses *poses, const char *path);
+// .json, otherwise images.txt with cameras.txt in the same directory
+bool cameraPosesLoad(CameraPoses *poses, const char *path);
+void cameraPosesFree(CameraPoses *poses);
+
+// View (looking down -z, like glm_lookat) and projection of the pose, and the camera
+// position in world space
+void cameraPoseMatrices(const CameraPose *pose, float near, float far, mat4 view, mat4 proj, vec3 position);
+
+#endif //POSES_H
@@ -0,0 +1,107 @@
+#ifndef SHADER_TYPES_H
+#define SHADER_TYPES_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// Buffers the splat shaders (compute.wgsl, render.wgsl) share with the C side
+
+typedef struct Uniform {
+    mat4 viewProj;
+    float scale;
+    uint32_t cull;
+    uint32_t resortThreshold;
+    // For projecting the splat covariances
+    alignas(16) mat4 view;
+    vec2 focal;
+    vec2 viewport;
+    // The sorts order nearest first, see depth_key in compute.wgsl
+    uint32_t frontToBack;
+    // Spherical harmonics in shBuffer (0 = none), see sh_color in compute.wgsl
+    uint32_t shDegree;
+    uint32_t shStride;
+    alignas(16) vec3 cameraPos;
+} Uniform;
+_Static_assert(offsetof(Uniform, cull) == 68, "");
+_Static_assert(offsetof(Uniform, resortThreshold) == 72, "");
+_Static_assert(offsetof(Uniform, view) == 80, "");
+_Static_assert(offsetof(Uniform, focal) == 144, "");
+_Static_assert(offsetof(Uniform, viewport) == 152, "");
+_Static_assert(offsetof(Uniform, frontToBack) == 160, "");
+_Static_assert(offsetof(Uniform, shDegree) == 164, "");
+_Static_assert(offsetof(Uniform, shStride) == 168, "");
+_Static_assert(offsetof(Uniform, cameraPos) == 176, "");
+_Static_assert(sizeof(Uniform) == 192, "");
+
+typedef struct SortUniform {
+    alignas(16) uint32_t comparePattern;
+    uint32_t nextPattern;
+    uint32_t blockOffset;
+} SortUniform;
+// NOTE: WGPU requires uniforms to be 16 bytes
+_Static_assert(sizeof(SortUniform) == 16, "");
+_Static_assert(offsetof(SortUniform, comparePattern) == 0, "");
+_Static_assert(offsetof(SortUniform, nextPattern) == 4, "");
+_Static_assert(offsetof(SortUniform, blockOffset) == 8, "");
+
+// Must match SORT_BLOCK in compute.wgsl
+#define BITONIC_BLOCK 2048
+// minUniformBufferOffsetAlignment
+#define SORT_UNIFORM_STRIDE 256
+
+// What vs_main reads of a splat (must match RenderRecord in precision-f32.wgsl)
+typedef struct RenderRecord {
+    float axes[4];
+    float center[2];
+    float extent;
+    uint32_t color;
+} RenderRecord;
+_Static_assert(sizeof(RenderRecord) == 32, "");
+
+// Same with shader-f16 (must match RenderRecord in precision-f16.wgsl)
+typedef struct RenderRecordHalf {
+    float center[2];
+    uint16_t axes[4];
+    uint16_t extent;
+    uint32_t color;
+} RenderRecordHalf;
+_Static_assert(sizeof(RenderRecordHalf) == 24, "");
+
+// Arguments cull_finalize_main writes to indirectBuffer, in u32s (must match compute.wgsl)
+#define INDIRECT_DRAW 0
+#define INDIRECT_RADIX_BLOCKS 4
+#define INDIRECT_SORT_BLOCKS 7
+#define INDIRECT_SORT_GROUPS 10
+// Written by incremental_decide_main
+#define INDIRECT_REPAIR_BLOCKS 13
+#define INDIRECT_REPAIR_SHIFTED_BLOCKS 16
+#define INDIRECT_STATS 19
+// DRAW_BATCHES draws of 4 u32s, the visible splats split into equal batches
+#define INDIRECT_BATCHES 21
+// The DrawBatch of every batch, DRAW_BATCH_STRIDE apart. The render bind groups bind
+// them as their uniform, so the buffer needs Uniform usage as well.
+#define INDIRECT_DRAW_BATCHES 64
+#define INDIRECT_COUNT (INDIRECT_DRAW_BATCHES + DRAW_BATCHES * DRAW_BATCH_STRIDE / 4)
+
+// Front to back the draw is split into this many batches, the pixels that saturated
+// are masked in the stencil before every batch after the first
+#define DRAW_BATCHES 8
+
+// First instance of a batch (vertex shaders add it to the instance index, the
+// firstInstance of indirect draws needs indirect-first-instance). Written by
+// cull_finalize_main, slot 0 always starts at 0.
+typedef struct DrawBatch {
+    alignas(16) uint32_t base;
+} DrawBatch;
+_Static_assert(sizeof(DrawBatch) == 16, "");
+// minUniformBufferOffsetAlignment
+#define DRAW_BATCH_STRIDE 256
+
+// u32s in sortCountersBuffer: the visible count (what the sorts read), then the
+// inversions of rekey_main. Must match Counters in compute.wgsl.
+#define SORT_COUNTER_COUNT 2
+
+#endif //SHADER_TYPES_H
@@ -0,0 +1,83 @@
+#include "sort-schedule.h"
+
+static void viewDirection(const ArcballCamera *camera, vec3 dir) {
+    glm_vec3_sub((float *) camera->center, (float *) camera->pos, dir);
+    glm_vec3_normalize(dir);
+}
+
+void sortScheduleInit(SortSchedule *schedule, SortScheduleConfig config) {
+    *schedule = (SortSchedule) {
+        .config = config,
+        .decision = SORT_SKIP,
+        .reason = "not sorted yet",
+    };
+}
+
+void sortScheduleInvalidate(SortSchedule *schedule) {
+    schedule->force = true;
+}
+
+static SortDecision decide(SortSchedule *schedule, bool cameraMoved, double now) {
+    const SortScheduleConfig *config = &schedule->config;
+    if (schedule->force || !schedule->hasSorted) {
+        schedule->reason = "forced";
+        return SORT_EXACT;
+    }
+    if (!config->enabled) {
+        schedule->reason = cameraMoved ? "camera moved" : "up to date";
+        return cameraMoved ? SORT_MOVING : SORT_SKIP;
+    }
+    if (cameraMoved) {
+        schedule->pending = true;
+        if (schedule->angle <= config->maxAngle && schedule->move <= config->maxMove) {
+            schedule->reason = "below threshold";
+            return SORT_SKIP;
+        }
+        if (config->maxRate > 0.0f && now - schedule->lastSort < 1.0 / config->maxRate) {
+            schedule->reason = "rate limited";
+            return SORT_SKIP;
+        }
+        schedule->reason = "view changed";
+        return SORT_MOVING;
+    }
+    if (schedule->pending) {
+        schedule->reason = "camera stopped";
+        return SORT_EXACT;
+    }
+    schedule->reason = "up to date";
+    return SORT_SKIP;
+}
+
+SortDecision sortScheduleUpdate(SortSchedule *schedule, const ArcballCamera *camera, bool cameraMoved, double now) {
+    vec3 dir;
+    viewDirection(camera, dir);
+    if (schedule->hasSorted) {
+        float cosAngle = glm_clamp(glm_vec3_dot(dir, schedule->sortedDir), -1.0f, 1.0f);
+        schedule->angle = glm_deg(acosf(cosAngle));
+        schedule->move = glm_vec3_distance((float *) camera->pos, schedule->sortedPos) / glm_max(camera->distance, 1e-3f);
+    }
+
+    SortDecision decision = decide(schedule, cameraMoved, now);
+    schedule->decision = decision;
+    if (decision == SORT_SKIP) {
+        schedule->skips++;
+    } else {
+        glm_vec3_copy((float *) camera->pos, schedule->sortedPos);
+        glm_vec3_copy(dir, schedule->sortedDir);
+        schedule->hasSorted = true;
+        schedule->lastSort = now;
+        schedule->sorts++;
+        schedule->windowSorts++;
+        if (decision == SORT_EXACT) {
+            schedule->pending = false;
+            schedule->force = false;
+        }
+    }
+
+    if (now - schedule->windowStart >= 1.0) {
+        schedule->rate = (float) (schedule->windowSorts / (now - schedule->windowStart));
+        schedule->windowStart = now;
+        schedule->windowSorts = 0;
+    }
+    return decision;
+}
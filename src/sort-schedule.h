@@ -0,0 +1,71 @@
+#ifndef SORT_SCHEDULE_H
+#define SORT_SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "camera.h"
+
+typedef enum SortDecision {
+    // Keep the last order. Only the sort is skipped, the splats are still projected
+    // for the current view.
+    SORT_SKIP,
+    // Sort with the configured (possibly reduced) precision while the camera moves
+    SORT_MOVING,
+    // Full precision sort, once the camera stops or when forced
+    SORT_EXACT,
+} SortDecision;
+
+typedef struct SortScheduleConfig {
+    // When disabled every camera update sorts, like before
+    bool enabled;
+    // View direction change (degrees) since the last sort that triggers a new one
+    float maxAngle;
+    // Camera movement since the last sort, relative to the orbit distance
+    float maxMove;
+    // Upper bound of sorts per second while moving
+    float maxRate;
+} SortScheduleConfig;
+
+static const SortScheduleConfig SORT_SCHEDULE_CONFIG_DEFAULT = {
+    .enabled = true,
+    .maxAngle = 2.0f,
+    .maxMove = 0.02f,
+    .maxRate = 20.0f,
+};
+
+typedef struct SortSchedule {
+    SortScheduleConfig config;
+
+    // View of the last sort
+    bool hasSorted;
+    vec3 sortedPos;
+    vec3 sortedDir;
+    double lastSort;
+    // The current order is approximate or for an older view
+    bool pending;
+    bool force;
+
+    // Last decision and why, for the perf panel
+    SortDecision decision;
+    const char *reason;
+    float angle;
+    float move;
+    uint64_t sorts;
+    uint64_t skips;
+    // Sorts per second, measured over one second windows
+    float rate;
+    double windowStart;
+    uint32_t windowSorts;
+} SortSchedule;
+
+void sortScheduleInit(SortSchedule *schedule, SortScheduleConfig config);
+
+// Decides whether this frame sorts. cameraMoved is whether the view changed since the
+// last frame, now is in seconds.
+SortDecision sortScheduleUpdate(SortSchedule *schedule, const ArcballCamera *camera, bool cameraMoved, double now);
+
+// Next update sorts exactly, e.g. after the scene or the sort method changed
+void sortScheduleInvalidate(SortSchedule *schedule);
+
+#endif //SORT_SCHEDULE_H
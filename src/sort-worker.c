@@ -0,0 +1,185 @@
+#include "sort-worker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SORT_WORKER_FRESH 4u
+
+static double nowSec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Sorts for the given request into the back slot and publishes it
+static void runRequest(SortWorker *worker, mat4 viewProj, uint64_t frame, CpuSortConfig config) {
+    double start = nowSec();
+    worker->sort.config = config;
+    cpuSortRun(&worker->sort, worker->posX, worker->posY, worker->posZ, viewProj);
+
+    SortResult *result = &worker->results[worker->back];
+    memcpy(result->order, cpuSortOrder(&worker->sort), worker->count * sizeof(uint32_t));
+    // Every result takes the changes since the last one, even if that one is never acquired
+    memset(result->dirty, 0, worker->sort.blockCount);
+    uint32_t cursor = 0, begin, end;
+    while (cpuSortNextDirtyRange(&worker->sort, &cursor, &begin, &end)) {
+        uint32_t blocks = (end - begin + CPU_SORT_UPLOAD_BLOCK - 1) / CPU_SORT_UPLOAD_BLOCK;
+        memset(result->dirty + begin / CPU_SORT_UPLOAD_BLOCK, 1, blocks);
+    }
+    result->seq = ++worker->published;
+    result->frame = frame;
+    result->kind = worker->sort.kind;
+    result->reason = worker->sort.reason;
+    result->moves = worker->sort.moves;
+    result->time = nowSec() - start;
+
+    uint32_t old = atomic_exchange(&worker->shared, worker->back | SORT_WORKER_FRESH);
+    worker->back = old & ~SORT_WORKER_FRESH;
+}
+
+#ifndef SORT_WORKER_SYNC
+
+static void *workerMain(void *arg) {
+    SortWorker *worker = arg;
+    pthread_mutex_lock(&worker->lock);
+    for (;;) {
+        while (!worker->quit && !worker->pending)
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        if (worker->quit)
+            break;
+        mat4 viewProj;
+        glm_mat4_copy(worker->viewProj, viewProj);
+        uint64_t frame = worker->frame;
+        CpuSortConfig config = worker->config;
+        worker->pending = false;
+        worker->busy = true;
+        pthread_mutex_unlock(&worker->lock);
+
+        runRequest(worker, viewProj, frame, config);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->busy = false;
+        pthread_cond_broadcast(&worker->idle);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+#endif
+
+void sortWorkerInit(SortWorker *worker, const float *posX, const float *posY, const float *posZ, uint32_t count) {
+    sortWorkerFree(worker);
+    worker->posX = posX;
+    worker->posY = posY;
+    worker->posZ = posZ;
+    worker->count = count;
+    cpuSortInit(&worker->sort, count);
+    for (uint32_t i = 0; i < 3; i++) {
+        worker->results[i].order = malloc((count ? count : 1) * sizeof(uint32_t));
+        worker->results[i].dirty = calloc(worker->sort.blockCount ? worker->sort.blockCount : 1, 1);
+    }
+    worker->published = 0;
+    worker->front = 0;
+    worker->back = 1;
+    atomic_store(&worker->shared, 2);
+    worker->hasFront = false;
+    worker->pending = false;
+    worker->initialized = true;
+
+#ifndef SORT_WORKER_SYNC
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+    worker->quit = false;
+    worker->busy = false;
+    worker->running = pthread_create(&worker->thread, NULL, workerMain, worker) == 0;
+    if (!worker->running)
+        fprintf(stderr, "Failed to start the sort thread, sorting synchronously\n");
+#endif
+}
+
+void sortWorkerFree(SortWorker *worker) {
+#ifndef SORT_WORKER_SYNC
+    if (worker->running) {
+        pthread_mutex_lock(&worker->lock);
+        worker->quit = true;
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+        pthread_join(worker->thread, NULL);
+        worker->running = false;
+    }
+    if (worker->initialized) {
+        pthread_mutex_destroy(&worker->lock);
+        pthread_cond_destroy(&worker->wake);
+        pthread_cond_destroy(&worker->idle);
+    }
+#endif
+    cpuSortFree(&worker->sort);
+    for (uint32_t i = 0; i < 3; i++) {
+        free(worker->results[i].order);
+        free(worker->results[i].dirty);
+        worker->results[i].order = NULL;
+        worker->results[i].dirty = NULL;
+    }
+    worker->hasFront = false;
+    worker->initialized = false;
+}
+
+void sortWorkerRequest(SortWorker *worker, mat4 viewProj, uint64_t frame, CpuSortConfig config) {
+#ifndef SORT_WORKER_SYNC
+    if (worker->running) {
+        pthread_mutex_lock(&worker->lock);
+        glm_mat4_copy(viewProj, worker->viewProj);
+        worker->frame = frame;
+        worker->config = config;
+        worker->pending = true;
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+        return;
+    }
+#endif
+    runRequest(worker, viewProj, frame, config);
+}
+
+const SortResult *sortWorkerAcquire(SortWorker *worker) {
+    if (!(atomic_load(&worker->shared) & SORT_WORKER_FRESH))
+        return NULL;
+    uint32_t old = atomic_exchange(&worker->shared, worker->front);
+    worker->front = old & ~SORT_WORKER_FRESH;
+    worker->hasFront = true;
+    return &worker->results[worker->front];
+}
+
+bool sortWorkerNextDirtyRange(const SortWorker *worker, const SortResult *result, uint32_t *cursor, uint32_t *begin,
+                              uint32_t *end) {
+    uint32_t blockCount = worker->sort.blockCount;
+    uint32_t b = *cursor;
+    while (b < blockCount && !result->dirty[b])
+        b++;
+    if (b >= blockCount) {
+        *cursor = b;
+        return false;
+    }
+    uint32_t first = b;
+    while (b < blockCount && result->dirty[b])
+        b++;
+    *cursor = b;
+    *begin = first * CPU_SORT_UPLOAD_BLOCK;
+    *end = glm_min(b * CPU_SORT_UPLOAD_BLOCK, worker->count);
+    return true;
+}
+
+void sortWorkerWaitIdle(SortWorker *worker) {
+#ifndef SORT_WORKER_SYNC
+    if (!worker->running)
+        return;
+    pthread_mutex_lock(&worker->lock);
+    while (worker->pending || worker->busy)
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    pthread_mutex_unlock(&worker->lock);
+#else
+    (void) worker;
+#endif
+}
@@ -0,0 +1,94 @@
+#ifndef SORT_WORKER_H
+#define SORT_WORKER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "cpu-sort.h"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define SORT_WORKER_SYNC
+#else
+#include <pthread.h>
+#endif
+
+typedef struct SortResult {
+    uint32_t *order;
+    // Frame whose viewProj was sorted for
+    uint64_t frame;
+    // Counts the published results, consecutive ones differ by 1
+    uint64_t seq;
+    // The CPU_SORT_UPLOAD_BLOCK blocks of order that changed since the result before it
+    uint8_t *dirty;
+    CpuSortKind kind;
+    const char *reason;
+    uint64_t moves;
+    double time;
+} SortResult;
+
+// Sorts on a dedicated thread, the render loop keeps drawing the last finished
+// order. Results go through a lock-free triple buffer: the worker fills its back
+// slot and swaps it with the shared one, the render thread swaps the shared slot
+// with its front one whenever a newer result is there.
+typedef struct SortWorker {
+    bool initialized;
+    // Only touched by the render thread while the worker is idle (sortWorkerWaitIdle)
+    CpuSort sort;
+    const float *posX;
+    const float *posY;
+    const float *posZ;
+    uint32_t count;
+
+    SortResult results[3];
+    // Index of the shared slot | SORT_WORKER_FRESH
+    atomic_uint shared;
+    uint32_t back;
+    uint32_t front;
+    bool hasFront;
+    // Written by the worker only
+    uint64_t published;
+
+#ifndef SORT_WORKER_SYNC
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    bool running;
+    bool quit;
+    bool busy;
+#endif
+    // Latest request, newer requests overwrite older ones that have not started yet
+    bool pending;
+    mat4 viewProj;
+    uint64_t frame;
+    CpuSortConfig config;
+} SortWorker;
+
+// Positions must stay valid until sortWorkerFree
+void sortWorkerInit(SortWorker *worker, const float *posX, const float *posY, const float *posZ, uint32_t count);
+void sortWorkerFree(SortWorker *worker);
+
+// Never blocks. Without thread support the sort runs right away.
+void sortWorkerRequest(SortWorker *worker, mat4 viewProj, uint64_t frame, CpuSortConfig config);
+
+// Returns a result newer than the last acquired one, or NULL
+const SortResult *sortWorkerAcquire(SortWorker *worker);
+
+// Last acquired result, or NULL
+static inline const SortResult *sortWorkerFront(const SortWorker *worker) {
+    return worker->hasFront ? &worker->results[worker->front] : NULL;
+}
+
+// Iterates the dirty ranges of an acquired result, like cpuSortNextDirtyRange. They
+// only cover the changes since the result with seq - 1, after skipped results the
+// whole order has to be uploaded.
+bool sortWorkerNextDirtyRange(const SortWorker *worker, const SortResult *result, uint32_t *cursor, uint32_t *begin,
+                              uint32_t *end);
+
+// Blocks until all requests are done, after which worker->sort may be used directly
+void sortWorkerWaitIdle(SortWorker *worker);
+
+#endif //SORT_WORKER_H
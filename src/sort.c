@@ -0,0 +1,165 @@
+#include "sort.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "threads.h"
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
+#define RADIX_MIN_CHUNK (32 * 1024)
+
+void radixSorterInit(RadixSorter *sorter, uint32_t capacity) {
+    radixSorterFree(sorter);
+    size_t n = capacity ? capacity : 1;
+    sorter->capacity = capacity;
+    sorter->keys = malloc(n * sizeof(uint32_t));
+    sorter->values = malloc(n * sizeof(uint32_t));
+    sorter->tmpKeys = malloc(n * sizeof(uint32_t));
+    sorter->tmpValues = malloc(n * sizeof(uint32_t));
+    sorter->histograms = malloc(threadsCount() * RADIX_SIZE * sizeof(uint32_t));
+}
+
+void radixSorterFree(RadixSorter *sorter) {
+    free(sorter->keys);
+    free(sorter->values);
+    free(sorter->tmpKeys);
+    free(sorter->tmpValues);
+    free(sorter->histograms);
+    *sorter = (RadixSorter) {0};
+}
+
+typedef struct RadixJob {
+    RadixSorter *sorter;
+    uint32_t (*minMax)[2];
+    uint32_t base;
+    uint32_t shift;
+    float quantizeMin;
+    float quantizeScale;
+} RadixJob;
+
+static void minMaxChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    RadixJob *job = userData;
+    const uint32_t *keys = job->sorter->keys;
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t k = keys[i];
+        lo = k < lo ? k : lo;
+        hi = k > hi ? k : hi;
+    }
+    job->minMax[chunk][0] = lo;
+    job->minMax[chunk][1] = hi;
+}
+
+static void quantizeChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    (void) chunk;
+    RadixJob *job = userData;
+    uint32_t *keys = job->sorter->keys;
+    float min = job->quantizeMin, scale = job->quantizeScale;
+    for (uint32_t i = begin; i < end; i++) {
+        keys[i] = (uint32_t) ((floatFromSortKey(keys[i]) - min) * scale);
+    }
+}
+
+static void histogramChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    RadixJob *job = userData;
+    const uint32_t *keys = job->sorter->keys;
+    uint32_t *hist = job->sorter->histograms + chunk * RADIX_SIZE;
+    uint32_t base = job->base, shift = job->shift;
+
+    memset(hist, 0, RADIX_SIZE * sizeof(*hist));
+    for (uint32_t i = begin; i < end; i++) {
+        hist[((keys[i] - base) >> shift) & RADIX_MASK]++;
+    }
+}
+
+static void scatterChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    RadixJob *job = userData;
+    RadixSorter *s = job->sorter;
+    const uint32_t *keys = s->keys;
+    const uint32_t *values = s->values;
+    uint32_t *outKeys = s->tmpKeys;
+    uint32_t *outValues = s->tmpValues;
+    uint32_t *offsets = s->histograms + chunk * RADIX_SIZE;
+    uint32_t base = job->base, shift = job->shift;
+
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t k = keys[i];
+        uint32_t dst = offsets[((k - base) >> shift) & RADIX_MASK]++;
+        outKeys[dst] = k;
+        outValues[dst] = values[i];
+    }
+}
+
+void radixSort(RadixSorter *sorter, uint32_t count, uint32_t keyBits) {
+    sorter->passes = 0;
+    if (count < 2)
+        return;
+
+    // Histograms are per chunk, chunking is identical for every parallelFor below
+    uint32_t chunks = parallelChunks(count, RADIX_MIN_CHUNK);
+    uint32_t minMax[chunks][2];
+
+    RadixJob job = {
+        .sorter = sorter,
+        .minMax = minMax,
+    };
+    parallelFor(count, RADIX_MIN_CHUNK, minMaxChunk, &job);
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint32_t c = 0; c < chunks; c++) {
+        lo = minMax[c][0] < lo ? minMax[c][0] : lo;
+        hi = minMax[c][1] > hi ? minMax[c][1] : hi;
+    }
+    if (lo == hi)
+        return;
+
+    if (keyBits < 32) {
+        float min = floatFromSortKey(lo);
+        float max = floatFromSortKey(hi);
+        uint32_t levels = (1u << keyBits) - 1;
+        job.quantizeMin = min;
+        job.quantizeScale = max > min ? levels / (max - min) : 0.0f;
+        parallelFor(count, RADIX_MIN_CHUNK, quantizeChunk, &job);
+        lo = 0;
+        hi = levels;
+    }
+
+    // Sort only on the significant bits of (key - lo)
+    uint32_t rangeBits = 32 - __builtin_clz(hi - lo);
+    uint32_t sortBits = keyBits < rangeBits ? keyBits : rangeBits;
+    job.base = lo;
+
+    for (uint32_t bit = rangeBits - sortBits; bit < rangeBits; bit += RADIX_BITS) {
+        job.shift = bit;
+        parallelFor(count, RADIX_MIN_CHUNK, histogramChunk, &job);
+
+        // Exclusive scan over (digit, chunk) so every chunk scatters stably
+        uint32_t sum = 0;
+        bool trivial = false;
+        for (uint32_t d = 0; d < RADIX_SIZE; d++) {
+            uint32_t digitStart = sum;
+            for (uint32_t c = 0; c < chunks; c++) {
+                uint32_t *h = sorter->histograms + c * RADIX_SIZE + d;
+                uint32_t n = *h;
+                *h = sum;
+                sum += n;
+            }
+            if (sum - digitStart == count)
+                trivial = true;
+        }
+        // All keys share this digit, order is unchanged
+        if (trivial)
+            continue;
+
+        parallelFor(count, RADIX_MIN_CHUNK, scatterChunk, &job);
+
+        uint32_t *tmp = sorter->keys;
+        sorter->keys = sorter->tmpKeys;
+        sorter->tmpKeys = tmp;
+        tmp = sorter->values;
+        sorter->values = sorter->tmpValues;
+        sorter->tmpValues = tmp;
+        sorter->passes++;
+    }
+}
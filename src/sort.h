@@ -0,0 +1,51 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Maps a float to an integer with the same (unsigned) ordering
+static inline uint32_t sortKeyFromFloat(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint32_t mask = (bits & 0x80000000u) ? 0xffffffffu : 0x80000000u;
+    return bits ^ mask;
+}
+
+static inline float floatFromSortKey(uint32_t key) {
+    uint32_t mask = (key & 0x80000000u) ? 0x80000000u : 0xffffffffu;
+    uint32_t bits = key ^ mask;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Splats are drawn back to front, so ascending keys mean descending depth
+static inline uint32_t depthSortKey(float depth) {
+    return ~sortKeyFromFloat(depth);
+}
+
+typedef struct RadixSorter {
+    uint32_t capacity;
+    // Filled by the caller before radixSort, hold the sorted pairs afterwards
+    uint32_t *keys;
+    uint32_t *values;
+
+    uint32_t *tmpKeys;
+    uint32_t *tmpValues;
+    uint32_t *histograms;
+
+    // Stats of the last sort
+    uint32_t passes;
+} RadixSorter;
+
+void radixSorterInit(RadixSorter *sorter, uint32_t capacity);
+void radixSorterFree(RadixSorter *sorter);
+
+// Stable LSD radix sort of (keys, values) pairs by ascending key on all threads.
+// Keys must come from sortKeyFromFloat/depthSortKey. With keyBits < 32 the keys
+// are first quantized linearly over the range present (and left that way), so
+// keyBits = 16 needs at most 2 passes and 32 at most 4.
+void radixSort(RadixSorter *sorter, uint32_t count, uint32_t keyBits);
+
+#endif //SORT_H
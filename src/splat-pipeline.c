@@ -0,0 +1,182 @@
+#include "splat-pipeline.h"
+
+#include <string.h>
+
+#include "shader-types.h"
+
+static WGPUBindGroupLayoutEntry bufferLayoutEntry(uint32_t binding, WGPUShaderStageFlags visibility,
+                                                  WGPUBufferBindingType type, bool dynamicOffset) {
+    return (WGPUBindGroupLayoutEntry) {
+        .binding = binding,
+        .visibility = visibility,
+        .buffer.type = type,
+        .buffer.hasDynamicOffset = dynamicOffset,
+    };
+}
+
+static WGPUBindGroupEntry bufferEntry(uint32_t binding, WGPUBuffer buffer, uint64_t offset, uint64_t size) {
+    return (WGPUBindGroupEntry) {
+        .binding = binding,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+}
+
+void splatLayoutsInit(SplatLayouts *layouts, WGPUDevice device) {
+    splatLayoutsFree(layouts);
+
+    const WGPUShaderStageFlags compute = WGPUShaderStage_Compute;
+    layouts->computeBindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 8,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            bufferLayoutEntry(0, compute, WGPUBufferBindingType_Uniform, false),
+            bufferLayoutEntry(1, compute, WGPUBufferBindingType_Uniform, true),
+            bufferLayoutEntry(2, compute, WGPUBufferBindingType_ReadOnlyStorage, false),
+            bufferLayoutEntry(3, compute, WGPUBufferBindingType_Storage, false),
+            bufferLayoutEntry(4, compute, WGPUBufferBindingType_Storage, false),
+            bufferLayoutEntry(5, compute, WGPUBufferBindingType_Storage, false),
+            bufferLayoutEntry(6, compute, WGPUBufferBindingType_Storage, false),
+            bufferLayoutEntry(7, compute, WGPUBufferBindingType_ReadOnlyStorage, false),
+        },
+    });
+    layouts->cullBindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 1,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            bufferLayoutEntry(0, compute, WGPUBufferBindingType_Storage, false),
+        },
+    });
+    layouts->renderBindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 3,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            bufferLayoutEntry(0, WGPUShaderStage_Vertex, WGPUBufferBindingType_ReadOnlyStorage, false),
+            bufferLayoutEntry(1, WGPUShaderStage_Vertex, WGPUBufferBindingType_ReadOnlyStorage, false),
+            bufferLayoutEntry(2, WGPUShaderStage_Vertex, WGPUBufferBindingType_Uniform, true),
+        },
+    });
+
+    layouts->computeLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &layouts->computeBindLayout,
+        .label = "Compute Pipeline",
+    });
+    layouts->cullLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 2,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            layouts->computeBindLayout,
+            layouts->cullBindLayout,
+        },
+        .label = "Cull Pipeline",
+    });
+    layouts->renderLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &layouts->renderBindLayout,
+        .label = "Render Pipeline",
+    });
+}
+
+void splatLayoutsFree(SplatLayouts *layouts) {
+    if (layouts->renderLayout) wgpuPipelineLayoutRelease(layouts->renderLayout);
+    if (layouts->cullLayout) wgpuPipelineLayoutRelease(layouts->cullLayout);
+    if (layouts->computeLayout) wgpuPipelineLayoutRelease(layouts->computeLayout);
+    if (layouts->renderBindLayout) wgpuBindGroupLayoutRelease(layouts->renderBindLayout);
+    if (layouts->cullBindLayout) wgpuBindGroupLayoutRelease(layouts->cullBindLayout);
+    if (layouts->computeBindLayout) wgpuBindGroupLayoutRelease(layouts->computeBindLayout);
+    memset(layouts, 0, sizeof(*layouts));
+}
+
+WGPUBindGroup splatComputeBindGroup(WGPUDevice device, const SplatLayouts *layouts, const SplatBuffers *buffers) {
+    return wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = layouts->computeBindLayout,
+        .entryCount = 8,
+        .entries = (WGPUBindGroupEntry[]) {
+            bufferEntry(0, buffers->uniform, 0, sizeof(Uniform)),
+            bufferEntry(1, buffers->sortUniform, 0, sizeof(SortUniform)),
+            bufferEntry(2, buffers->splats, 0, wgpuBufferGetSize(buffers->splats)),
+            bufferEntry(3, buffers->records, 0, wgpuBufferGetSize(buffers->records)),
+            bufferEntry(4, buffers->sorted, 0, wgpuBufferGetSize(buffers->sorted)),
+            bufferEntry(5, buffers->keys, 0, wgpuBufferGetSize(buffers->keys)),
+            bufferEntry(6, buffers->counters, 0, SORT_COUNTER_COUNT * sizeof(uint32_t)),
+            bufferEntry(7, buffers->sh, 0, wgpuBufferGetSize(buffers->sh)),
+        },
+        .label = "Bind Group 0",
+    });
+}
+
+WGPUBindGroup splatCullBindGroup(WGPUDevice device, const SplatLayouts *layouts, WGPUBuffer indirect) {
+    return wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = layouts->cullBindLayout,
+        .entryCount = 1,
+        .entries = (WGPUBindGroupEntry[]) {
+            bufferEntry(0, indirect, 0, INDIRECT_COUNT * sizeof(uint32_t)),
+        },
+        .label = "Cull Bind Group",
+    });
+}
+
+WGPUBindGroup splatRenderBindGroup(WGPUDevice device, const SplatLayouts *layouts, WGPUBuffer records,
+                                   WGPUBuffer sorted, WGPUBuffer indirect, const char *label) {
+    return wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = layouts->renderBindLayout,
+        .entryCount = 3,
+        .entries = (WGPUBindGroupEntry[]) {
+            bufferEntry(0, records, 0, wgpuBufferGetSize(records)),
+            bufferEntry(1, sorted, 0, wgpuBufferGetSize(sorted)),
+            // Slot 0 of the DrawBatch slots cull_finalize_main writes, the draws offset it
+            bufferEntry(2, indirect, INDIRECT_DRAW_BATCHES * sizeof(uint32_t), sizeof(DrawBatch)),
+        },
+        .label = label,
+    });
+}
+
+WGPUComputePipeline splatComputePipeline(WGPUDevice device, WGPUPipelineLayout layout, WGPUShaderModule module,
+                                         const char *entryPoint) {
+    return wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor) {
+        .layout = layout,
+        .compute = {
+            .module = module,
+            .entryPoint = entryPoint,
+        },
+    });
+}
+
+WGPURenderPipeline splatRenderPipeline(WGPUDevice device, const SplatLayouts *layouts, WGPUShaderModule module,
+                                       const char *vertexEntryPoint, WGPUTextureFormat format, bool under,
+                                       const WGPUDepthStencilState *depthStencil) {
+    WGPUBlendComponent blend = under ? (WGPUBlendComponent) {
+        .operation = WGPUBlendOperation_Add,
+        .srcFactor = WGPUBlendFactor_OneMinusDstAlpha,
+        .dstFactor = WGPUBlendFactor_One,
+    } : (WGPUBlendComponent) {
+        .operation = WGPUBlendOperation_Add,
+        .srcFactor = WGPUBlendFactor_One,
+        .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+    };
+    return wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor) {
+        .layout = layouts->renderLayout,
+        .primitive.topology = WGPUPrimitiveTopology_TriangleStrip,
+        .primitive.stripIndexFormat = WGPUIndexFormat_Undefined,
+        .primitive.frontFace = WGPUFrontFace_CCW,
+        .primitive.cullMode = WGPUCullMode_None,
+        .vertex.module = module,
+        .vertex.bufferCount = 0,
+        .vertex.entryPoint = vertexEntryPoint,
+        .fragment = &(WGPUFragmentState) {
+            .module = module,
+            .entryPoint = "fs_main",
+            .targetCount = 1,
+            .targets = (WGPUColorTargetState[]) {
+                [0].format = format,
+                [0].writeMask = WGPUColorWriteMask_All,
+                [0].blend = &(WGPUBlendState) {
+                    .color = blend,
+                    .alpha = blend,
+                },
+            },
+        },
+        .depthStencil = depthStencil,
+        .multisample.count = 1,
+        .multisample.mask = ~0u,
+        .multisample.alphaToCoverageEnabled = false,
+    });
+}
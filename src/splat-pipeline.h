@@ -0,0 +1,58 @@
+#ifndef SPLAT_PIPELINE_H
+#define SPLAT_PIPELINE_H
+
+#include <stdbool.h>
+
+#include <webgpu/webgpu.h>
+
+// Layouts, pipelines and bind groups of the splat shaders (compute.wgsl, render.wgsl),
+// shared by the viewer (main.c) and the headless renderer (headless.c)
+
+typedef struct SplatLayouts {
+    // Group 0 of every compute entry point, see SplatBuffers
+    WGPUBindGroupLayout computeBindLayout;
+    // Group 1 of the entry points that write the indirect buffer. Separate group so it is
+    // never bound while it is dispatched from.
+    WGPUBindGroupLayout cullBindLayout;
+    // Group 0 of vs_main and vs_gathered_main: records, order and the DrawBatch
+    WGPUBindGroupLayout renderBindLayout;
+    WGPUPipelineLayout computeLayout;
+    WGPUPipelineLayout cullLayout;
+    WGPUPipelineLayout renderLayout;
+} SplatLayouts;
+
+void splatLayoutsInit(SplatLayouts *layouts, WGPUDevice device);
+void splatLayoutsFree(SplatLayouts *layouts);
+
+// What group 0 of the compute shaders binds
+typedef struct SplatBuffers {
+    // Uniform
+    WGPUBuffer uniform;
+    // SortUniform slots, SORT_UNIFORM_STRIDE apart (picked with the dynamic offset)
+    WGPUBuffer sortUniform;
+    WGPUBuffer splats;
+    WGPUBuffer records;
+    WGPUBuffer sorted;
+    WGPUBuffer keys;
+    // SORT_COUNTER_COUNT u32s
+    WGPUBuffer counters;
+    WGPUBuffer sh;
+} SplatBuffers;
+
+WGPUBindGroup splatComputeBindGroup(WGPUDevice device, const SplatLayouts *layouts, const SplatBuffers *buffers);
+// indirect holds INDIRECT_COUNT u32s
+WGPUBindGroup splatCullBindGroup(WGPUDevice device, const SplatLayouts *layouts, WGPUBuffer indirect);
+// Draws records in the order of sorted, the DrawBatch slots are read from indirect
+WGPUBindGroup splatRenderBindGroup(WGPUDevice device, const SplatLayouts *layouts, WGPUBuffer records,
+                                   WGPUBuffer sorted, WGPUBuffer indirect, const char *label);
+
+WGPUComputePipeline splatComputePipeline(WGPUDevice device, WGPUPipelineLayout layout, WGPUShaderModule module,
+                                         const char *entryPoint);
+// Quad pipeline with the given vertex shader (vs_main or vs_gathered_main). fs_main
+// outputs premultiplied color, which is blended over what the target holds (back to
+// front) or under it (front to back).
+WGPURenderPipeline splatRenderPipeline(WGPUDevice device, const SplatLayouts *layouts, WGPUShaderModule module,
+                                       const char *vertexEntryPoint, WGPUTextureFormat format, bool under,
+                                       const WGPUDepthStencilState *depthStencil);
+
+#endif //SPLAT_PIPELINE_H
@@ -0,0 +1,597 @@
+#include "splat.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SPLAT_USE_MMAP
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "threads.h"
+
+// Below this many records it is not worth waking up the pool
+#define REPACK_MIN_CHUNK (64 * 1024)
+
+typedef struct MappedFile {
+    const void *data;
+    size_t size;
+    bool mapped;
+} MappedFile;
+
+static bool mapFile(const char *path, MappedFile *file) {
+    *file = (MappedFile) {0};
+#ifdef SPLAT_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    file->size = st.st_size;
+    if (file->size > 0) {
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // Advice values are not flags, each takes its own call
+#ifdef MADV_SEQUENTIAL
+            madvise(data, file->size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+            madvise(data, file->size, MADV_WILLNEED);
+#endif
+            file->data = data;
+            file->mapped = true;
+            close(fd);
+            return true;
+        }
+    }
+    close(fd);
+#endif
+    // Fallback: read the whole file with a single fread
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    file->size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void *data = malloc(file->size ? file->size : 1);
+    if (!data || fread(data, 1, file->size, f) != file->size) {
+        free(data);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    file->data = data;
+    return true;
+}
+
+static void unmapFile(MappedFile *file) {
+#ifdef SPLAT_USE_MMAP
+    if (file->mapped) {
+        munmap((void *) file->data, file->size);
+        *file = (MappedFile) {0};
+        return;
+    }
+#endif
+    free((void *) file->data);
+    *file = (MappedFile) {0};
+}
+
+// IEEE 754 binary16, rounded to nearest even
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent == 0xffu)
+        return sign | 0x7c00u | (mantissa ? 0x200u : 0u);
+    int32_t e = (int32_t) exponent - 127 + 15;
+    if (e >= 31)
+        return sign | 0x7c00u;
+    if (e <= 0) {
+        if (e < -10)
+            return sign;
+        // Subnormal, the implicit 1 shifts into the mantissa
+        mantissa |= 0x800000u;
+        uint32_t shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = ((uint32_t) e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    // A carry into the exponent still rounds correctly (up to infinity)
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+        half++;
+    return sign | half;
+}
+
+typedef struct RepackJob {
+    const SplatRaw *raw;
+    Splat *splats;
+    float *posX, *posY, *posZ;
+    double (*partialSums)[3];
+} RepackJob;
+
+static void repackChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    RepackJob *job = userData;
+    const SplatRaw *raw = job->raw;
+    Splat *splats = job->splats;
+    float *posX = job->posX, *posY = job->posY, *posZ = job->posZ;
+
+#ifdef __SSE2__
+    // SplatRaw is two 16 byte lanes: [px py pz sx] [sy sz color rot]
+    // Splat is three: [px py pz 0] [sx sy sz color] [rot 0 0 0]
+    const __m128i posMask = _mm_set_epi32(0, -1, -1, -1);
+    __m128d sumXY = _mm_setzero_pd();
+    __m128d sumZ = _mm_setzero_pd();
+    for (uint32_t i = begin; i < end; i++) {
+        const __m128i *src = (const __m128i *) (raw + i);
+        __m128i a = _mm_loadu_si128(src + 0);
+        __m128i b = _mm_loadu_si128(src + 1);
+
+        __m128i *dst = (__m128i *) (splats + i);
+        _mm_storeu_si128(dst + 0, _mm_and_si128(a, posMask));
+        _mm_storeu_si128(dst + 1, _mm_or_si128(_mm_srli_si128(a, 12), _mm_slli_si128(b, 4)));
+        _mm_storeu_si128(dst + 2, _mm_srli_si128(b, 12));
+        posX[i] = raw[i].pos[0];
+        posY[i] = raw[i].pos[1];
+        posZ[i] = raw[i].pos[2];
+
+        __m128 pos = _mm_castsi128_ps(a);
+        sumXY = _mm_add_pd(sumXY, _mm_cvtps_pd(pos));
+        sumZ = _mm_add_sd(sumZ, _mm_cvtps_pd(_mm_movehl_ps(pos, pos)));
+    }
+    double xy[2];
+    _mm_storeu_pd(xy, sumXY);
+    job->partialSums[chunk][0] = xy[0];
+    job->partialSums[chunk][1] = xy[1];
+    job->partialSums[chunk][2] = _mm_cvtsd_f64(sumZ);
+#else
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = begin; i < end; i++) {
+        const SplatRaw *src = raw + i;
+        Splat *dst = splats + i;
+        memset(dst, 0, sizeof(*dst));
+        memcpy(dst->pos, src->pos, sizeof(dst->pos));
+        memcpy(dst->scale, src->scale, sizeof(dst->scale));
+        dst->color = src->color;
+        dst->rotation = src->rotation;
+        posX[i] = src->pos[0];
+        posY[i] = src->pos[1];
+        posZ[i] = src->pos[2];
+        sum[0] += src->pos[0];
+        sum[1] += src->pos[1];
+        sum[2] += src->pos[2];
+    }
+    memcpy(job->partialSums[chunk], sum, sizeof(sum));
+#endif
+}
+
+// Vertex properties of a 3DGS .ply, byte offsets into a vertex (-1 when missing)
+typedef struct PlyLayout {
+    size_t headerSize;
+    uint32_t count;
+    uint32_t stride;
+    int32_t pos[3];
+    int32_t dc[3];
+    int32_t opacity;
+    int32_t scale[3];
+    int32_t rot[4];
+    // f_rest_*, all of red first, then green, then blue
+    int32_t rest[3 * (SPLAT_SH_COEFFS - 1)];
+    uint32_t restCount;
+    uint32_t shDegree;
+} PlyLayout;
+
+#define SH_C0 0.28209479177387814f
+
+// Case insensitive, ext is lower case
+static bool hasExtension(const char *path, const char *ext) {
+    size_t pathLen = strlen(path);
+    size_t extLen = strlen(ext);
+    if (pathLen < extLen)
+        return false;
+    for (size_t i = 0; i < extLen; i++) {
+        if (tolower((unsigned char) path[pathLen - extLen + i]) != ext[i])
+            return false;
+    }
+    return true;
+}
+
+static uint32_t plyTypeSize(const char *type) {
+    if (!strcmp(type, "char") || !strcmp(type, "uchar") || !strcmp(type, "int8") || !strcmp(type, "uint8"))
+        return 1;
+    if (!strcmp(type, "short") || !strcmp(type, "ushort") || !strcmp(type, "int16") || !strcmp(type, "uint16"))
+        return 2;
+    if (!strcmp(type, "int") || !strcmp(type, "uint") || !strcmp(type, "float") || !strcmp(type, "int32") ||
+        !strcmp(type, "uint32") || !strcmp(type, "float32"))
+        return 4;
+    if (!strcmp(type, "double") || !strcmp(type, "float64"))
+        return 8;
+    return 0;
+}
+
+static bool parsePlyHeader(const MappedFile *file, PlyLayout *layout) {
+    // All offsets -1
+    memset(layout, 0xff, sizeof(*layout));
+    layout->headerSize = 0;
+    layout->count = 0;
+    layout->stride = 0;
+    layout->restCount = 0;
+    layout->shDegree = 0;
+
+    const char *text = file->data;
+    const char *end = text + file->size;
+    if (file->size < 4 || memcmp(text, "ply\n", 4) != 0)
+        return false;
+
+    // Only the vertex element is read, it has to come first
+    bool inVertex = false;
+    bool seenVertex = false;
+    const char *line = text;
+    while (line < end) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            return false;
+        char buf[256];
+        size_t len = eol - line;
+        if (len >= sizeof(buf))
+            return false;
+        memcpy(buf, line, len);
+        buf[len] = '\0';
+        if (len && buf[len - 1] == '\r')
+            buf[len - 1] = '\0';
+        line = eol + 1;
+
+        char word[64], type[64], name[64];
+        unsigned long count;
+        if (!strcmp(buf, "end_header")) {
+            layout->headerSize = line - text;
+            break;
+        }
+        if (!strncmp(buf, "format ", 7)) {
+            if (strcmp(buf, "format binary_little_endian 1.0") != 0)
+                return false;
+        } else if (sscanf(buf, "element %63s %lu", word, &count) == 2) {
+            inVertex = !strcmp(word, "vertex");
+            if (inVertex) {
+                if (seenVertex || count > UINT32_MAX)
+                    return false;
+                seenVertex = true;
+                layout->count = (uint32_t) count;
+            } else if (!seenVertex) {
+                return false;
+            }
+        } else if (sscanf(buf, "property %63s %63s", type, name) == 2) {
+            if (!inVertex)
+                continue;
+            uint32_t size = plyTypeSize(type);
+            if (!size)
+                return false;
+            int32_t offset = (int32_t) layout->stride;
+            layout->stride += size;
+            bool isFloat = !strcmp(type, "float") || !strcmp(type, "float32");
+            int32_t *slot = NULL;
+            int index;
+            if (name[0] && !name[1] && name[0] >= 'x' && name[0] <= 'z')
+                slot = &layout->pos[name[0] - 'x'];
+            else if (sscanf(name, "f_dc_%d", &index) == 1 && index >= 0 && index < 3)
+                slot = &layout->dc[index];
+            else if (sscanf(name, "scale_%d", &index) == 1 && index >= 0 && index < 3)
+                slot = &layout->scale[index];
+            else if (sscanf(name, "rot_%d", &index) == 1 && index >= 0 && index < 4)
+                slot = &layout->rot[index];
+            else if (!strcmp(name, "opacity"))
+                slot = &layout->opacity;
+            else if (sscanf(name, "f_rest_%d", &index) == 1 && index >= 0 && index < 3 * (SPLAT_SH_COEFFS - 1)) {
+                slot = &layout->rest[index];
+                layout->restCount++;
+            }
+            if (slot) {
+                if (!isFloat)
+                    return false;
+                *slot = offset;
+            }
+        }
+    }
+    if (!layout->headerSize || !seenVertex)
+        return false;
+
+    int32_t required[] = {
+        layout->pos[0], layout->pos[1], layout->pos[2],
+        layout->dc[0], layout->dc[1], layout->dc[2],
+        layout->opacity,
+        layout->scale[0], layout->scale[1], layout->scale[2],
+        layout->rot[0], layout->rot[1], layout->rot[2], layout->rot[3],
+    };
+    for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); i++) {
+        if (required[i] < 0)
+            return false;
+    }
+    // The highest degree whose coefficients all are there (f_dc_* is the first one)
+    uint32_t perChannel = layout->restCount / 3;
+    for (uint32_t i = 0; i < 3 * perChannel; i++) {
+        if (layout->rest[i] < 0)
+            return false;
+    }
+    while (layout->shDegree < SPLAT_SH_MAX_DEGREE && splatShCoeffs(layout->shDegree + 1) - 1 <= perChannel)
+        layout->shDegree++;
+
+    if (file->size - layout->headerSize < (size_t) layout->count * layout->stride)
+        return false;
+    return true;
+}
+
+static float plyFloat(const uint8_t *vertex, int32_t offset) {
+    float value;
+    memcpy(&value, vertex + offset, sizeof(value));
+    return value;
+}
+
+static uint8_t toUnorm8(float value) {
+    return (uint8_t) glm_clamp(value * 255.0f + 0.5f, 0.0f, 255.0f);
+}
+
+typedef struct PlyJob {
+    const uint8_t *vertices;
+    const PlyLayout *layout;
+    Splat *splats;
+    uint16_t *sh;
+    float *posX, *posY, *posZ;
+    double (*partialSums)[3];
+} PlyJob;
+
+// Same conversion as the .ply -> .splat tools: activated scale and opacity, the DC term
+// baked into the color, the rotation quantized. The SH get the DC color unclamped.
+static void plyChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    PlyJob *job = userData;
+    const PlyLayout *layout = job->layout;
+    uint32_t perChannel = layout->restCount / 3;
+    uint32_t coeffs = splatShCoeffs(layout->shDegree);
+
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = begin; i < end; i++) {
+        const uint8_t *vertex = job->vertices + (size_t) i * layout->stride;
+        Splat *dst = job->splats + i;
+        memset(dst, 0, sizeof(*dst));
+        for (int c = 0; c < 3; c++) {
+            dst->pos[c] = plyFloat(vertex, layout->pos[c]);
+            dst->scale[c] = expf(plyFloat(vertex, layout->scale[c]));
+        }
+
+        float dc[3];
+        uint8_t color[4];
+        for (int c = 0; c < 3; c++) {
+            dc[c] = 0.5f + SH_C0 * plyFloat(vertex, layout->dc[c]);
+            color[c] = toUnorm8(dc[c]);
+        }
+        color[3] = toUnorm8(1.0f / (1.0f + expf(-plyFloat(vertex, layout->opacity))));
+        memcpy(&dst->color, color, sizeof(color));
+
+        float q[4];
+        float length = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            q[c] = plyFloat(vertex, layout->rot[c]);
+            length += q[c] * q[c];
+        }
+        length = sqrtf(length);
+        uint8_t rotation[4];
+        for (int c = 0; c < 4; c++) {
+            float v = length > 0.0f ? q[c] / length : (c == 0 ? 1.0f : 0.0f);
+            rotation[c] = (uint8_t) glm_clamp(v * 128.0f + 128.0f, 0.0f, 255.0f);
+        }
+        memcpy(&dst->rotation, rotation, sizeof(rotation));
+
+        if (job->sh) {
+            uint16_t *sh = job->sh + (size_t) i * 3 * SPLAT_SH_COEFFS;
+            for (uint32_t c = 0; c < 3; c++)
+                sh[c] = floatToHalf(dc[c]);
+            for (uint32_t k = 1; k < SPLAT_SH_COEFFS; k++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    sh[k * 3 + c] = k < coeffs ? floatToHalf(plyFloat(vertex, layout->rest[c * perChannel + k - 1])) : 0;
+                }
+            }
+        }
+
+        job->posX[i] = dst->pos[0];
+        job->posY[i] = dst->pos[1];
+        job->posZ[i] = dst->pos[2];
+        sum[0] += dst->pos[0];
+        sum[1] += dst->pos[1];
+        sum[2] += dst->pos[2];
+    }
+    memcpy(job->partialSums[chunk], sum, sizeof(sum));
+}
+
+static double nowSec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+bool splatSceneLoad(SplatScene *scene, const char *path) {
+    double start = nowSec();
+
+    MappedFile file;
+    if (!mapFile(path, &file)) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        return false;
+    }
+    bool ply = hasExtension(path, ".ply");
+    PlyLayout layout;
+    uint32_t count;
+    if (ply) {
+        if (!parsePlyHeader(&file, &layout)) {
+            fprintf(stderr, "Unsupported PLY header in %s\n", path);
+            unmapFile(&file);
+            return false;
+        }
+        count = layout.count;
+    } else {
+        if (file.size % sizeof(SplatRaw) != 0) {
+            fprintf(stderr, "Invalid file length %zu for %s\n", file.size, path);
+            unmapFile(&file);
+            return false;
+        }
+        count = file.size / sizeof(SplatRaw);
+    }
+
+    Splat *splats = malloc((count ? count : 1) * sizeof(*splats));
+    float *positions = malloc((count ? count : 1) * 3 * sizeof(float));
+    uint16_t *sh = NULL;
+    bool hasSh = ply && layout.shDegree > 0;
+    if (hasSh)
+        sh = malloc((count ? count : 1) * 3 * SPLAT_SH_COEFFS * sizeof(uint16_t));
+    if (!splats || !positions || (hasSh && !sh)) {
+        fprintf(stderr, "Failed to allocate %u splats\n", count);
+        free(splats);
+        free(positions);
+        free(sh);
+        unmapFile(&file);
+        return false;
+    }
+
+    uint32_t chunks = parallelChunks(count, REPACK_MIN_CHUNK);
+    double partialSums[chunks ? chunks : 1][3];
+    float *posX = positions;
+    float *posY = positions + count;
+    float *posZ = positions + 2 * (size_t) count;
+    if (ply) {
+        PlyJob job = {
+            .vertices = (const uint8_t *) file.data + layout.headerSize,
+            .layout = &layout,
+            .splats = splats,
+            .sh = sh,
+            .posX = posX,
+            .posY = posY,
+            .posZ = posZ,
+            .partialSums = partialSums,
+        };
+        parallelFor(count, REPACK_MIN_CHUNK, plyChunk, &job);
+    } else {
+        RepackJob job = {
+            .raw = file.data,
+            .splats = splats,
+            .posX = posX,
+            .posY = posY,
+            .posZ = posZ,
+            .partialSums = partialSums,
+        };
+        parallelFor(count, REPACK_MIN_CHUNK, repackChunk, &job);
+    }
+
+    double center[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = 0; i < chunks; i++) {
+        center[0] += partialSums[i][0];
+        center[1] += partialSums[i][1];
+        center[2] += partialSums[i][2];
+    }
+    size_t fileSize = file.size;
+    unmapFile(&file);
+
+    splatSceneFree(scene);
+    scene->splats = splats;
+    scene->count = count;
+    scene->posX = posX;
+    scene->posY = posY;
+    scene->posZ = posZ;
+    scene->sh = sh;
+    scene->shDegree = hasSh ? layout.shDegree : 0;
+    for (int i = 0; i < 3; i++)
+        scene->center[i] = count ? (float) (center[i] / count) : 0.0f;
+    scene->fileSize = fileSize;
+    scene->loadTime = nowSec() - start;
+    return true;
+}
+
+void splatSceneFree(SplatScene *scene) {
+    free(scene->splats);
+    free(scene->posX);
+    free(scene->sh);
+    scene->splats = NULL;
+    scene->posX = scene->posY = scene->posZ = NULL;
+    scene->sh = NULL;
+    scene->shDegree = 0;
+    scene->count = 0;
+}
+
+typedef struct PackHalfJob {
+    const Splat *splats;
+    SplatHalf *out;
+} PackHalfJob;
+
+static void packHalfChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    (void) chunk;
+    PackHalfJob *job = userData;
+    for (uint32_t i = begin; i < end; i++) {
+        const Splat *src = job->splats + i;
+        SplatHalf *dst = job->out + i;
+        memcpy(dst->pos, src->pos, sizeof(dst->pos));
+        dst->color = src->color;
+        for (int c = 0; c < 3; c++)
+            dst->scale[c] = floatToHalf(src->scale[c]);
+        dst->scale[3] = 0;
+        dst->rotation = src->rotation;
+        dst->padding = 0;
+    }
+}
+
+void splatScenePackHalf(const SplatScene *scene, SplatHalf *out) {
+    PackHalfJob job = {
+        .splats = scene->splats,
+        .out = out,
+    };
+    parallelFor(scene->count, REPACK_MIN_CHUNK, packHalfChunk, &job);
+}
+
+typedef struct PackShJob {
+    const uint16_t *sh;
+    uint32_t degree;
+    uint32_t *out;
+} PackShJob;
+
+static void packShChunk(void *userData, uint32_t chunk, uint32_t begin, uint32_t end) {
+    (void) chunk;
+    PackShJob *job = userData;
+    uint32_t halves = 3 * splatShCoeffs(job->degree);
+    uint32_t stride = splatShStride(job->degree);
+    for (uint32_t i = begin; i < end; i++) {
+        const uint16_t *src = job->sh + (size_t) i * 3 * SPLAT_SH_COEFFS;
+        uint32_t *dst = job->out + (size_t) i * stride;
+        for (uint32_t w = 0; w < stride; w++) {
+            uint32_t lo = src[2 * w];
+            uint32_t hi = 2 * w + 1 < halves ? src[2 * w + 1] : 0;
+            dst[w] = lo | hi << 16;
+        }
+    }
+}
+
+void splatScenePackSh(const SplatScene *scene, uint32_t degree, uint32_t *out) {
+    if (degree > scene->shDegree)
+        degree = scene->shDegree;
+    if (!scene->sh || degree == 0)
+        return;
+    PackShJob job = {
+        .sh = scene->sh,
+        .degree = degree,
+        .out = out,
+    };
+    parallelFor(scene->count, REPACK_MIN_CHUNK, packShChunk, &job);
+}
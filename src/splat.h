@@ -0,0 +1,94 @@
+#ifndef SPLAT_H
+#define SPLAT_H
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// On-disk .splat record
+typedef struct SplatRaw {
+    float pos[3];
+    float scale[3];
+    uint32_t color;
+    uint32_t rotation;
+} SplatRaw;
+_Static_assert(sizeof(SplatRaw) == 12 + 12 + 4 + 4, "");
+
+// GPU layout (matches `Splat` in the shaders)
+typedef struct Splat {
+    alignas(16) float pos[3];
+    alignas(16) float scale[3];
+    alignas(4) uint32_t color;
+    alignas(4) uint32_t rotation;
+} Splat;
+_Static_assert(sizeof(Splat) == 48, "");
+
+// Half precision GPU layout, used with shader-f16 (matches `Splat` in
+// assets/precision-f16.wgsl). The position stays fp32.
+typedef struct SplatHalf {
+    float pos[3];
+    uint32_t color;
+    // binary16, the last one unused
+    uint16_t scale[4];
+    uint32_t rotation;
+    uint32_t padding;
+} SplatHalf;
+_Static_assert(sizeof(SplatHalf) == 32, "");
+
+// View dependent color: spherical harmonics of degree 1..3. At most this many rgb
+// coefficients per splat, the DC term first. Splat.color holds the DC term clamped,
+// which is all of the color at degree 0. With the higher bands only their sum is
+// clamped, so the DC term comes along unclamped.
+#define SPLAT_SH_MAX_DEGREE 3
+#define SPLAT_SH_COEFFS 16
+
+// rgb coefficients up to degree with the DC term, none at degree 0
+static inline uint32_t splatShCoeffs(uint32_t degree) {
+    return degree > 0 ? (degree + 1) * (degree + 1) : 0;
+}
+
+// u32s per splat of splatScenePackSh, two binary16 each (rgb of every coefficient in turn)
+static inline uint32_t splatShStride(uint32_t degree) {
+    return (3 * splatShCoeffs(degree) + 1) / 2;
+}
+
+typedef struct SplatScene {
+    Splat *splats;
+    uint32_t count;
+    vec3 center;
+
+    // Only .ply captures have them: binary16, SPLAT_SH_COEFFS rgb per splat (the ones
+    // past shDegree are 0). The DC term is stored as its color, 0.5 + SH_C0 * f_dc.
+    // NULL and 0 for .splat files.
+    uint16_t *sh;
+    uint32_t shDegree;
+
+    // Compact (SoA) copy of the positions for the CPU depth pass
+    float *posX;
+    float *posY;
+    float *posZ;
+
+    size_t fileSize;
+    double loadTime;
+} SplatScene;
+
+// .splat, or a binary little endian .ply as written by 3DGS training (with SH)
+bool splatSceneLoad(SplatScene *scene, const char *path);
+void splatSceneFree(SplatScene *scene);
+// Converts the scene's splats into the half precision layout, out holds scene->count
+void splatScenePackHalf(const SplatScene *scene, SplatHalf *out);
+// The SH coefficients up to degree (at most scene->shDegree), splatShStride(degree)
+// u32s per splat
+void splatScenePackSh(const SplatScene *scene, uint32_t degree, uint32_t *out);
+
+// Load throughput in MB/s
+static inline double splatSceneLoadThroughput(const SplatScene *scene) {
+    if (scene->loadTime <= 0.0)
+        return 0.0;
+    return scene->fileSize / (1024.0 * 1024.0) / scene->loadTime;
+}
+
+#endif //SPLAT_H
@@ -0,0 +1,203 @@
+#include "threads.h"
+
+#include <stdbool.h>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define THREADS_SERIAL
+#endif
+
+#ifndef THREADS_SERIAL
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#endif
+
+#define MAX_THREADS 64
+
+#ifdef THREADS_SERIAL
+
+uint32_t threadsCount() {
+    return 1;
+}
+
+uint32_t parallelChunks(uint32_t count, uint32_t minChunk) {
+    (void) minChunk;
+    return count > 0 ? 1 : 0;
+}
+
+void parallelFor(uint32_t count, uint32_t minChunk, ParallelForFn fn, void *userData) {
+    (void) minChunk;
+    if (count > 0)
+        fn(userData, 0, 0, count);
+}
+
+void threadsShutdown() {}
+
+#else
+
+static uint32_t chunkBegin(uint32_t count, uint32_t chunks, uint32_t chunk) {
+    return (uint32_t) ((uint64_t) count * chunk / chunks);
+}
+
+static struct {
+    bool initialized;
+    bool quit;
+    uint32_t count;
+    // count once the pool is up, readable without submitLock
+    atomic_uint readyCount;
+    pthread_t threads[MAX_THREADS];
+
+    pthread_mutex_t submitLock;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation;
+    uint64_t startGeneration;
+    uint32_t pending;
+
+    ParallelForFn fn;
+    void *userData;
+    uint32_t elements;
+    uint32_t chunks;
+    atomic_uint nextChunk;
+} pool = {
+    .submitLock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void runChunks() {
+    for (;;) {
+        uint32_t chunk = atomic_fetch_add(&pool.nextChunk, 1);
+        if (chunk >= pool.chunks)
+            break;
+        uint32_t begin = chunkBegin(pool.elements, pool.chunks, chunk);
+        uint32_t end = chunkBegin(pool.elements, pool.chunks, chunk + 1);
+        pool.fn(pool.userData, chunk, begin, end);
+    }
+}
+
+static void *workerMain(void *arg) {
+    (void) arg;
+    uint64_t seen = pool.startGeneration;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.quit && pool.generation == seen)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.quit)
+            break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        runChunks();
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0)
+            pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static uint32_t hardwareThreads() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    long n = 1;
+#endif
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    return (uint32_t) n;
+}
+
+// Must hold submitLock
+static void poolInit() {
+    if (pool.initialized)
+        return;
+    pool.initialized = true;
+    pool.count = 1;
+    pool.startGeneration = pool.generation;
+    uint32_t n = hardwareThreads();
+    for (uint32_t i = 1; i < n; i++) {
+        if (pthread_create(&pool.threads[i], NULL, workerMain, NULL) != 0)
+            break;
+        pool.count++;
+    }
+    atomic_store(&pool.readyCount, pool.count);
+}
+
+uint32_t threadsCount() {
+    // Must not wait for a parallelFor running on another thread
+    uint32_t ready = atomic_load(&pool.readyCount);
+    if (ready)
+        return ready;
+    pthread_mutex_lock(&pool.submitLock);
+    poolInit();
+    uint32_t count = pool.count;
+    pthread_mutex_unlock(&pool.submitLock);
+    return count;
+}
+
+uint32_t parallelChunks(uint32_t count, uint32_t minChunk) {
+    if (minChunk == 0) minChunk = 1;
+    uint32_t chunks = (uint32_t) (((uint64_t) count + minChunk - 1) / minChunk);
+    uint32_t threads = threadsCount();
+    return chunks < threads ? chunks : threads;
+}
+
+void parallelFor(uint32_t count, uint32_t minChunk, ParallelForFn fn, void *userData) {
+    uint32_t chunks = parallelChunks(count, minChunk);
+    if (chunks == 0)
+        return;
+    if (chunks == 1) {
+        fn(userData, 0, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.submitLock);
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.userData = userData;
+    pool.elements = count;
+    pool.chunks = chunks;
+    atomic_store(&pool.nextChunk, 0);
+    pool.pending = pool.count - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    runChunks();
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0)
+        pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.submitLock);
+}
+
+void threadsShutdown() {
+    pthread_mutex_lock(&pool.submitLock);
+    if (pool.initialized) {
+        pthread_mutex_lock(&pool.lock);
+        pool.quit = true;
+        pthread_cond_broadcast(&pool.wake);
+        pthread_mutex_unlock(&pool.lock);
+        for (uint32_t i = 1; i < pool.count; i++)
+            pthread_join(pool.threads[i], NULL);
+        pool.initialized = false;
+        pool.quit = false;
+        pool.count = 0;
+        atomic_store(&pool.readyCount, 0);
+    }
+    pthread_mutex_unlock(&pool.submitLock);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stdint.h>
+
+// Called once per chunk with the half-open element range [begin, end).
+// Chunks are numbered 0..parallelChunks(count, minChunk)-1 and always
+// partition the range the same way, so per-chunk scratch can be indexed by it.
+typedef void (*ParallelForFn)(void *userData, uint32_t chunk, uint32_t begin, uint32_t end);
+
+// Number of threads that take part in parallelFor (including the caller)
+uint32_t threadsCount();
+
+// Number of chunks parallelFor splits count elements into
+uint32_t parallelChunks(uint32_t count, uint32_t minChunk);
+
+// Runs fn over [0, count) on the worker pool and blocks until all chunks are done.
+// Calls from different threads are serialized.
+void parallelFor(uint32_t count, uint32_t minChunk, ParallelForFn fn, void *userData);
+
+void threadsShutdown();
+
+#endif //THREADS_H
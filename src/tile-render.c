@@ -0,0 +1,349 @@
+#include "tile-render.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+typedef struct TileUniform {
+    mat4 viewProj;
+    mat4 view;
+    vec2 focal;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t tileBits;
+    uint32_t capacity;
+} TileUniform;
+_Static_assert(offsetof(TileUniform, focal) == 128, "");
+_Static_assert(offsetof(TileUniform, width) == 136, "");
+_Static_assert(sizeof(TileUniform) == 160, "");
+
+// Projected in tile.wgsl
+#define TILE_PROJECTED_SIZE 32
+
+static WGPUComputePipeline createPipeline(WGPUDevice device, WGPUPipelineLayout layout, WGPUShaderModule module,
+                                          const char *entryPoint) {
+    return wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor) {
+        .layout = layout,
+        .compute = {
+            .module = module,
+            .entryPoint = entryPoint,
+        }
+    });
+}
+
+static WGPUBuffer createBuffer(WGPUDevice device, const char *label, WGPUBufferUsageFlags usage, uint64_t size) {
+    return wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor) {
+        .label = label,
+        .usage = usage,
+        .size = size,
+    });
+}
+
+static WGPUBindGroupLayoutEntry bufferLayoutEntry(uint32_t binding, WGPUBufferBindingType type) {
+    return (WGPUBindGroupLayoutEntry) {
+        .binding = binding,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer.type = type,
+    };
+}
+
+static WGPUBindGroupEntry bufferEntry(uint32_t binding, WGPUBuffer buffer) {
+    return (WGPUBindGroupEntry) {
+        .binding = binding,
+        .buffer = buffer,
+        .offset = 0,
+        .size = wgpuBufferGetSize(buffer),
+    };
+}
+
+void tileRendererInit(TileRenderer *renderer, WGPUDevice device, WGPUQueue queue, WGPUBuffer splats,
+                      uint32_t count, WGPUTextureFormat surfaceFormat, const char *splatPrelude) {
+    tileRendererFree(renderer);
+    renderer->count = count;
+    uint64_t capacity = (uint64_t) count * TILE_INSTANCES_PER_SPLAT;
+    renderer->capacity = capacity > TILE_MAX_INSTANCES ? TILE_MAX_INSTANCES : (capacity ? (uint32_t) capacity : 1);
+    renderer->splatsBuffer = splats;
+
+    char *shader = (char *) readShader((const char *[]) {splatPrelude, "assets/projection.wgsl"}, 2,
+                                       "assets/tile.wgsl");
+    renderer->module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor) {
+        .nextInChain = (WGPUChainedStruct*) &(WGPUShaderModuleWGSLDescriptor) {
+            .chain.next = NULL,
+            .chain.sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            .code = shader,
+        },
+        .label = "Tile Shader",
+    });
+    free(shader);
+
+    renderer->uniformBuffer = createBuffer(device, "Tile Uniforms", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                                           sizeof(TileUniform));
+    renderer->projectedBuffer = createBuffer(device, "Tile Projected", WGPUBufferUsage_Storage,
+                                             (uint64_t) (count ? count : 1) * TILE_PROJECTED_SIZE);
+    renderer->allocatedBuffer = createBuffer(device, "Tile Allocated", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                                             sizeof(uint32_t));
+    renderer->countBuffer = createBuffer(device, "Tile Count", WGPUBufferUsage_Storage, sizeof(uint32_t));
+    renderer->keysBuffer = createBuffer(device, "Tile Keys", WGPUBufferUsage_Storage,
+                                        (uint64_t) renderer->capacity * sizeof(uint32_t));
+    renderer->valuesBuffer = createBuffer(device, "Tile Values", WGPUBufferUsage_Storage,
+                                          (uint64_t) renderer->capacity * sizeof(uint32_t));
+    renderer->indirectBuffer = createBuffer(device, "Tile Indirect", WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect,
+                                            TILE_INDIRECT_COUNT * sizeof(uint32_t));
+    gpuRadixSortInit(&renderer->sort, device, queue, renderer->keysBuffer, renderer->valuesBuffer, renderer->capacity,
+                     renderer->countBuffer, renderer->indirectBuffer, TILE_INDIRECT_RADIX_BLOCKS * sizeof(uint32_t));
+
+    renderer->bindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 9,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            [0] = bufferLayoutEntry(0, WGPUBufferBindingType_Uniform),
+            [1] = bufferLayoutEntry(1, WGPUBufferBindingType_ReadOnlyStorage),
+            [2] = bufferLayoutEntry(2, WGPUBufferBindingType_Storage),
+            [3] = bufferLayoutEntry(3, WGPUBufferBindingType_Storage),
+            [4] = bufferLayoutEntry(4, WGPUBufferBindingType_Storage),
+            [5] = bufferLayoutEntry(5, WGPUBufferBindingType_Storage),
+            [6] = bufferLayoutEntry(6, WGPUBufferBindingType_Storage),
+            [7] = bufferLayoutEntry(7, WGPUBufferBindingType_Storage),
+            [8] = {
+                .binding = 8,
+                .visibility = WGPUShaderStage_Compute,
+                .storageTexture = {
+                    .access = WGPUStorageTextureAccess_WriteOnly,
+                    .format = WGPUTextureFormat_RGBA8Unorm,
+                    .viewDimension = WGPUTextureViewDimension_2D,
+                },
+            },
+        }
+    });
+    // The indirect buffer gets its own group, it is never bound while dispatching from it
+    WGPUBindGroupLayout finalizeBindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 1,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            [0] = bufferLayoutEntry(0, WGPUBufferBindingType_Storage),
+        }
+    });
+    renderer->blitBindLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor) {
+        .entryCount = 1,
+        .entries = (WGPUBindGroupLayoutEntry[]) {
+            [0] = {
+                .binding = 9,
+                .visibility = WGPUShaderStage_Fragment,
+                .texture = {
+                    .sampleType = WGPUTextureSampleType_Float,
+                    .viewDimension = WGPUTextureViewDimension_2D,
+                },
+            },
+        }
+    });
+    renderer->finalizeBindGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = finalizeBindLayout,
+        .entryCount = 1,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = bufferEntry(0, renderer->indirectBuffer),
+        },
+        .label = "Tile Finalize Bind Group",
+    });
+
+    renderer->layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            renderer->bindLayout,
+        },
+        .label = "Tile Layout",
+    });
+    renderer->finalizeLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 2,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            renderer->bindLayout,
+            finalizeBindLayout,
+        },
+        .label = "Tile Finalize Layout",
+    });
+    renderer->blitLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor) {
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = (WGPUBindGroupLayout[]) {
+            renderer->blitBindLayout,
+        },
+        .label = "Tile Blit Layout",
+    });
+    wgpuBindGroupLayoutRelease(finalizeBindLayout);
+
+    renderer->projectPipeline = createPipeline(device, renderer->layout, renderer->module, "tile_project_main");
+    renderer->finalizePipeline = createPipeline(device, renderer->finalizeLayout, renderer->module, "tile_finalize_main");
+    renderer->rangesPipeline = createPipeline(device, renderer->layout, renderer->module, "tile_ranges_main");
+    renderer->renderPipeline = createPipeline(device, renderer->layout, renderer->module, "tile_render_main");
+    renderer->blitPipeline = wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor) {
+        .layout = renderer->blitLayout,
+        .primitive.topology = WGPUPrimitiveTopology_TriangleList,
+        .primitive.stripIndexFormat = WGPUIndexFormat_Undefined,
+        .primitive.frontFace = WGPUFrontFace_CCW,
+        .primitive.cullMode = WGPUCullMode_None,
+        .vertex.module = renderer->module,
+        .vertex.bufferCount = 0,
+        .vertex.entryPoint = "vs_blit",
+        .fragment = &(WGPUFragmentState) {
+            .module = renderer->module,
+            .entryPoint = "fs_blit",
+            .targetCount = 1,
+            .targets = (WGPUColorTargetState[]) {
+                [0].format = surfaceFormat,
+                [0].writeMask = WGPUColorWriteMask_All,
+            }
+        },
+        .depthStencil = NULL,
+        .multisample.count = 1,
+        .multisample.mask = ~0u,
+        .multisample.alphaToCoverageEnabled = false,
+    });
+}
+
+static void releaseSizeDependent(TileRenderer *renderer) {
+    if (renderer->bindGroup) wgpuBindGroupRelease(renderer->bindGroup);
+    if (renderer->blitBindGroup) wgpuBindGroupRelease(renderer->blitBindGroup);
+    if (renderer->textureView) wgpuTextureViewRelease(renderer->textureView);
+    if (renderer->texture) wgpuTextureRelease(renderer->texture);
+    if (renderer->rangesBuffer) wgpuBufferRelease(renderer->rangesBuffer);
+    renderer->bindGroup = NULL;
+    renderer->blitBindGroup = NULL;
+    renderer->textureView = NULL;
+    renderer->texture = NULL;
+    renderer->rangesBuffer = NULL;
+}
+
+static void resize(TileRenderer *renderer, WGPUDevice device, uint32_t width, uint32_t height) {
+    releaseSizeDependent(renderer);
+    renderer->width = width;
+    renderer->height = height;
+    renderer->tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    renderer->tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    renderer->tileBits = 1;
+    while ((1u << renderer->tileBits) < renderer->tilesX * renderer->tilesY)
+        renderer->tileBits++;
+
+    renderer->rangesBuffer = createBuffer(device, "Tile Ranges", WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                                          (uint64_t) renderer->tilesX * renderer->tilesY * 2 * sizeof(uint32_t));
+    renderer->texture = wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor) {
+        .label = "Tile Output",
+        .usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {width, height, 1},
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .mipLevelCount = 1,
+        .sampleCount = 1,
+    });
+    renderer->textureView = wgpuTextureCreateView(renderer->texture, &(WGPUTextureViewDescriptor) {
+        .label = "Tile Output View",
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .dimension = WGPUTextureViewDimension_2D,
+        .baseMipLevel = 0,
+        .mipLevelCount = 1,
+        .baseArrayLayer = 0,
+        .arrayLayerCount = 1,
+        .aspect = WGPUTextureAspect_All,
+    });
+
+    renderer->bindGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = renderer->bindLayout,
+        .entryCount = 9,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = bufferEntry(0, renderer->uniformBuffer),
+            [1] = bufferEntry(1, renderer->splatsBuffer),
+            [2] = bufferEntry(2, renderer->projectedBuffer),
+            [3] = bufferEntry(3, renderer->allocatedBuffer),
+            [4] = bufferEntry(4, renderer->countBuffer),
+            [5] = bufferEntry(5, renderer->keysBuffer),
+            [6] = bufferEntry(6, renderer->valuesBuffer),
+            [7] = bufferEntry(7, renderer->rangesBuffer),
+            [8] = {.binding = 8, .textureView = renderer->textureView},
+        },
+        .label = "Tile Bind Group",
+    });
+    renderer->blitBindGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor) {
+        .layout = renderer->blitBindLayout,
+        .entryCount = 1,
+        .entries = (WGPUBindGroupEntry[]) {
+            [0] = {.binding = 9, .textureView = renderer->textureView},
+        },
+        .label = "Tile Blit Bind Group",
+    });
+}
+
+void tileRendererFree(TileRenderer *renderer) {
+    releaseSizeDependent(renderer);
+    gpuRadixSortFree(&renderer->sort);
+    if (renderer->finalizeBindGroup) wgpuBindGroupRelease(renderer->finalizeBindGroup);
+    if (renderer->projectPipeline) wgpuComputePipelineRelease(renderer->projectPipeline);
+    if (renderer->finalizePipeline) wgpuComputePipelineRelease(renderer->finalizePipeline);
+    if (renderer->rangesPipeline) wgpuComputePipelineRelease(renderer->rangesPipeline);
+    if (renderer->renderPipeline) wgpuComputePipelineRelease(renderer->renderPipeline);
+    if (renderer->blitPipeline) wgpuRenderPipelineRelease(renderer->blitPipeline);
+    if (renderer->layout) wgpuPipelineLayoutRelease(renderer->layout);
+    if (renderer->finalizeLayout) wgpuPipelineLayoutRelease(renderer->finalizeLayout);
+    if (renderer->blitLayout) wgpuPipelineLayoutRelease(renderer->blitLayout);
+    if (renderer->bindLayout) wgpuBindGroupLayoutRelease(renderer->bindLayout);
+    if (renderer->blitBindLayout) wgpuBindGroupLayoutRelease(renderer->blitBindLayout);
+    if (renderer->module) wgpuShaderModuleRelease(renderer->module);
+    if (renderer->uniformBuffer) wgpuBufferRelease(renderer->uniformBuffer);
+    if (renderer->projectedBuffer) wgpuBufferRelease(renderer->projectedBuffer);
+    if (renderer->allocatedBuffer) wgpuBufferRelease(renderer->allocatedBuffer);
+    if (renderer->countBuffer) wgpuBufferRelease(renderer->countBuffer);
+    if (renderer->keysBuffer) wgpuBufferRelease(renderer->keysBuffer);
+    if (renderer->valuesBuffer) wgpuBufferRelease(renderer->valuesBuffer);
+    if (renderer->indirectBuffer) wgpuBufferRelease(renderer->indirectBuffer);
+    memset(renderer, 0, sizeof(*renderer));
+}
+
+void tileRendererEncode(TileRenderer *renderer, WGPUDevice device, WGPUQueue queue, WGPUCommandEncoder encoder,
+                        mat4 view, mat4 proj, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0)
+        return;
+    if (width != renderer->width || height != renderer->height)
+        resize(renderer, device, width, height);
+
+    TileUniform uniform = {
+        .focal = {proj[0][0] * width * 0.5f, proj[1][1] * height * 0.5f},
+        .width = width,
+        .height = height,
+        .tilesX = renderer->tilesX,
+        .tilesY = renderer->tilesY,
+        .tileBits = renderer->tileBits,
+        .capacity = renderer->capacity,
+    };
+    glm_mat4_mul(proj, view, uniform.viewProj);
+    glm_mat4_copy(view, uniform.view);
+    wgpuQueueWriteBuffer(queue, renderer->uniformBuffer, 0, &uniform, sizeof(uniform));
+    wgpuCommandEncoderClearBuffer(encoder, renderer->allocatedBuffer, 0, sizeof(uint32_t));
+    // Tiles without splats keep an empty range
+    wgpuCommandEncoderClearBuffer(encoder, renderer->rangesBuffer, 0, wgpuBufferGetSize(renderer->rangesBuffer));
+
+    WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+    wgpuComputePassEncoderSetBindGroup(pass, 0, renderer->bindGroup, 0, NULL);
+    wgpuComputePassEncoderSetPipeline(pass, renderer->projectPipeline);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, (renderer->count + 255) / 256, 1, 1);
+    wgpuComputePassEncoderSetPipeline(pass, renderer->finalizePipeline);
+    wgpuComputePassEncoderSetBindGroup(pass, 1, renderer->finalizeBindGroup, 0, NULL);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+
+    // Tile index in the top bits, so the whole key is sorted
+    gpuRadixSortEncode(&renderer->sort, pass, 32);
+
+    wgpuComputePassEncoderSetBindGroup(pass, 0, renderer->bindGroup, 0, NULL);
+    wgpuComputePassEncoderSetPipeline(pass, renderer->rangesPipeline);
+    wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, renderer->indirectBuffer,
+                                                     TILE_INDIRECT_RANGE_GROUPS * sizeof(uint32_t));
+    wgpuComputePassEncoderSetPipeline(pass, renderer->renderPipeline);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, renderer->tilesX, renderer->tilesY, 1);
+    wgpuComputePassEncoderEnd(pass);
+    wgpuComputePassEncoderRelease(pass);
+}
+
+void tileRendererBlit(const TileRenderer *renderer, WGPURenderPassEncoder pass) {
+    if (!renderer->blitBindGroup)
+        return;
+    wgpuRenderPassEncoderSetPipeline(pass, renderer->blitPipeline);
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, renderer->blitBindGroup, 0, NULL);
+    wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+}
@@ -0,0 +1,83 @@
+#ifndef TILE_RENDER_H
+#define TILE_RENDER_H
+
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+#include <webgpu/webgpu.h>
+
+#include "gpu-sort.h"
+
+// Must match assets/tile.wgsl
+#define TILE_SIZE 16
+#define TILE_INDIRECT_RADIX_BLOCKS 0
+#define TILE_INDIRECT_RANGE_GROUPS 3
+#define TILE_INDIRECT_COUNT 6
+// Instance buffers hold this many (tile, splat) pairs per splat, splats that do
+// not fit are dropped for the frame
+#define TILE_INSTANCES_PER_SPLAT 4
+#define TILE_MAX_INSTANCES (1u << 24)
+
+typedef enum RenderMode {
+    RENDER_QUADS,
+    RENDER_TILES,
+} RenderMode;
+
+// Compute rasterizer in the style of the original 3DGS one. Splats are binned into
+// TILE_SIZE tiles, sorted by (tile, depth) and blended front to back into a storage
+// texture, which is then copied to the surface.
+typedef struct TileRenderer {
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t tileBits;
+
+    WGPUShaderModule module;
+    WGPUBindGroupLayout bindLayout;
+    WGPUBindGroupLayout blitBindLayout;
+    WGPUPipelineLayout layout;
+    WGPUPipelineLayout finalizeLayout;
+    WGPUPipelineLayout blitLayout;
+    WGPUComputePipeline projectPipeline;
+    WGPUComputePipeline finalizePipeline;
+    WGPUComputePipeline rangesPipeline;
+    WGPUComputePipeline renderPipeline;
+    WGPURenderPipeline blitPipeline;
+
+    WGPUBuffer splatsBuffer;
+    WGPUBuffer uniformBuffer;
+    WGPUBuffer projectedBuffer;
+    WGPUBuffer allocatedBuffer;
+    WGPUBuffer countBuffer;
+    WGPUBuffer keysBuffer;
+    WGPUBuffer valuesBuffer;
+    WGPUBuffer indirectBuffer;
+    WGPUBindGroup finalizeBindGroup;
+
+    // Depend on the output size
+    WGPUBuffer rangesBuffer;
+    WGPUTexture texture;
+    WGPUTextureView textureView;
+    WGPUBindGroup bindGroup;
+    WGPUBindGroup blitBindGroup;
+
+    GpuRadixSort sort;
+} TileRenderer;
+
+// splats is the scene's splat buffer, it is not owned by the renderer. splatPrelude is
+// the shader file that declares its layout (assets/precision-*.wgsl).
+void tileRendererInit(TileRenderer *renderer, WGPUDevice device, WGPUQueue queue, WGPUBuffer splats,
+                      uint32_t count, WGPUTextureFormat surfaceFormat, const char *splatPrelude);
+void tileRendererFree(TileRenderer *renderer);
+
+// Records the whole rasterization into encoder, the output is resized to width x height first
+void tileRendererEncode(TileRenderer *renderer, WGPUDevice device, WGPUQueue queue, WGPUCommandEncoder encoder,
+                        mat4 view, mat4 proj, uint32_t width, uint32_t height);
+
+// Copies the last output to the render pass' target
+void tileRendererBlit(const TileRenderer *renderer, WGPURenderPassEncoder pass);
+
+#endif //TILE_RENDER_H
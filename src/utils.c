@@ -4,8 +4,10 @@
 
 #include "utils.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 const char *readFile(const char *path) {
@@ -25,3 +27,32 @@ const char *readFile(const char *path) {
     fclose(file);
     return buffer;
 }
+
+const char *readShader(const char *const *preludes, uint32_t preludeCount, const char *path) {
+    char *parts[8];
+    uint32_t count = preludeCount + 1;
+    if (count > sizeof(parts) / sizeof(parts[0]))
+        return NULL;
+    size_t size = 1;
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++) {
+        parts[i] = (char *) readFile(i < preludeCount ? preludes[i] : path);
+        ok = ok && parts[i];
+        size += parts[i] ? strlen(parts[i]) + 1 : 0;
+    }
+    char *buffer = ok ? malloc(size) : NULL;
+    if (buffer) {
+        // One newline after every file
+        char *cursor = buffer;
+        for (uint32_t i = 0; i < count; i++) {
+            size_t partSize = strlen(parts[i]);
+            memcpy(cursor, parts[i], partSize);
+            cursor[partSize] = '\n';
+            cursor += partSize + 1;
+        }
+        *cursor = '\0';
+    }
+    for (uint32_t i = 0; i < count; i++)
+        free(parts[i]);
+    return buffer;
+}
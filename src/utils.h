@@ -5,6 +5,11 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdint.h>
+
 const char *readFile(const char *path);
+// Shader source with the declarations of the preludes (other files) in front of it,
+// in order
+const char *readShader(const char *const *preludes, uint32_t preludeCount, const char *path);
 
 #endif //UTILS_H